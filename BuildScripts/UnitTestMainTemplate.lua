@@ -29,6 +29,9 @@ int main(int ac, char** av)
 {TEST_FUNCTIONS}
     };
 
+    // the harnesses are still alive when leaks get reported, so don't count them.
+    libCore::MarkMemoryBaseline();
+
 
     try
     {
@@ -14,6 +14,9 @@
 
 #include <libCore/libCore.h>
 #include <libCore/ArgParser.h>
+#include <libCore/Arena.h>
+#include <libCore/Profiler.h>
+#include <libCore/Metrics.h>
 
 #include <libCore/Logger.h>
 
@@ -104,6 +107,7 @@ void Application::Initialize(int ac, char** av)
 int Application::Run()
 {
 	_mainThreadId = std::this_thread::get_id();
+	FIRE_PROFILE_THREAD("Main");
 
 	bool windowWantsToClose{ false };
 	double deltaT{ 0.0 };
@@ -115,6 +119,10 @@ int Application::Run()
 
 	auto& renderMgr = _managerMgr.GetRenderMgr();
 
+	MetricHistogram& frameTime = Metrics::GetHistogram("app.frame_time_ns");
+	MetricGauge& frameTimeMs = Metrics::GetGauge("app.frame_time_ms");
+	uint64_t frameStart = Metrics::GetTime();
+
 	while(static_cast<LLGL::Window&>(renderMgr.Context->GetSurface()).ProcessEvents())
 	{
 		// _mainThreadId = std::this_thread::get_id();
@@ -127,8 +135,14 @@ int Application::Run()
 			start = end;
 		}*/
 
-		OnUpdate(deltaT);
-		OnRender();
+		{
+			FIRE_PROFILE_SCOPE("Application::OnUpdate");
+			OnUpdate(deltaT);
+		}
+		{
+			FIRE_PROFILE_SCOPE("Application::OnRender");
+			OnRender();
+		}
 
 		//_surface->SwapBuffers();
 
@@ -151,7 +165,26 @@ int Application::Run()
 				isRunning = false;
 			}
 		}*/
-		renderMgr.Context->Present();
+		{
+			FIRE_PROFILE_SCOPE("Application::Present");
+			renderMgr.Context->Present();
+		}
+
+		// destroys everything that was despawned in a batch this frame, then cleans up after a few of the dead.
+		_managerMgr.GetEntityMgr().FlushDespawns();
+		_managerMgr.GetEntityMgr().CollectGarbage();
+
+		// recycles the frame arena buffer that the previous frame allocated from.
+		FrameArena::Get().EndFrame();
+
+		// collects everything the threads profiled this frame.
+		FIRE_PROFILE_FRAME();
+
+		const uint64_t frameEnd = Metrics::GetTime();
+		frameTime.Record(frameEnd - frameStart);
+		frameTimeMs.Set((frameEnd - frameStart) / 1e6);
+		frameStart = frameEnd;
+		Metrics::Update();
 	}
 	//_surface->Close();
 	
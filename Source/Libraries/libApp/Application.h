@@ -140,6 +140,7 @@ CLOSE_NAMESPACE(Firestorm);
 		::Firestorm::InitializeLib<::Firestorm::libScript>(ac,av);           			\
 		::Firestorm::InitializeLib<::Firestorm::libSerial>(ac,av);           			\
 		::Firestorm::InitializeLib<::Firestorm::libUI>(ac,av);           			    \
+		::Firestorm::libCore::MarkMemoryBaseline();                                     \
         int result = 0;                                                                 \
 		::Firestorm::Application* app = nullptr;                                        \
 		try																				\
@@ -151,7 +152,7 @@ CLOSE_NAMESPACE(Firestorm);
 		}                                                                               \
 		catch(::Firestorm::AssertionException& e)                                       \
 		{																				\
-			::Firestorm::FIRE_LOG_ERROR(e.Report());									\
+			FIRE_LOG_ERROR(e.Report());													\
 			FIRE_ASSERT_MSG(false, "Assertion encountered...");                         \
 			result = -1;																\
 		}                                                                               \
@@ -13,7 +13,8 @@
 OPEN_NAMESPACE(Firestorm);
 
 ManagerMgr::ManagerMgr()
-: _FIRE_MGR_VAR(RenderMgr)(_FIRE_MGR_VAR(ResourceMgr), _FIRE_MGR_VAR(ObjectMaker))
+: _FIRE_MGR_VAR(ResourceMgr)(_FIRE_MGR_VAR(JobSystem))
+, _FIRE_MGR_VAR(RenderMgr)(_FIRE_MGR_VAR(ResourceMgr), _FIRE_MGR_VAR(ObjectMaker))
 , _FIRE_MGR_VAR(EntityMgr)(_FIRE_MGR_VAR(UUIDMgr))
 {
 }
@@ -27,6 +28,7 @@ void ManagerMgr::Shutdown()
 {
 	_FIRE_MGR_VAR(ResourceMgr).Shutdown();
 	_FIRE_MGR_VAR(RenderMgr).Shutdown();
+	_FIRE_MGR_VAR(JobSystem).Shutdown();
 }
 
 CLOSE_NAMESPACE(Firestorm);
\ No newline at end of file
@@ -13,6 +13,7 @@
 
 #include "ObjectMaker.h"
 #include <libCore/UUIDMgr.h>
+#include <libCore/JobSystem.h>
 #include <libIO/ResourceMgr.h>
 #include <libScene/RenderMgr.h>
 #include <libMirror/ObjectMaker.h>
@@ -39,6 +40,7 @@ private:
 
 public:
 	FIRE_MGR_INSTALL(UUIDMgr);
+	FIRE_MGR_INSTALL(JobSystem);
 	FIRE_MGR_INSTALL(ResourceMgr);
 	FIRE_MGR_INSTALL(RenderMgr);
 	FIRE_MGR_INSTALL(ObjectMaker);
@@ -0,0 +1,427 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Allocator
+//
+//  The general purpose allocator that sits behind fire_alloc, fire_free and operator new[], and behind plain
+//  operator new as well when FIRE_REPLACE_GLOBAL_NEW is defined.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "Allocator.h"
+#include "Assert.h"
+#include "BatchStack.h"
+#include <cstdlib>
+
+#ifdef FIRE_PLATFORM_UNIX
+#include <sys/mman.h>
+#endif
+
+// nothing in here may allocate through libCore (or operator new), since this is what libCore allocates with.
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum BlockKind : uint8_t
+{
+	kSmall  = 0x5A,
+	kHeap   = 0xA5,
+	kMapped = 0xC3
+};
+
+struct BlockHeader
+{
+	uint32_t Offset;     // distance from the start of the underlying allocation to the block.
+	uint8_t  Kind;
+	uint8_t  SizeClass;
+	uint16_t TrackingId; // handed out by the MemoryTracker. 0 when the block isn't tracked.
+	uint64_t Size;
+};
+static_assert(sizeof(BlockHeader) == Allocator::HeaderSize, "the block header has to stay 16 bytes so blocks stay 16 byte aligned");
+
+// free small blocks reuse their own memory (header included) as list nodes.
+using FreeNode = BatchNode;
+static_assert(sizeof(FreeNode) <= Allocator::HeaderSize + Allocator::MinAlignment, "the smallest block has to fit a FreeNode");
+
+// plain data, so that it can still be used by the destructors of other thread locals once the thread's cache has
+// been handed back. ThreadCacheReleaser is what hands it back.
+struct ThreadCache
+{
+	struct Bin
+	{
+		FreeNode* Head;
+		size_t    Count;
+	};
+
+	Bin  Bins[Allocator::NumSizeClasses];
+	bool Registered;  // the thread's ThreadCacheReleaser has been made.
+	bool Released;    // the cache has been handed back. blocks go straight to the global lists from here on.
+};
+
+struct ThreadCacheReleaser
+{
+	~ThreadCacheReleaser();
+
+	bool Armed;
+};
+
+static const size_t s_batchSize = 32;
+
+// slabs are never handed back to the system, which is what makes popping from these safe.
+static BatchStack       s_globalFree[Allocator::NumSizeClasses];
+static atomic<size_t>   s_numSmallSlabs{ 0 };
+static atomic<size_t>   s_numLargeBlocks{ 0 };
+static atomic<size_t>   s_numHugePageBlocks{ 0 };
+static atomic<bool>     s_hugePagesEnabled{ false };
+
+static thread_local ThreadCache         tl_cache;
+static thread_local ThreadCacheReleaser tl_cacheReleaser;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uintptr_t AlignUp(uintptr_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~uintptr_t(alignment - 1);
+}
+
+static inline size_t GetBlockSize(size_t sizeClass)
+{
+	return Allocator::HeaderSize + (sizeClass + 1) * Allocator::MinAlignment;
+}
+
+// a thread local with a destructor is only made once the thread uses it, so the releaser is touched the first time
+// the thread uses its cache.
+static inline void RegisterThreadCache()
+{
+	if(!tl_cache.Registered)
+	{
+		tl_cache.Registered = true;
+		tl_cacheReleaser.Armed = true;
+	}
+}
+
+ThreadCacheReleaser::~ThreadCacheReleaser()
+{
+	Allocator::FlushThreadCache();
+	tl_cache.Released = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void* InitHeader(char* block, BlockKind kind, size_t offset, uint8_t sizeClass, size_t size)
+{
+	BlockHeader* header = reinterpret_cast<BlockHeader*>(block);
+	header->Offset = static_cast<uint32_t>(offset);
+	header->Kind = kind;
+	header->SizeClass = sizeClass;
+	header->TrackingId = 0;
+	header->Size = size;
+	return header + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static FreeNode* AllocateSlab(size_t sizeClass, size_t& count)
+{
+	char* slab = static_cast<char*>(std::malloc(Allocator::SlabSize));
+	if(slab == nullptr)
+	{
+		return nullptr;
+	}
+	FIRE_ASSERT_MSG(BatchStack::CanHold(slab), "slab address doesn't leave room for the ABA tag");
+	s_numSmallSlabs.fetch_add(1, std::memory_order_relaxed);
+
+	// carve the slab up into batches. the first one goes to the caller and the rest go to the global list.
+	const size_t blockSize = GetBlockSize(sizeClass);
+	const size_t numBlocks = Allocator::SlabSize / blockSize;
+
+	FreeNode* first = nullptr;
+	size_t firstCount = 0;
+	for(size_t start = 0; start < numBlocks; start += s_batchSize)
+	{
+		size_t batchCount = eastl::min(s_batchSize, numBlocks - start);
+		for(size_t i = 0; i < batchCount; ++i)
+		{
+			FreeNode* node = reinterpret_cast<FreeNode*>(slab + (start + i) * blockSize);
+			node->Next = i + 1 < batchCount ? reinterpret_cast<FreeNode*>(slab + (start + i + 1) * blockSize) : nullptr;
+		}
+
+		FreeNode* batch = reinterpret_cast<FreeNode*>(slab + start * blockSize);
+		if(first == nullptr)
+		{
+			first = batch;
+			firstCount = batchCount;
+		}
+		else
+		{
+			s_globalFree[sizeClass].Push(batch, batchCount);
+		}
+	}
+
+	count = firstCount;
+	return first;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void* AllocateSmall(size_t size)
+{
+	const size_t sizeClass = size == 0 ? 0 : (size - 1) / Allocator::MinAlignment;
+
+	FreeNode* node = nullptr;
+	if(!tl_cache.Released)
+	{
+		RegisterThreadCache();
+		ThreadCache::Bin& bin = tl_cache.Bins[sizeClass];
+		if(bin.Head == nullptr)
+		{
+			size_t count = 0;
+			FreeNode* batch = s_globalFree[sizeClass].Pop(count);
+			if(batch == nullptr)
+			{
+				batch = AllocateSlab(sizeClass, count);
+				if(batch == nullptr)
+				{
+					return nullptr;
+				}
+			}
+			bin.Head = batch;
+			bin.Count = count;
+		}
+		node = bin.Head;
+		bin.Head = node->Next;
+		--bin.Count;
+	}
+	else
+	{
+		// the thread is on its way out. take a batch, keep one block and put the rest straight back.
+		size_t count = 0;
+		node = s_globalFree[sizeClass].Pop(count);
+		if(node == nullptr)
+		{
+			node = AllocateSlab(sizeClass, count);
+			if(node == nullptr)
+			{
+				return nullptr;
+			}
+		}
+		if(count > 1)
+		{
+			s_globalFree[sizeClass].Push(node->Next, count - 1);
+		}
+	}
+
+	return InitHeader(reinterpret_cast<char*>(node), kSmall, 0, static_cast<uint8_t>(sizeClass), size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void FreeSmall(BlockHeader* header)
+{
+	const size_t sizeClass = header->SizeClass;
+	FreeNode* node = reinterpret_cast<FreeNode*>(header);
+
+	if(tl_cache.Released)
+	{
+		node->Next = nullptr;
+		s_globalFree[sizeClass].Push(node, 1);
+		return;
+	}
+
+	RegisterThreadCache();
+	ThreadCache::Bin& bin = tl_cache.Bins[sizeClass];
+	node->Next = bin.Head;
+	bin.Head = node;
+	++bin.Count;
+
+	// keep a batch around for the next few allocations and hand the other one back.
+	if(bin.Count >= 2 * s_batchSize)
+	{
+		FreeNode* first = bin.Head;
+		FreeNode* last = first;
+		for(size_t i = 1; i < s_batchSize; ++i)
+		{
+			last = last->Next;
+		}
+		bin.Head = last->Next;
+		bin.Count -= s_batchSize;
+		last->Next = nullptr;
+		s_globalFree[sizeClass].Push(first, s_batchSize);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void* AllocateHeap(size_t size, size_t alignment)
+{
+	char* raw = static_cast<char*>(std::malloc(size + Allocator::HeaderSize + alignment - 1));
+	if(raw == nullptr)
+	{
+		return nullptr;
+	}
+	char* block = reinterpret_cast<char*>(AlignUp(reinterpret_cast<uintptr_t>(raw) + Allocator::HeaderSize, alignment));
+	s_numLargeBlocks.fetch_add(1, std::memory_order_relaxed);
+	return InitHeader(block - Allocator::HeaderSize, kHeap, block - raw, 0, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef FIRE_PLATFORM_UNIX
+static void* AllocateMapped(size_t size, size_t alignment)
+{
+	const size_t offset = AlignUp(Allocator::HeaderSize, alignment);
+	const size_t length = AlignUp(offset + size, Allocator::HugePageSize);
+
+	// map an extra huge page so that the start can be moved up to a huge page boundary, then trim the ends off.
+	void* mapping = mmap(nullptr, length + Allocator::HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(mapping == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	char* raw = static_cast<char*>(mapping);
+	char* start = reinterpret_cast<char*>(AlignUp(reinterpret_cast<uintptr_t>(raw), Allocator::HugePageSize));
+	if(start > raw)
+	{
+		munmap(raw, start - raw);
+	}
+	char* end = raw + length + Allocator::HugePageSize;
+	if(end > start + length)
+	{
+		munmap(start + length, end - (start + length));
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(start, length, MADV_HUGEPAGE);
+#endif
+
+	s_numHugePageBlocks.fetch_add(1, std::memory_order_relaxed);
+	return InitHeader(start + offset - Allocator::HeaderSize, kMapped, offset, 0, size);
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* Allocator::Allocate(size_t size, size_t alignment)
+{
+	FIRE_ASSERT_MSG((alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+	FIRE_ASSERT_MSG(alignment <= HugePageSize, "alignment is larger than the allocator supports");
+	alignment = alignment < MinAlignment ? MinAlignment : alignment;
+
+	if(size <= MaxSmallSize && alignment == MinAlignment)
+	{
+		return AllocateSmall(size);
+	}
+
+#ifdef FIRE_PLATFORM_UNIX
+	if(size >= HugePageSize && s_hugePagesEnabled.load(std::memory_order_relaxed))
+	{
+		if(void* block = AllocateMapped(size, alignment))
+		{
+			return block;
+		}
+	}
+#endif
+
+	return AllocateHeap(size, alignment);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Allocator::Free(void* block)
+{
+	if(block == nullptr)
+	{
+		return;
+	}
+
+	BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+	char* raw = static_cast<char*>(block) - header->Offset;
+	switch(header->Kind)
+	{
+	case kSmall:
+		FreeSmall(header);
+		break;
+	case kHeap:
+		header->Kind = 0;
+		s_numLargeBlocks.fetch_sub(1, std::memory_order_relaxed);
+		std::free(raw);
+		break;
+#ifdef FIRE_PLATFORM_UNIX
+	case kMapped:
+		header->Kind = 0;
+		s_numHugePageBlocks.fetch_sub(1, std::memory_order_relaxed);
+		munmap(raw, AlignUp(header->Offset + header->Size, HugePageSize));
+		break;
+#endif
+	default:
+		FIRE_ASSERT_MSG(false, "freeing a block that wasn't allocated by libCore (or was already freed)");
+		break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t Allocator::GetAllocationSize(const void* block)
+{
+	return block ? static_cast<size_t>((static_cast<const BlockHeader*>(block) - 1)->Size) : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Allocator::SetTrackingId(void* block, uint16_t id)
+{
+	(static_cast<BlockHeader*>(block) - 1)->TrackingId = id;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t Allocator::GetTrackingId(const void* block)
+{
+	return (static_cast<const BlockHeader*>(block) - 1)->TrackingId;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Allocator::FlushThreadCache()
+{
+	for(size_t i = 0; i < NumSizeClasses; ++i)
+	{
+		ThreadCache::Bin& bin = tl_cache.Bins[i];
+		if(bin.Head)
+		{
+			s_globalFree[i].Push(bin.Head, bin.Count);
+			bin.Head = nullptr;
+			bin.Count = 0;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Allocator::SetHugePagesEnabled(bool enabled)
+{
+	s_hugePagesEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Allocator::GetHugePagesEnabled()
+{
+	return s_hugePagesEnabled.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Allocator::Stats Allocator::GetStats()
+{
+	Stats stats;
+	stats.NumSmallSlabs = s_numSmallSlabs.load(std::memory_order_relaxed);
+	stats.NumLargeBlocks = s_numLargeBlocks.load(std::memory_order_relaxed);
+	stats.NumHugePageBlocks = s_numHugePageBlocks.load(std::memory_order_relaxed);
+	return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
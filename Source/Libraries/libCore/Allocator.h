@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Allocator
+//
+//  The general purpose allocator that sits behind fire_alloc, fire_free and operator new[], and behind plain
+//  operator new as well when FIRE_REPLACE_GLOBAL_NEW is defined.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_ALLOCATOR_H_
+#define LIBCORE_ALLOCATOR_H_
+#pragma once
+
+#include "libCore.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class Allocator
+
+	Every block handed out carries a 16 byte header in front of it that records how the block was allocated, so
+	Free can hand it back to the right place without being told. Blocks come from one of three places.
+
+	- Small blocks (256 bytes or less, with an alignment of 16 or less) come out of a segregated size class
+	  allocator. Each size class carves 64 KiB slabs into blocks, each thread keeps a cache of free blocks per size
+	  class, and the caches trade blocks with a lock free global list in batches.
+	- Everything else comes from the system heap, over-allocated so that the requested alignment is honored.
+	- When huge pages are enabled, blocks of HugePageSize or more are mapped directly and advised to be backed by
+	  transparent huge pages. This is meant for the large column buffers of the SOA containers.
+
+	\note Slabs belonging to the small block allocator are never handed back to the system.
+	\note The huge page path is only implemented on Linux. Elsewhere SetHugePagesEnabled is accepted and ignored.
+ **/
+struct Allocator final
+{
+	static const size_t HeaderSize = 16;
+	static const size_t MinAlignment = 16;
+	static const size_t MaxSmallSize = 256;
+	static const size_t NumSizeClasses = MaxSmallSize / MinAlignment;
+	static const size_t SlabSize = 64 * 1024;
+	static const size_t HugePageSize = 2 * 1024 * 1024;
+
+	struct Stats
+	{
+		size_t NumSmallSlabs;
+		size_t NumLargeBlocks;
+		size_t NumHugePageBlocks;
+	};
+
+	/**
+		Allocate \c size bytes aligned to \c alignment, which must be a power of two. Alignments below
+		MinAlignment are rounded up to it.
+	 **/
+	static void* Allocate(size_t size, size_t alignment = MinAlignment);
+
+	/**
+		Release a block returned by Allocate. Passing nullptr is a no-op.
+	 **/
+	static void Free(void* block);
+
+	/**
+		Retrieve the size that was requested when \c block was allocated.
+	 **/
+	static size_t GetAllocationSize(const void* block);
+
+	/**
+		Stash a 16 bit id in the header of \c block. Used by the MemoryTracker to remember where a block came from.
+	 **/
+	static void SetTrackingId(void* block, uint16_t id);
+	static uint16_t GetTrackingId(const void* block);
+
+	/**
+		Hand every block in the calling thread's caches back to the global lists. Threads do this on their own when
+		they exit, this is for threads that are about to go idle for a long time.
+	 **/
+	static void FlushThreadCache();
+
+	/**
+		Turn the huge page path for large blocks on or off. It is off by default.
+	 **/
+	static void SetHugePagesEnabled(bool enabled);
+	static bool GetHugePagesEnabled();
+
+	static Stats GetStats();
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
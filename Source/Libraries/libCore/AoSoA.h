@@ -0,0 +1,466 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  AoSoA
+//
+//  A structure of arrays that's chopped into blocks the width of a SIMD register.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_AOSOA_H_
+#define LIBCORE_AOSOA_H_
+#pragma once
+
+#include "libCore.h"
+#include "Assert.h"
+#include "SOA.h"
+
+#include <cstring>
+
+OPEN_NAMESPACE(Firestorm);
+
+namespace AoSoADetail
+{
+	constexpr size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	constexpr size_t NextPowerOfTwo(size_t value)
+	{
+		size_t power = 1;
+		while(power < value)
+		{
+			power <<= 1;
+		}
+		return power;
+	}
+
+	// a field's lanes are aligned to the register they'd be loaded into (16 bytes for 4 floats, 32 for 8, 64 for
+	// 16), capped at a cache line.
+	template<size_t Lanes, class T>
+	constexpr size_t FieldAlignment()
+	{
+		const size_t alignment = NextPowerOfTwo(sizeof(T) * Lanes);
+		const size_t capped = alignment > 64 ? 64 : alignment;
+		return capped < alignof(T) ? alignof(T) : capped;
+	}
+
+	template<size_t NumFields>
+	struct Layout
+	{
+		size_t Offsets[NumFields];
+		size_t BlockSize;
+		size_t Alignment;
+	};
+
+	template<size_t Lanes, class... Ts>
+	constexpr Layout<sizeof...(Ts)> ComputeLayout()
+	{
+		const size_t alignments[] = { FieldAlignment<Lanes, Ts>()... };
+		const size_t sizes[] = { sizeof(Ts) * Lanes... };
+
+		Layout<sizeof...(Ts)> layout{};
+		size_t offset = 0;
+		size_t alignment = 1;
+		for(size_t i = 0; i < sizeof...(Ts); ++i)
+		{
+			offset = AlignUp(offset, alignments[i]);
+			layout.Offsets[i] = offset;
+			offset += sizes[i];
+			alignment = alignments[i] > alignment ? alignments[i] : alignment;
+		}
+		layout.Alignment = alignment;
+		layout.BlockSize = AlignUp(offset, alignment);
+		return layout;
+	}
+
+	constexpr size_t Log2(size_t value)
+	{
+		size_t log = 0;
+		while(value > 1)
+		{
+			value >>= 1;
+			++log;
+		}
+		return log;
+	}
+}
+
+/**
+	\class AoSoA
+
+	Array of structures of arrays. The elements are grouped into blocks of \c Lanes elements, and within a block
+	every member gets its own run of \c Lanes values, aligned to the width of the register those values would be
+	loaded into (capped at a cache line). With 8 lanes a block of <float, float, float> looks like
+
+		x0..x7 | y0..y7 | z0..z7
+
+	...where every run of 8 floats starts on a 32 byte boundary. A kernel that walks the blocks can then load a
+	whole register of one member at a time, without gathers and without touching members it doesn't need.
+
+	Members are stored whole, so the lanes of a compound member stay interleaved. A block of <Vector3, float>
+	holds a Vector3[8] (x0 y0 z0 x1 y1 z1 ...) followed by a float[8]. Split compound members up into their
+	components to get one run per component.
+
+	Lanes past the end of the container always hold value initialized members, so kernels can process every block
+	at full width and never need a scalar loop for the tail.
+
+	Elements can be reached one at a time with the same soa_index/_soa syntax as SOA (container[1_soa][index]), or
+	a block at a time with GetBlock and Blocks (block[1_soa] is a pointer to that member's Lanes values).
+
+	\note Members have to be trivially copyable, the blocks are moved around with memcpy.
+	\warning Growing the container invalidates every block and column.
+ **/
+template<size_t Lanes, class... Ts>
+class AoSoA final
+{
+	static_assert(Lanes > 0 && (Lanes & (Lanes - 1)) == 0, "the number of lanes has to be a power of two");
+	static_assert((... && eastl::is_trivially_copyable<Ts>::value), "AoSoA members have to be trivially copyable");
+
+	static constexpr AoSoADetail::Layout<sizeof...(Ts)> s_layout = AoSoADetail::ComputeLayout<Lanes, Ts...>();
+	static constexpr size_t LaneShift = AoSoADetail::Log2(Lanes);
+	static constexpr size_t LaneMask = Lanes - 1;
+
+public:
+	template<size_t I>
+	using Element_t = eastl::tuple_element_t<I, eastl::tuple<Ts...>>;
+
+	static constexpr size_t NumLanes = Lanes;
+	static constexpr size_t BlockSize = s_layout.BlockSize;
+	static constexpr size_t BlockAlignment = s_layout.Alignment;
+
+	/**
+		A single member of every element, indexed by element.
+	 **/
+	template<class T>
+	class Column
+	{
+	public:
+		Column(char* blocks, size_t offset)
+		: _blocks(blocks)
+		, _offset(offset)
+		{
+		}
+
+		T& operator[](size_t index) const
+		{
+			return reinterpret_cast<T*>(_blocks + (index >> LaneShift) * BlockSize + _offset)[index & LaneMask];
+		}
+
+	private:
+		char*  _blocks;
+		size_t _offset;
+	};
+
+	/**
+		One block of \c Lanes elements. block[I] points at the Lanes values of member I.
+	 **/
+	template<bool IsConst>
+	class Block
+	{
+		using Byte_t = typename eastl::conditional<IsConst, const char, char>::type;
+	public:
+		Block(Byte_t* block, size_t count)
+		: _block(block)
+		, _count(count)
+		{
+		}
+
+		template<size_t I>
+		auto operator[](soa_index<I>) const
+		{
+			using Element = typename eastl::conditional<IsConst, const Element_t<I>, Element_t<I>>::type;
+			return reinterpret_cast<Element*>(_block + s_layout.Offsets[I]);
+		}
+
+		/**
+			Retrieve the number of lanes in this block that hold live elements. Only the last block can have fewer
+			than Lanes.
+		 **/
+		size_t GetCount() const { return _count; }
+
+	private:
+		Byte_t* _block;
+		size_t  _count;
+	};
+
+	template<bool IsConst>
+	class BlockIterator
+	{
+		using Owner_t = typename eastl::conditional<IsConst, const AoSoA, AoSoA>::type;
+	public:
+		BlockIterator(Owner_t* owner, size_t block)
+		: _owner(owner)
+		, _block(block)
+		{
+		}
+
+		Block<IsConst> operator*() const { return _owner->GetBlock(_block); }
+
+		BlockIterator& operator++()
+		{
+			++_block;
+			return *this;
+		}
+
+		bool operator==(const BlockIterator& other) const { return _block == other._block; }
+		bool operator!=(const BlockIterator& other) const { return _block != other._block; }
+
+	private:
+		Owner_t* _owner;
+		size_t   _block;
+	};
+
+	template<bool IsConst>
+	struct BlockRange
+	{
+		BlockIterator<IsConst> First;
+		BlockIterator<IsConst> Last;
+
+		BlockIterator<IsConst> begin() const { return First; }
+		BlockIterator<IsConst> end() const { return Last; }
+	};
+
+	AoSoA() {}
+
+	~AoSoA()
+	{
+		libCore::Free(_blocks);
+	}
+
+	AoSoA(AoSoA&& other)
+	: _blocks(other._blocks)
+	, _size(other._size)
+	, _numBlocks(other._numBlocks)
+	{
+		other._blocks = nullptr;
+		other._size = 0;
+		other._numBlocks = 0;
+	}
+
+	AoSoA& operator=(AoSoA&& other)
+	{
+		if(this != &other)
+		{
+			libCore::Free(_blocks);
+			_blocks = other._blocks;
+			_size = other._size;
+			_numBlocks = other._numBlocks;
+			other._blocks = nullptr;
+			other._size = 0;
+			other._numBlocks = 0;
+		}
+		return *this;
+	}
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	size_t capacity() const { return _numBlocks * Lanes; }
+
+	/**
+		Retrieve the number of blocks that hold live elements.
+	 **/
+	size_t GetNumBlocks() const { return (_size + LaneMask) >> LaneShift; }
+
+	/**
+		Make room for at least \c numElements elements. Capacity is always a whole number of blocks.
+	 **/
+	void reserve(size_t numElements)
+	{
+		const size_t numBlocks = (numElements + LaneMask) >> LaneShift;
+		if(numBlocks <= _numBlocks)
+		{
+			return;
+		}
+
+		char* blocks = static_cast<char*>(libCore::AlignedAlloc(numBlocks * BlockSize, BlockAlignment));
+		FIRE_ASSERT(blocks != nullptr);
+		if(_blocks)
+		{
+			memcpy(blocks, _blocks, _numBlocks * BlockSize);
+			libCore::Free(_blocks);
+		}
+		for(size_t block = _numBlocks; block < numBlocks; ++block)
+		{
+			ResetLanes(blocks + block * BlockSize, 0, Lanes);
+		}
+		_blocks = blocks;
+		_numBlocks = numBlocks;
+	}
+
+	/**
+		Grow or shrink the container to \c numElements. New elements are value initialized.
+	 **/
+	void resize(size_t numElements)
+	{
+		if(numElements > _size)
+		{
+			reserve(numElements);
+		}
+		else
+		{
+			ResetRange(numElements, _size);
+		}
+		_size = numElements;
+	}
+
+	/**
+		Append a value initialized element and return its index.
+	 **/
+	size_t push_back()
+	{
+		Grow();
+		return _size++;
+	}
+
+	/**
+		Append an element and return its index.
+	 **/
+	size_t push_back(const Ts&... members)
+	{
+		Grow();
+		StoreAt(_size, eastl::make_index_sequence<sizeof...(Ts)>(), members...);
+		return _size++;
+	}
+
+	void pop_back()
+	{
+		FIRE_ASSERT_MSG(_size > 0, "can not pop_back an empty AoSoA");
+		--_size;
+		ResetRange(_size, _size + 1);
+	}
+
+	/**
+		Remove the element at \c index by moving the last element into its place.
+	 **/
+	void erase_unsorted(size_t index)
+	{
+		FIRE_ASSERT_MSG(index < _size, "index out of bounds");
+		const size_t last = _size - 1;
+		if(index != last)
+		{
+			CopyElement(last, index, eastl::make_index_sequence<sizeof...(Ts)>());
+		}
+		pop_back();
+	}
+
+	/**
+		Remove every element. The memory is kept around.
+	 **/
+	void clear()
+	{
+		ResetRange(0, _size);
+		_size = 0;
+	}
+
+	template<size_t I>
+	Column<Element_t<I>> operator[](soa_index<I>)
+	{
+		return Column<Element_t<I>>(_blocks, s_layout.Offsets[I]);
+	}
+
+	template<size_t I>
+	Column<const Element_t<I>> operator[](soa_index<I>) const
+	{
+		return Column<const Element_t<I>>(_blocks, s_layout.Offsets[I]);
+	}
+
+	Block<false> GetBlock(size_t block)
+	{
+		return Block<false>(_blocks + block * BlockSize, GetBlockCount(block));
+	}
+
+	Block<true> GetBlock(size_t block) const
+	{
+		return Block<true>(_blocks + block * BlockSize, GetBlockCount(block));
+	}
+
+	/**
+		Range over the blocks that hold live elements, for use with range based for.
+	 **/
+	BlockRange<false> Blocks()
+	{
+		return BlockRange<false>{ BlockIterator<false>(this, 0), BlockIterator<false>(this, GetNumBlocks()) };
+	}
+
+	BlockRange<true> Blocks() const
+	{
+		return BlockRange<true>{ BlockIterator<true>(this, 0), BlockIterator<true>(this, GetNumBlocks()) };
+	}
+
+private:
+	AoSoA(const AoSoA&) = delete;
+	AoSoA& operator=(const AoSoA&) = delete;
+
+	size_t GetBlockCount(size_t block) const
+	{
+		const size_t first = block << LaneShift;
+		return _size - first < Lanes ? _size - first : Lanes;
+	}
+
+	void Grow()
+	{
+		if(_size == capacity())
+		{
+			reserve(_numBlocks == 0 ? Lanes : capacity() * 2);
+		}
+	}
+
+	template<size_t I>
+	Element_t<I>* GetLanes(char* block) const
+	{
+		return reinterpret_cast<Element_t<I>*>(block + s_layout.Offsets[I]);
+	}
+
+	char* GetBlockOf(size_t index) const
+	{
+		return _blocks + (index >> LaneShift) * BlockSize;
+	}
+
+	template<size_t... Is>
+	void ResetLanes(char* block, size_t first, size_t last, eastl::index_sequence<Is...>)
+	{
+		(..., eastl::fill(GetLanes<Is>(block) + first, GetLanes<Is>(block) + last, Element_t<Is>()));
+	}
+
+	void ResetLanes(char* block, size_t first, size_t last)
+	{
+		ResetLanes(block, first, last, eastl::make_index_sequence<sizeof...(Ts)>());
+	}
+
+	// puts the lanes of [first, last) back to value initialized so that kernels can keep running over them.
+	void ResetRange(size_t first, size_t last)
+	{
+		while(first < last)
+		{
+			const size_t lane = first & LaneMask;
+			const size_t count = eastl::min(Lanes - lane, last - first);
+			ResetLanes(GetBlockOf(first), lane, lane + count);
+			first += count;
+		}
+	}
+
+	template<size_t... Is>
+	void StoreAt(size_t index, eastl::index_sequence<Is...>, const Ts&... members)
+	{
+		char* block = GetBlockOf(index);
+		(..., (GetLanes<Is>(block)[index & LaneMask] = members));
+	}
+
+	template<size_t... Is>
+	void CopyElement(size_t from, size_t to, eastl::index_sequence<Is...>)
+	{
+		char* fromBlock = GetBlockOf(from);
+		char* toBlock = GetBlockOf(to);
+		(..., (GetLanes<Is>(toBlock)[to & LaneMask] = GetLanes<Is>(fromBlock)[from & LaneMask]));
+	}
+
+	char*  _blocks{ nullptr };
+	size_t _size{ 0 };
+	size_t _numBlocks{ 0 };
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
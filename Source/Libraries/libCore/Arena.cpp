@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Arena
+//
+//  Bump allocators for memory that all dies at the same time, and EASTL allocators that sit on top of them.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "Arena.h"
+#include "Assert.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LinearArena::LinearArena(size_t blockSize)
+: _blockSize(blockSize)
+{
+	_first = _current = AllocateBlock(_blockSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LinearArena::~LinearArena()
+{
+	Block* block = _first;
+	while(block)
+	{
+		Block* next = block->Next;
+		libCore::Free(block);
+		block = next;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* LinearArena::Allocate(size_t size, size_t alignment)
+{
+	FIRE_ASSERT_MSG((alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+
+	for(;;)
+	{
+		// align the address rather than the offset, the block itself is only aligned to max_align_t.
+		uintptr_t base = reinterpret_cast<uintptr_t>(_current->Data());
+		size_t offset = AlignUp(base + _current->Offset, alignment) - base;
+		if(offset + size <= _current->Size)
+		{
+			_current->Offset = offset + size;
+			return _current->Data() + offset;
+		}
+
+		// reuse the next block in the chain if it's big enough (it will be after a Rewind), otherwise slot a
+		// fresh one in after the current block.
+		Block* next = _current->Next;
+		if(next == nullptr || next->Size < size + alignment)
+		{
+			Block* block = AllocateBlock(eastl::max(_blockSize, size + alignment));
+			block->Next = next;
+			_current->Next = block;
+			next = block;
+		}
+		_current = next;
+		_current->Offset = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LinearArena::Marker LinearArena::GetMarker() const
+{
+	return Marker{ _current, _current->Offset };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LinearArena::Rewind(const Marker& marker)
+{
+	_current = marker.CurrentBlock;
+	_current->Offset = marker.Offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void LinearArena::Reset()
+{
+	if(_first->Next)
+	{
+		// we needed more than one block last time around. fold them into one big enough for all of it.
+		size_t capacity = GetCapacity();
+		Block* block = _first;
+		while(block)
+		{
+			Block* next = block->Next;
+			libCore::Free(block);
+			block = next;
+		}
+		_first = AllocateBlock(capacity);
+	}
+	_current = _first;
+	_current->Offset = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t LinearArena::GetBytesAllocated() const
+{
+	size_t bytes = 0;
+	for(Block* block = _first; block; block = block->Next)
+	{
+		bytes += block->Offset;
+		if(block == _current)
+		{
+			break;
+		}
+	}
+	return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t LinearArena::GetCapacity() const
+{
+	size_t capacity = 0;
+	for(Block* block = _first; block; block = block->Next)
+	{
+		capacity += block->Size;
+	}
+	return capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LinearArena::Block* LinearArena::AllocateBlock(size_t size)
+{
+	Block* block = static_cast<Block*>(libCore::AlignedAlloc(sizeof(Block) + size, alignof(std::max_align_t)));
+	FIRE_ASSERT_MSG(block != nullptr, "LinearArena failed to allocate a block");
+	block->Next = nullptr;
+	block->Size = size;
+	block->Offset = 0;
+	return block;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameArena::FrameArena(size_t numBuffers, size_t bytesPerFrame)
+: _numBuffers(numBuffers)
+{
+	FIRE_ASSERT_MSG(numBuffers >= 1 && numBuffers <= MaxBuffers, "FrameArena supports between 1 and 3 buffers");
+	for(size_t i = 0; i < _numBuffers; ++i)
+	{
+		_buffers[i].Capacity = bytesPerFrame;
+		_buffers[i].Memory = static_cast<char*>(libCore::AlignedAlloc(bytesPerFrame, 64));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameArena::~FrameArena()
+{
+	for(size_t i = 0; i < _numBuffers; ++i)
+	{
+		for(void* overflow : _buffers[i].Overflow)
+		{
+			libCore::Free(overflow);
+		}
+		libCore::Free(_buffers[i].Memory);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	FIRE_ASSERT_MSG((alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+
+	Buffer& buffer = _buffers[_currentBuffer];
+	uintptr_t base = reinterpret_cast<uintptr_t>(buffer.Memory);
+
+	size_t offset = buffer.Offset.load(std::memory_order_relaxed);
+	for(;;)
+	{
+		size_t aligned = AlignUp(base + offset, alignment) - base;
+		size_t end = aligned + size;
+		if(end > buffer.Capacity)
+		{
+			return AllocateOverflow(buffer, size, alignment);
+		}
+		if(buffer.Offset.compare_exchange_weak(offset, end, std::memory_order_relaxed))
+		{
+			return buffer.Memory + aligned;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FrameArena::EndFrame()
+{
+	++_frameNumber;
+	_currentBuffer = (_currentBuffer + 1) % _numBuffers;
+
+	Buffer& buffer = _buffers[_currentBuffer];
+	if(!buffer.Overflow.empty())
+	{
+		for(void* overflow : buffer.Overflow)
+		{
+			libCore::Free(overflow);
+		}
+		buffer.Overflow.clear();
+
+		// grow so that the same amount of work fits next time.
+		libCore::Free(buffer.Memory);
+		buffer.Capacity = AlignUp(buffer.Capacity + buffer.OverflowBytes, 64 * 1024);
+		buffer.Memory = static_cast<char*>(libCore::AlignedAlloc(buffer.Capacity, 64));
+		buffer.OverflowBytes = 0;
+	}
+	buffer.Offset.store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t FrameArena::GetBytesAllocated() const
+{
+	return _buffers[_currentBuffer].Offset.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t FrameArena::GetNumOverflowAllocations() const
+{
+	return _buffers[_currentBuffer].Overflow.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameArena& FrameArena::Get()
+{
+	static FrameArena s_frameArena;
+	return s_frameArena;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void* FrameArena::AllocateOverflow(Buffer& buffer, size_t size, size_t alignment)
+{
+	void* memory = libCore::AlignedAlloc(size, eastl::max(alignment, alignof(std::max_align_t)));
+	std::unique_lock<mutex> lock(buffer.OverflowLock);
+	buffer.Overflow.push_back(memory);
+	buffer.OverflowBytes += size + alignment;
+	return memory;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LinearArena& ScratchArena::Get()
+{
+	static thread_local LinearArena tl_scratch;
+	return tl_scratch;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
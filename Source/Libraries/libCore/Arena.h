@@ -0,0 +1,327 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Arena
+//
+//  Bump allocators for memory that all dies at the same time, and EASTL allocators that sit on top of them.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_ARENA_H_
+#define LIBCORE_ARENA_H_
+#pragma once
+
+#include "libCore.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class LinearArena
+
+	Single threaded bump allocator. Allocations are carved off the end of the current block and are never freed
+	individually. Instead the whole arena is Reset, or Rewound back to a Marker taken earlier.
+
+	When a block runs out a new one is chained on. On Reset a chain of blocks gets folded into a single block big
+	enough to hold all of it, so an arena that's reused every frame settles on one block after the first frame.
+ **/
+class LinearArena final
+{
+	struct Block;
+public:
+	static const size_t DefaultBlockSize = 64 * 1024;
+
+	struct Marker
+	{
+		Block* CurrentBlock;
+		size_t Offset;
+	};
+
+	explicit LinearArena(size_t blockSize = DefaultBlockSize);
+	~LinearArena();
+
+	/**
+		Allocate \c size bytes aligned to \c alignment, which must be a power of two.
+	 **/
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template <class T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	/**
+		Retrieve a Marker for the current position in the arena.
+	 **/
+	Marker GetMarker() const;
+
+	/**
+		Throw away everything that was allocated since \c marker was taken.
+	 **/
+	void Rewind(const Marker& marker);
+
+	/**
+		Throw away everything that was allocated from the arena.
+	 **/
+	void Reset();
+
+	/**
+		Retrieve the number of bytes that are currently handed out, including alignment padding.
+	 **/
+	size_t GetBytesAllocated() const;
+
+	/**
+		Retrieve the total size of every block the arena owns.
+	 **/
+	size_t GetCapacity() const;
+
+private:
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	struct Block
+	{
+		Block* Next;
+		size_t Size;
+		size_t Offset;
+
+		char* Data() { return reinterpret_cast<char*>(this + 1); }
+	};
+
+	static Block* AllocateBlock(size_t size);
+
+	Block* _first{ nullptr };
+	Block* _current{ nullptr };
+	size_t _blockSize;
+};
+
+/**
+	\class FrameArena
+
+	Bump allocator for memory that only needs to live for a frame or two. The arena keeps two or three buffers and
+	moves on to the next one every time EndFrame is called, so memory allocated during a frame stays valid until
+	EndFrame has been called once per buffer (i.e. through the end of the next frame when double buffered).
+
+	Allocate may be called from any thread. The fast path is a single CAS on the current buffer. When a buffer runs
+	out the allocation spills to the heap under a lock, and the buffer grows at its next reset so that it doesn't
+	spill again.
+
+	\note The engine wide FrameArena is FrameArena::Get, and is advanced at the end of every iteration of
+	Application::Run.
+ **/
+class FrameArena final
+{
+public:
+	static const size_t MaxBuffers = 3;
+	static const size_t DefaultBytesPerFrame = 1024 * 1024;
+
+	explicit FrameArena(size_t numBuffers = 2, size_t bytesPerFrame = DefaultBytesPerFrame);
+	~FrameArena();
+
+	/**
+		Allocate \c size bytes aligned to \c alignment out of the current frame's buffer.
+	 **/
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template <class T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	/**
+		Move on to the next buffer, throwing away whatever was allocated from it the last time around.
+
+		\warning No other thread may be allocating from the arena while this runs.
+	 **/
+	void EndFrame();
+
+	/**
+		Retrieve the number of times EndFrame has been called.
+	 **/
+	uint64_t GetFrameNumber() const { return _frameNumber; }
+
+	/**
+		Retrieve the number of bytes allocated from the current frame's buffer.
+	 **/
+	size_t GetBytesAllocated() const;
+
+	/**
+		Retrieve the number of allocations this frame that didn't fit in the buffer and went to the heap.
+	 **/
+	size_t GetNumOverflowAllocations() const;
+
+	/**
+		Retrieve the FrameArena the engine resets every frame.
+	 **/
+	static FrameArena& Get();
+
+private:
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	struct Buffer
+	{
+		char*          Memory{ nullptr };
+		size_t         Capacity{ 0 };
+		atomic<size_t> Offset{ 0 };
+
+		mutex          OverflowLock;
+		vector<void*>  Overflow;
+		size_t         OverflowBytes{ 0 };
+	};
+
+	void* AllocateOverflow(Buffer& buffer, size_t size, size_t alignment);
+
+	Buffer   _buffers[MaxBuffers];
+	size_t   _numBuffers;
+	size_t   _currentBuffer{ 0 };
+	uint64_t _frameNumber{ 0 };
+};
+
+/**
+	\class ScratchArena
+
+	A LinearArena per thread for temporaries that die before the function that made them returns. Take a
+	ScratchArena::Scope on the way in and everything allocated from the thread's scratch arena afterwards is thrown
+	away when the Scope goes out of scope.
+
+	\warning Scratch containers must not outlive the Scope they were made in, and must not grow inside a nested
+	Scope.
+ **/
+class ScratchArena final
+{
+public:
+	/**
+		Retrieve the scratch arena for the calling thread.
+	 **/
+	static LinearArena& Get();
+
+	static void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+	{
+		return Get().Allocate(size, alignment);
+	}
+
+	class Scope final
+	{
+	public:
+		Scope()
+		: _arena(ScratchArena::Get())
+		, _marker(_arena.GetMarker())
+		{
+		}
+
+		~Scope()
+		{
+			_arena.Rewind(_marker);
+		}
+
+	private:
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		LinearArena& _arena;
+		LinearArena::Marker _marker;
+	};
+};
+
+/**
+	\class ArenaAllocator
+
+	EASTL allocator that takes its memory from an arena. A default constructed allocator uses whatever arena
+	\c GetDefault returns, so containers can be declared without having to thread an arena through to them.
+	deallocate is a no-op, the memory goes back when the arena is reset.
+ **/
+template <class Arena_t, Arena_t& (*GetDefault)()>
+class ArenaAllocator
+{
+public:
+	explicit ArenaAllocator(const char* name = "ArenaAllocator")
+	: _arena(&GetDefault())
+#if EASTL_NAME_ENABLED
+	, _name(name)
+#endif
+	{
+	}
+
+	explicit ArenaAllocator(Arena_t& arena, const char* name = "ArenaAllocator")
+	: _arena(&arena)
+#if EASTL_NAME_ENABLED
+	, _name(name)
+#endif
+	{
+	}
+
+	ArenaAllocator(const ArenaAllocator& other) = default;
+
+	ArenaAllocator(const ArenaAllocator& other, const char* name)
+	: _arena(other._arena)
+#if EASTL_NAME_ENABLED
+	, _name(name)
+#endif
+	{
+	}
+
+	ArenaAllocator& operator=(const ArenaAllocator& other) = default;
+
+	void* allocate(size_t n, int flags = 0)
+	{
+		return _arena->Allocate(n, EASTL_ALLOCATOR_MIN_ALIGNMENT);
+	}
+
+	void* allocate(size_t n, size_t alignment, size_t offset, int flags = 0)
+	{
+		if(offset == 0)
+		{
+			return _arena->Allocate(n, alignment);
+		}
+		// EASTL wants (ptr + offset) to be aligned. over-allocate and nudge the pointer so that it is.
+		char* block = static_cast<char*>(_arena->Allocate(n + alignment, alignment));
+		size_t misalignment = offset & (alignment - 1);
+		return misalignment ? block + (alignment - misalignment) : block;
+	}
+
+	void deallocate(void* p, size_t n)
+	{
+	}
+
+	const char* get_name() const
+	{
+#if EASTL_NAME_ENABLED
+		return _name;
+#else
+		return "ArenaAllocator";
+#endif
+	}
+
+	void set_name(const char* name)
+	{
+#if EASTL_NAME_ENABLED
+		_name = name;
+#endif
+	}
+
+	Arena_t& GetArena() const { return *_arena; }
+
+	bool operator==(const ArenaAllocator& other) const { return _arena == other._arena; }
+	bool operator!=(const ArenaAllocator& other) const { return _arena != other._arena; }
+
+private:
+	Arena_t* _arena;
+#if EASTL_NAME_ENABLED
+	const char* _name;
+#endif
+};
+
+using FrameAllocator = ArenaAllocator<FrameArena, &FrameArena::Get>;
+using ScratchAllocator = ArenaAllocator<LinearArena, &ScratchArena::Get>;
+
+template <class T> using FrameVector = eastl::vector<T, FrameAllocator>;
+using FrameString = eastl::basic_string<char, FrameAllocator>;
+
+template <class T> using ScratchVector = eastl::vector<T, ScratchAllocator>;
+using ScratchString = eastl::basic_string<char, ScratchAllocator>;
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  AtomicWait
+//
+//  Lets a thread sleep until an atomic changes value. Backed by futex on linux and WaitOnAddress on windows.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "AtomicWait.h"
+
+#ifdef FIRE_PLATFORM_WINDOWS
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#endif
+
+#ifdef FIRE_PLATFORM_UNIX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t), "atomic<uint32_t> must be layout compatible with uint32_t");
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef FIRE_PLATFORM_WINDOWS
+bool AtomicWait::Wait(atomic<uint32_t>& address, uint32_t expected, uint32_t timeoutMs)
+{
+	DWORD timeout = timeoutMs == Infinite ? INFINITE : static_cast<DWORD>(timeoutMs);
+	if(!WaitOnAddress(&address, &expected, sizeof(uint32_t), timeout))
+	{
+		return GetLastError() != ERROR_TIMEOUT;
+	}
+	return true;
+}
+
+void AtomicWait::WakeOne(atomic<uint32_t>& address)
+{
+	WakeByAddressSingle(&address);
+}
+
+void AtomicWait::WakeAll(atomic<uint32_t>& address)
+{
+	WakeByAddressAll(&address);
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef FIRE_PLATFORM_UNIX
+bool AtomicWait::Wait(atomic<uint32_t>& address, uint32_t expected, uint32_t timeoutMs)
+{
+	timespec timeout;
+	timespec* timeoutPtr = nullptr;
+	if(timeoutMs != Infinite)
+	{
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_nsec = (timeoutMs % 1000) * 1000000;
+		timeoutPtr = &timeout;
+	}
+	// FUTEX_PRIVATE_FLAG since nothing here is shared across processes.
+	long result = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&address), FUTEX_WAIT_PRIVATE, expected, timeoutPtr, nullptr, 0);
+	return !(result == -1 && errno == ETIMEDOUT);
+}
+
+void AtomicWait::WakeOne(atomic<uint32_t>& address)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&address), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void AtomicWait::WakeAll(atomic<uint32_t>& address)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&address), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
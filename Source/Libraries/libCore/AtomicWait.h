@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  AtomicWait
+//
+//  Lets a thread sleep until an atomic changes value. Backed by futex on linux and WaitOnAddress on windows.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_ATOMICWAIT_H_
+#define LIBCORE_ATOMICWAIT_H_
+#pragma once
+
+#include "libCore.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+struct AtomicWait final
+{
+	static const uint32_t Infinite = 0xFFFFFFFF;
+
+	/**
+		Put the calling thread to sleep for as long as \c address still holds \c expected. Returns false if the
+		wait timed out and true otherwise. Spurious wakeups are allowed, so always re-check the value after this returns.
+	 **/
+	static bool Wait(atomic<uint32_t>& address, uint32_t expected, uint32_t timeoutMs = Infinite);
+
+	/**
+		Wake a single thread that is waiting on \c address.
+	 **/
+	static void WakeOne(atomic<uint32_t>& address);
+
+	/**
+		Wake every thread that is waiting on \c address.
+	 **/
+	static void WakeAll(atomic<uint32_t>& address);
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
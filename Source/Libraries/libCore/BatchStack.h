@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  BatchStack
+//
+//  A lock free stack of batches of free blocks, for allocators that trade free blocks between threads in batches.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_BATCHSTACK_H_
+#define LIBCORE_BATCHSTACK_H_
+#pragma once
+
+#include "libCore.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	Lives in the storage of a free block. The blocks of a batch are chained through Next, and the first block of
+	a batch that sits in a BatchStack also records the batch under it and how many blocks it has.
+ **/
+struct BatchNode
+{
+	BatchNode* Next;
+	BatchNode* NextBatch;
+	size_t     BatchCount;
+};
+
+/**
+	\class BatchStack
+
+	A Treiber stack whose entries are whole batches of free blocks, so that a thread can hand over or take a batch
+	with a single compare and swap.
+
+	The head packs a 16 bit ABA tag into the bits of the pointer that user space never uses. Every push and pop
+	bumps it, so a pop that read a batch which has been popped and pushed again since fails instead of putting a
+	stale NextBatch on top.
+
+	\warning Pop may read the first block of a batch that another thread has just taken. The memory the blocks
+	live in must not be handed back while the stack can still be popped.
+ **/
+class BatchStack final
+{
+public:
+	static const uint64_t TagShift = 48;
+	static const uint64_t PointerMask = (uint64_t(1) << TagShift) - 1;
+
+	/**
+		Check that blocks at \c address leave the tag bits free, which every user space address on x64 and ARM64
+		does.
+	 **/
+	static bool CanHold(const void* address)
+	{
+		return (reinterpret_cast<uint64_t>(address) & ~PointerMask) == 0;
+	}
+
+	/**
+		Push the batch of \c count blocks that starts at \c first.
+	 **/
+	void Push(BatchNode* first, size_t count)
+	{
+		first->BatchCount = count;
+		uint64_t head = _head.load(std::memory_order_relaxed);
+		do
+		{
+			first->NextBatch = Unpack(head);
+		} while(!_head.compare_exchange_weak(head, Pack(first, head), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	/**
+		Pop the batch on top, or return nullptr if the stack is empty.
+
+		\param count Set to the number of blocks in the batch, or 0 if the stack is empty.
+	 **/
+	BatchNode* Pop(size_t& count)
+	{
+		uint64_t head = _head.load(std::memory_order_acquire);
+		for(;;)
+		{
+			BatchNode* first = Unpack(head);
+			if(first == nullptr)
+			{
+				count = 0;
+				return nullptr;
+			}
+			// first may have been popped and handed out already, in which case NextBatch is junk. the tag makes
+			// the CAS fail in that case.
+			if(_head.compare_exchange_weak(head, Pack(first->NextBatch, head), std::memory_order_acquire, std::memory_order_acquire))
+			{
+				count = first->BatchCount;
+				return first;
+			}
+		}
+	}
+
+private:
+	static BatchNode* Unpack(uint64_t head)
+	{
+		return reinterpret_cast<BatchNode*>(head & PointerMask);
+	}
+
+	static uint64_t Pack(BatchNode* node, uint64_t oldHead)
+	{
+		return reinterpret_cast<uint64_t>(node) | (((oldHead >> TagShift) + 1) << TagShift);
+	}
+
+	atomic<uint64_t> _head{ 0 };
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
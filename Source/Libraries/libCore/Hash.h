@@ -11,23 +11,699 @@
 #define LIBCORE_HASH_H_
 #pragma once
 
+#include "libCore.h"
+#include "Assert.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FIRE_HASH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FIRE_HASH_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class HashString
+
+	FNV-1a over a string, \c KeySize bits wide. Everything is constexpr so string literals can be hashed at compile
+	time.
+ **/
 template<size_t KeySize>
-struct HashString
+struct HashString;
+
+template<>
+struct HashString<32>
 {
+	using Value_t = uint32_t;
+	static const Value_t OffsetBasis = 2166136261u;
+	static const Value_t Prime = 16777619u;
+
+	static constexpr Value_t Hash(const char* str, size_t length)
+	{
+		Value_t hash = OffsetBasis;
+		for(size_t i = 0; i < length; ++i)
+		{
+			hash = (hash ^ static_cast<uint8_t>(str[i])) * Prime;
+		}
+		return hash;
+	}
+
+	static constexpr Value_t Hash(const char* str)
+	{
+		Value_t hash = OffsetBasis;
+		for(; *str; ++str)
+		{
+			hash = (hash ^ static_cast<uint8_t>(*str)) * Prime;
+		}
+		return hash;
+	}
 };
 
 template<>
 struct HashString<64>
 {
+	using Value_t = uint64_t;
+	static const Value_t OffsetBasis = 14695981039346656037ull;
+	static const Value_t Prime = 1099511628211ull;
+
+	static constexpr Value_t Hash(const char* str, size_t length)
+	{
+		Value_t hash = OffsetBasis;
+		for(size_t i = 0; i < length; ++i)
+		{
+			hash = (hash ^ static_cast<uint8_t>(str[i])) * Prime;
+		}
+		return hash;
+	}
+
+	static constexpr Value_t Hash(const char* str)
+	{
+		Value_t hash = OffsetBasis;
+		for(; *str; ++str)
+		{
+			hash = (hash ^ static_cast<uint8_t>(*str)) * Prime;
+		}
+		return hash;
+	}
 };
 
+#if defined(_MSC_VER)
+#define FIRE_FUNCTION_SIGNATURE __FUNCSIG__
+#else
+#define FIRE_FUNCTION_SIGNATURE __PRETTY_FUNCTION__
+#endif
+
+/**
+	Retrieve a 64 bit hash that identifies \c T. It's made from the compiler's spelling of the type, so it's stable
+	across runs of the same build but not across compilers.
+ **/
+template<class T>
+inline uint64_t GetTypeHash()
+{
+	static const uint64_t s_hash = HashString<64>::Hash(FIRE_FUNCTION_SIGNATURE);
+	return s_hash;
+}
+
+namespace HashDetail
+{
+	// control byte of a slot that holds nothing. full slots store the low 7 bits of their hash, so only empty
+	// slots have the high bit set.
+	static const int8_t kEmpty = static_cast<int8_t>(0x80);
+
+	inline uint32_t CountTrailingZeros(uint64_t value)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if(_BitScanForward(&index, static_cast<uint32_t>(value)))
+		{
+			return static_cast<uint32_t>(index);
+		}
+		_BitScanForward(&index, static_cast<uint32_t>(value >> 32));
+		return static_cast<uint32_t>(index) + 32;
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+	// eastl::hash is the identity for integers and pointers, so the bits get stirred before they're split up into
+	// the slot index and the 7 bit tag.
+	inline uint64_t Mix(uint64_t hash)
+	{
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	/**
+		A window of control bytes that gets checked all at once. Every match comes back as a mask with one bit set
+		per matching byte (or one byte set per matching byte when there's no SIMD to lean on, hence Shift).
+	 **/
+	struct Group
+	{
+#if defined(FIRE_HASH_AVX2)
+		static const size_t Width = 32;
+		static const uint32_t Shift = 0;
+
+		explicit Group(const int8_t* ctrl)
+		: _ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl)))
+		{
+		}
+
+		uint64_t Match(int8_t tag) const
+		{
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_ctrl, _mm256_set1_epi8(tag))));
+		}
+
+		uint64_t MatchEmpty() const
+		{
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_ctrl));
+		}
+
+		__m256i _ctrl;
+#elif defined(FIRE_HASH_SSE2)
+		static const size_t Width = 16;
+		static const uint32_t Shift = 0;
+
+		explicit Group(const int8_t* ctrl)
+		: _ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl)))
+		{
+		}
+
+		uint64_t Match(int8_t tag) const
+		{
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_ctrl, _mm_set1_epi8(tag))));
+		}
+
+		uint64_t MatchEmpty() const
+		{
+			return static_cast<uint32_t>(_mm_movemask_epi8(_ctrl));
+		}
+
+		__m128i _ctrl;
+#else
+		static const size_t Width = 8;
+		static const uint32_t Shift = 3;
+
+		explicit Group(const int8_t* ctrl)
+		{
+			memcpy(&_ctrl, ctrl, sizeof(_ctrl));
+		}
+
+		// may report a false positive next to a real match. that's fine, every match gets its key compared anyway.
+		uint64_t Match(int8_t tag) const
+		{
+			const uint64_t lsbs = 0x0101010101010101ull;
+			uint64_t x = _ctrl ^ (lsbs * static_cast<uint8_t>(tag));
+			return (x - lsbs) & ~x & (lsbs << 7);
+		}
+
+		uint64_t MatchEmpty() const
+		{
+			return _ctrl & 0x8080808080808080ull;
+		}
+
+		uint64_t _ctrl;
+#endif
+	};
+}
+
+/**
+	\class Hash
+
+	Open addressing hash map that stores its entries inline in one flat allocation, in the style of SwissTable.
+
+	Every slot has a control byte alongside it that holds 7 bits of the key's hash, or kEmpty. Lookups start at the
+	slot the hash maps to and compare a whole group of control bytes at once (32 with AVX2, 16 with SSE2, 8 with
+	plain 64 bit math otherwise), so only the keys whose 7 bit tag matched ever get compared.
+
+	Probing is linear and deletion shifts the entries that follow back into the hole (Knuth's algorithm R), so
+	there are no tombstones and lookups never slow down after a lot of erases. The table grows once it's 7/8
+	full.
+
+	\note value_type is a pair<Key_t, Value_t>. Don't change the key of an entry in place.
+	\warning Inserting invalidates every iterator and pointer into the table. Erasing can move the entries that
+	come after the erased one.
+ **/
+template<class Key_t, class Value_t, class Hasher_t = eastl::hash<Key_t>, class Equal_t = eastl::equal_to<Key_t>>
 class Hash final
 {
+	using Group = HashDetail::Group;
 public:
+	using key_type = Key_t;
+	using mapped_type = Value_t;
+	using value_type = eastl::pair<Key_t, Value_t>;
+	using size_type = size_t;
+
+	template<bool IsConst>
+	class Iterator
+	{
+		friend class Hash;
+		using Table_t = typename eastl::conditional<IsConst, const Hash, Hash>::type;
+		using Value_ref = typename eastl::conditional<IsConst, const value_type&, value_type&>::type;
+		using Value_ptr = typename eastl::conditional<IsConst, const value_type*, value_type*>::type;
+	public:
+		Iterator() = default;
+		Iterator(const Iterator<false>& other)
+		: _table(other._table)
+		, _index(other._index)
+		{
+		}
+
+		Value_ref operator*() const { return _table->_slots[_index]; }
+		Value_ptr operator->() const { return &_table->_slots[_index]; }
+
+		Iterator& operator++()
+		{
+			_index = _table->NextFull(_index + 1);
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator old(*this);
+			++(*this);
+			return old;
+		}
+
+		bool operator==(const Iterator& other) const { return _index == other._index; }
+		bool operator!=(const Iterator& other) const { return _index != other._index; }
+
+	private:
+		template<bool> friend class Iterator;
+
+		Iterator(Table_t* table, size_t index)
+		: _table(table)
+		, _index(index)
+		{
+		}
+
+		Table_t* _table{ nullptr };
+		size_t _index{ 0 };
+	};
+
+	using iterator = Iterator<false>;
+	using const_iterator = Iterator<true>;
+
+	Hash() = default;
+
+	explicit Hash(size_t initialCapacity)
+	{
+		reserve(initialCapacity);
+	}
+
+	Hash(const Hash& other)
+	{
+		reserve(other._size);
+		for(const value_type& entry : other)
+		{
+			emplace(entry.first, entry.second);
+		}
+	}
+
+	Hash(Hash&& other)
+	{
+		Swap(other);
+	}
+
+	~Hash()
+	{
+		Release();
+	}
+
+	Hash& operator=(const Hash& other)
+	{
+		if(this != &other)
+		{
+			Hash copy(other);
+			Swap(copy);
+		}
+		return *this;
+	}
+
+	Hash& operator=(Hash&& other)
+	{
+		if(this != &other)
+		{
+			Release();
+			Swap(other);
+		}
+		return *this;
+	}
+
+	iterator begin() { return iterator(this, NextFull(0)); }
+	iterator end() { return iterator(this, _capacity); }
+	const_iterator begin() const { return const_iterator(this, NextFull(0)); }
+	const_iterator end() const { return const_iterator(this, _capacity); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	/**
+		Retrieve the number of slots in the table.
+	 **/
+	size_t GetCapacity() const { return _capacity; }
+
+	/**
+		Retrieve how full the table is, between 0 and 7/8.
+	 **/
+	float GetLoadFactor() const { return _capacity ? static_cast<float>(_size) / _capacity : 0.0f; }
+
+	iterator find(const Key_t& key)
+	{
+		return iterator(this, Find(key));
+	}
+
+	const_iterator find(const Key_t& key) const
+	{
+		return const_iterator(this, Find(key));
+	}
+
+	size_t count(const Key_t& key) const
+	{
+		return Find(key) != _capacity ? 1 : 0;
+	}
+
+	bool contains(const Key_t& key) const
+	{
+		return Find(key) != _capacity;
+	}
+
+	Value_t& operator[](const Key_t& key)
+	{
+		return try_emplace(key).first->second;
+	}
+
+	Value_t& operator[](Key_t&& key)
+	{
+		return try_emplace(std::move(key)).first->second;
+	}
+
+	Value_t& at(const Key_t& key)
+	{
+		size_t index = Find(key);
+		FIRE_ASSERT_MSG(index != _capacity, "key is not in the Hash");
+		return _slots[index].second;
+	}
+
+	const Value_t& at(const Key_t& key) const
+	{
+		size_t index = Find(key);
+		FIRE_ASSERT_MSG(index != _capacity, "key is not in the Hash");
+		return _slots[index].second;
+	}
+
+	/**
+		Insert \c key with a value built from \c args, unless \c key is already in the table, in which case
+		nothing is built.
+
+		\return The entry for \c key and whether it was inserted.
+	 **/
+	template<class K, class... Args>
+	eastl::pair<iterator, bool> try_emplace(K&& key, Args&&... args)
+	{
+		const uint64_t hash = HashOf(key);
+		size_t index = Find(key, hash);
+		if(index != _capacity)
+		{
+			return { iterator(this, index), false };
+		}
+
+		if((_size + 1) * 8 > _capacity * 7)
+		{
+			Rehash(_capacity ? _capacity * 2 : MinCapacity);
+		}
+		index = FindEmpty(hash);
+		new(&_slots[index]) value_type(eastl::piecewise_construct,
+			eastl::forward_as_tuple(eastl::forward<K>(key)),
+			eastl::forward_as_tuple(eastl::forward<Args>(args)...));
+		SetCtrl(index, TagOf(hash));
+		++_size;
+		return { iterator(this, index), true };
+	}
+
+	template<class K, class V>
+	eastl::pair<iterator, bool> emplace(K&& key, V&& value)
+	{
+		return try_emplace(eastl::forward<K>(key), eastl::forward<V>(value));
+	}
+
+	eastl::pair<iterator, bool> insert(const value_type& entry)
+	{
+		return try_emplace(entry.first, entry.second);
+	}
+
+	/**
+		Remove \c key from the table.
+
+		\return The number of entries removed, which is 0 or 1.
+	 **/
+	size_t erase(const Key_t& key)
+	{
+		size_t index = Find(key);
+		if(index == _capacity)
+		{
+			return 0;
+		}
+		EraseAt(index);
+		return 1;
+	}
+
+	/**
+		Remove the entry at \c where.
+
+		\return An iterator to the entry that was shifted into its place, or the next entry if none was. An entry
+		from the start of the table can wrap around into the end of it, so an erase-while-iterating loop may see
+		a handful of entries twice.
+	 **/
+	iterator erase(const_iterator where)
+	{
+		size_t index = where._index;
+		EraseAt(index);
+		return iterator(this, NextFull(index));
+	}
+
+	/**
+		Remove every entry that \c predicate returns true for.
+
+		\return The number of entries removed.
+	 **/
+	template<class Predicate_t>
+	size_t EraseIf(Predicate_t predicate)
+	{
+		size_t removed = 0;
+		size_t index = 0;
+		while(index < _capacity)
+		{
+			// whatever gets shifted into the hole still has to be looked at, so don't move on after an erase.
+			if(_ctrl[index] != HashDetail::kEmpty && predicate(_slots[index]))
+			{
+				EraseAt(index);
+				++removed;
+			}
+			else
+			{
+				++index;
+			}
+		}
+		return removed;
+	}
+
+	void clear()
+	{
+		for(size_t i = 0; i < _capacity; ++i)
+		{
+			if(_ctrl[i] != HashDetail::kEmpty)
+			{
+				_slots[i].~value_type();
+			}
+		}
+		if(_ctrl)
+		{
+			memset(_ctrl, HashDetail::kEmpty, _capacity + Group::Width);
+		}
+		_size = 0;
+	}
+
+	/**
+		Make sure \c numEntries fit without the table having to grow.
+	 **/
+	void reserve(size_t numEntries)
+	{
+		size_t capacity = MinCapacity;
+		while(capacity * 7 < numEntries * 8)
+		{
+			capacity *= 2;
+		}
+		if(capacity > _capacity)
+		{
+			Rehash(capacity);
+		}
+	}
+
+	void Swap(Hash& other)
+	{
+		eastl::swap(_slots, other._slots);
+		eastl::swap(_ctrl, other._ctrl);
+		eastl::swap(_capacity, other._capacity);
+		eastl::swap(_size, other._size);
+		eastl::swap(_hasher, other._hasher);
+		eastl::swap(_equal, other._equal);
+	}
+
 private:
-	uint32_t _numBuckets;
-	uint64_t* _keys;
-	uint64_t* _values;
+	static const size_t MinCapacity = Group::Width;
+
+	uint64_t HashOf(const Key_t& key) const { return HashDetail::Mix(static_cast<uint64_t>(_hasher(key))); }
+	static int8_t TagOf(uint64_t hash) { return static_cast<int8_t>(hash >> 57); }
+	size_t HomeOf(uint64_t hash) const { return static_cast<size_t>(hash) & (_capacity - 1); }
+
+	size_t Find(const Key_t& key) const
+	{
+		return _size ? Find(key, HashOf(key)) : _capacity;
+	}
+
+	size_t Find(const Key_t& key, uint64_t hash) const
+	{
+		if(_capacity == 0)
+		{
+			return 0;
+		}
+
+		const size_t mask = _capacity - 1;
+		const int8_t tag = TagOf(hash);
+		size_t position = HomeOf(hash);
+		for(;;)
+		{
+			Group group(_ctrl + position);
+			for(uint64_t matches = group.Match(tag); matches; matches &= matches - 1)
+			{
+				size_t index = (position + (HashDetail::CountTrailingZeros(matches) >> Group::Shift)) & mask;
+				if(_equal(_slots[index].first, key))
+				{
+					return index;
+				}
+			}
+			// linear probing with no tombstones means the key would have been placed before the first hole.
+			if(group.MatchEmpty())
+			{
+				return _capacity;
+			}
+			position = (position + Group::Width) & mask;
+		}
+	}
+
+	size_t FindEmpty(uint64_t hash) const
+	{
+		const size_t mask = _capacity - 1;
+		size_t position = HomeOf(hash);
+		for(;;)
+		{
+			uint64_t empties = Group(_ctrl + position).MatchEmpty();
+			if(empties)
+			{
+				return (position + (HashDetail::CountTrailingZeros(empties) >> Group::Shift)) & mask;
+			}
+			position = (position + Group::Width) & mask;
+		}
+	}
+
+	size_t NextFull(size_t index) const
+	{
+		while(index < _capacity && _ctrl[index] == HashDetail::kEmpty)
+		{
+			++index;
+		}
+		return index < _capacity ? index : _capacity;
+	}
+
+	// the first Group::Width control bytes are mirrored past the end so that a group can be loaded from any slot
+	// without wrapping.
+	void SetCtrl(size_t index, int8_t value)
+	{
+		_ctrl[index] = value;
+		if(index < Group::Width)
+		{
+			_ctrl[_capacity + index] = value;
+		}
+	}
+
+	void EraseAt(size_t hole)
+	{
+		const size_t mask = _capacity - 1;
+		_slots[hole].~value_type();
+		SetCtrl(hole, HashDetail::kEmpty);
+		--_size;
+
+		// walk the rest of the cluster and pull back anything whose home slot isn't between the hole and where it
+		// currently sits.
+		size_t index = hole;
+		for(;;)
+		{
+			index = (index + 1) & mask;
+			if(_ctrl[index] == HashDetail::kEmpty)
+			{
+				return;
+			}
+			size_t home = HomeOf(HashOf(_slots[index].first));
+			bool stays = hole <= index ? (hole < home && home <= index) : (hole < home || home <= index);
+			if(!stays)
+			{
+				new(&_slots[hole]) value_type(std::move(_slots[index]));
+				_slots[index].~value_type();
+				SetCtrl(hole, _ctrl[index]);
+				SetCtrl(index, HashDetail::kEmpty);
+				hole = index;
+			}
+		}
+	}
+
+	void Rehash(size_t newCapacity)
+	{
+		value_type* oldSlots = _slots;
+		int8_t* oldCtrl = _ctrl;
+		size_t oldCapacity = _capacity;
+
+		Allocate(newCapacity);
+		for(size_t i = 0; i < oldCapacity; ++i)
+		{
+			if(oldCtrl[i] != HashDetail::kEmpty)
+			{
+				const uint64_t hash = HashOf(oldSlots[i].first);
+				size_t index = FindEmpty(hash);
+				new(&_slots[index]) value_type(std::move(oldSlots[i]));
+				oldSlots[i].~value_type();
+				SetCtrl(index, TagOf(hash));
+			}
+		}
+		libCore::Free(oldSlots);
+	}
+
+	void Allocate(size_t capacity)
+	{
+		FIRE_ASSERT_MSG((capacity & (capacity - 1)) == 0, "Hash capacity has to be a power of two");
+		// one allocation for both, the slots up front and the control bytes behind them.
+		const size_t slotBytes = capacity * sizeof(value_type);
+		const size_t alignment = alignof(value_type) > 16 ? alignof(value_type) : 16;
+		char* memory = static_cast<char*>(libCore::AlignedAlloc(slotBytes + capacity + Group::Width, alignment));
+		FIRE_ASSERT_MSG(memory != nullptr, "Hash failed to allocate its table");
+		_slots = reinterpret_cast<value_type*>(memory);
+		_ctrl = reinterpret_cast<int8_t*>(memory + slotBytes);
+		_capacity = capacity;
+		memset(_ctrl, HashDetail::kEmpty, capacity + Group::Width);
+	}
+
+	void Release()
+	{
+		clear();
+		libCore::Free(_slots);
+		_slots = nullptr;
+		_ctrl = nullptr;
+		_capacity = 0;
+	}
+
+	value_type* _slots{ nullptr };
+	int8_t* _ctrl{ nullptr };
+	size_t _capacity{ 0 };
+	size_t _size{ 0 };
+	Hasher_t _hasher;
+	Equal_t _equal;
 };
 
-#endif
\ No newline at end of file
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
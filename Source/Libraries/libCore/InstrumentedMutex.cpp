@@ -0,0 +1,273 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  InstrumentedMutex
+//
+//  A mutex that keeps track of how often it's fought over, and for how long.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "InstrumentedMutex.h"
+
+#ifdef FIRE_LOCK_TRACKING
+
+#include "Assert.h"
+#include "ThreadSlot.h"
+#include "Profiler.h"
+#include <EASTL/sort.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct alignas(64) LockShard
+{
+	atomic<uint64_t> NumAcquisitions;
+	atomic<uint64_t> NumContended;
+	atomic<uint64_t> TotalWait;
+	atomic<uint64_t> MaxWait;
+	atomic<uint64_t> TotalHold;
+	atomic<uint64_t> MaxHold;
+};
+
+// every mutex with the same name shares a site. the last shard is for threads that didn't get a ThreadSlot.
+struct LockSite
+{
+	const char*      Name;
+	char             WaitName[96];
+	atomic<uint64_t> NumInstances;
+	LockShard        Shards[ThreadSlot::MaxSlots + 1];
+};
+
+static LockSite       s_sites[InstrumentedMutex::MaxSites];
+static atomic<size_t> s_numSites{ 0 };
+static std::mutex     s_registryLock;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t GetTime()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void StoreMax(atomic<uint64_t>& max, uint64_t value)
+{
+	uint64_t current = max.load(std::memory_order_relaxed);
+	while(value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline LockShard& GetShard(LockSite* site)
+{
+	const size_t slot = ThreadSlot::Get();
+	return site->Shards[slot == ThreadSlot::Invalid ? ThreadSlot::MaxSlots : slot];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static LockSite* FindOrAddSite(const char* name)
+{
+	std::scoped_lock lock(s_registryLock);
+	const size_t numSites = s_numSites.load(std::memory_order_relaxed);
+	for(size_t i = 0; i < numSites; ++i)
+	{
+		if(strcmp(s_sites[i].Name, name) == 0)
+		{
+			return &s_sites[i];
+		}
+	}
+
+	// the last site is kept back for every name that comes after the rest are taken.
+	if(numSites == InstrumentedMutex::MaxSites)
+	{
+		return &s_sites[numSites - 1];
+	}
+	const bool full = numSites == InstrumentedMutex::MaxSites - 1;
+	LockSite& site = s_sites[numSites];
+	site.Name = full ? "(untracked)" : name;
+	snprintf(site.WaitName, sizeof(site.WaitName), "Wait: %s", site.Name);
+	s_numSites.store(numSites + 1, std::memory_order_release);
+	return &site;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static MutexStats GetSiteStats(const LockSite& site)
+{
+	MutexStats stats{ site.Name, site.NumInstances.load(std::memory_order_relaxed), 0, 0, 0, 0, 0, 0 };
+	for(const LockShard& shard : site.Shards)
+	{
+		stats.NumAcquisitions += shard.NumAcquisitions.load(std::memory_order_relaxed);
+		stats.NumContended += shard.NumContended.load(std::memory_order_relaxed);
+		stats.TotalWait += shard.TotalWait.load(std::memory_order_relaxed);
+		stats.MaxWait = eastl::max(stats.MaxWait, shard.MaxWait.load(std::memory_order_relaxed));
+		stats.TotalHold += shard.TotalHold.load(std::memory_order_relaxed);
+		stats.MaxHold = eastl::max(stats.MaxHold, shard.MaxHold.load(std::memory_order_relaxed));
+	}
+	return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+InstrumentedMutex::InstrumentedMutex(const char* name)
+{
+	FIRE_ASSERT_MSG(name != nullptr, "an InstrumentedMutex needs a name");
+	_site = FindOrAddSite(name);
+	_site->NumInstances.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+InstrumentedMutex::~InstrumentedMutex()
+{
+	_site->NumInstances.fetch_sub(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void InstrumentedMutex::lock()
+{
+	if(_mutex.try_lock())
+	{
+		_lockedAt = GetTime();
+		Acquired(0, false);
+		return;
+	}
+
+	const uint64_t start = GetTime();
+#ifdef FIRE_PROFILING
+	const bool profiled = Profiler::BeginScope(_site->WaitName);
+#endif
+	_mutex.lock();
+#ifdef FIRE_PROFILING
+	if(profiled)
+	{
+		Profiler::EndScope();
+	}
+#endif
+	_lockedAt = GetTime();
+	Acquired(_lockedAt - start, true);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool InstrumentedMutex::try_lock()
+{
+	if(!_mutex.try_lock())
+	{
+		return false;
+	}
+	_lockedAt = GetTime();
+	Acquired(0, false);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void InstrumentedMutex::unlock()
+{
+	// charged to whichever thread unlocks, which is the one that held it.
+	const uint64_t hold = GetTime() - _lockedAt;
+	_mutex.unlock();
+
+	LockShard& shard = GetShard(_site);
+	shard.TotalHold.fetch_add(hold, std::memory_order_relaxed);
+	StoreMax(shard.MaxHold, hold);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void InstrumentedMutex::Acquired(uint64_t wait, bool contended)
+{
+	LockShard& shard = GetShard(_site);
+	shard.NumAcquisitions.fetch_add(1, std::memory_order_relaxed);
+	if(contended)
+	{
+		shard.NumContended.fetch_add(1, std::memory_order_relaxed);
+		shard.TotalWait.fetch_add(wait, std::memory_order_relaxed);
+		StoreMax(shard.MaxWait, wait);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* InstrumentedMutex::GetName() const
+{
+	return _site->Name;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MutexStats InstrumentedMutex::GetStats() const
+{
+	return GetSiteStats(*_site);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vector<MutexStats> InstrumentedMutex::GetAllStats()
+{
+	vector<MutexStats> stats;
+	const size_t numSites = s_numSites.load(std::memory_order_acquire);
+	stats.reserve(numSites);
+	for(size_t i = 0; i < numSites; ++i)
+	{
+		stats.push_back(GetSiteStats(s_sites[i]));
+	}
+	eastl::sort(stats.begin(), stats.end(), [](const MutexStats& a, const MutexStats& b) {
+		return a.TotalWait > b.TotalWait;
+	});
+	return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+string InstrumentedMutex::ReportContention()
+{
+	string report;
+	report.append_sprintf("%-40s %10s %14s %12s %14s %12s %14s %12s\n", "Mutex", "Instances", "Acquisitions",
+		"Contended", "Wait (ms)", "Max Wait", "Hold (ms)", "Max Hold");
+	for(const MutexStats& stats : GetAllStats())
+	{
+		report.append_sprintf("%-40s %10llu %14llu %11.2f%% %14.3f %12.3f %14.3f %12.3f\n", stats.Name,
+			(unsigned long long)stats.NumInstances, (unsigned long long)stats.NumAcquisitions,
+			stats.NumAcquisitions > 0 ? 100.0 * stats.NumContended / stats.NumAcquisitions : 0.0,
+			stats.TotalWait / 1e6, stats.MaxWait / 1e6, stats.TotalHold / 1e6, stats.MaxHold / 1e6);
+	}
+	return report;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void InstrumentedMutex::ResetStats()
+{
+	const size_t numSites = s_numSites.load(std::memory_order_acquire);
+	for(size_t i = 0; i < numSites; ++i)
+	{
+		for(LockShard& shard : s_sites[i].Shards)
+		{
+			shard.NumAcquisitions.store(0, std::memory_order_relaxed);
+			shard.NumContended.store(0, std::memory_order_relaxed);
+			shard.TotalWait.store(0, std::memory_order_relaxed);
+			shard.MaxWait.store(0, std::memory_order_relaxed);
+			shard.TotalHold.store(0, std::memory_order_relaxed);
+			shard.MaxHold.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  InstrumentedMutex
+//
+//  A mutex that keeps track of how often it's fought over, and for how long.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_INSTRUMENTEDMUTEX_H_
+#define LIBCORE_INSTRUMENTEDMUTEX_H_
+#pragma once
+
+#include "libCore.h"
+
+#include <mutex>
+
+#ifndef FIRE_FINAL
+#define FIRE_LOCK_TRACKING
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+#ifdef FIRE_LOCK_TRACKING
+
+/**
+	The counters for every mutex that shares a name. Times are in nanoseconds.
+ **/
+struct MutexStats
+{
+	const char* Name;
+	uint64_t    NumInstances;      // how many mutexes with the name are alive right now.
+	uint64_t    NumAcquisitions;
+	uint64_t    NumContended;      // acquisitions that had to wait for another thread to let go.
+	uint64_t    TotalWait;
+	uint64_t    MaxWait;
+	uint64_t    TotalHold;
+	uint64_t    MaxHold;
+};
+
+struct LockSite;
+
+/**
+	\class InstrumentedMutex
+
+	A drop in std::mutex that records every acquisition. Mutexes are grouped by name, so every ObjectPool's slab
+	lock (for example) adds up to a single line in the report, which is what tells you which lock is holding back
+	scaling under load.
+
+	- The counters for a name are sharded by ThreadSlot, so recording never bounces a cache line between threads.
+	- An uncontended lock costs a try_lock and a clock read. Only contended locks time the wait.
+	- Waits show up on the Profiler's timeline as a scope named after the lock.
+
+	\warning Names aren't copied. Use string literals.
+	\note Only exists when FIRE_LOCK_TRACKING is defined, which is every configuration but FIRE_FINAL. Declare
+	mutexes with FIRE_MUTEX and they turn back into a plain mutex with it.
+	\note Once MaxSites names are in use, any new names share a single "(untracked)" entry.
+ **/
+class InstrumentedMutex final
+{
+public:
+	static const size_t MaxSites = 128;
+
+	explicit InstrumentedMutex(const char* name);
+	~InstrumentedMutex();
+
+	void lock();
+	bool try_lock();
+	void unlock();
+
+	const char* GetName() const;
+
+	/**
+		Retrieve the counters for every mutex with this one's name.
+	 **/
+	MutexStats GetStats() const;
+
+	/**
+		Retrieve the counters for every name, the most waited on first.
+	 **/
+	static vector<MutexStats> GetAllStats();
+
+	/**
+		Format GetAllStats as a table, one line per name.
+	 **/
+	static string ReportContention();
+
+	/**
+		Zero every counter, so that the next report only covers what happens from here on.
+	 **/
+	static void ResetStats();
+
+private:
+	InstrumentedMutex(const InstrumentedMutex&) = delete;
+	InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+
+	void Acquired(uint64_t wait, bool contended);
+
+	std::mutex _mutex;
+	LockSite*  _site;
+	uint64_t   _lockedAt{ 0 };
+};
+
+#define FIRE_MUTEX(VAR, NAME) ::Firestorm::InstrumentedMutex VAR{ NAME }
+
+#else
+
+#define FIRE_MUTEX(VAR, NAME) ::Firestorm::mutex VAR
+
+#endif
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
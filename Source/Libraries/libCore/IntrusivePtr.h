@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  IntrusivePtr
+//
+//  Reference counted smart pointer that keeps the count inside of the object it points to.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_INTRUSIVEPTR_H_
+#define LIBCORE_INTRUSIVEPTR_H_
+#pragma once
+
+#include "libCore.h"
+#include "Assert.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+namespace RefCountDetail
+{
+	struct AtomicCount
+	{
+		void Increment() { _value.fetch_add(1, std::memory_order_relaxed); }
+
+		// returns true when the last reference went away.
+		bool Decrement()
+		{
+			// acq_rel so that everything done through other references happens before the object is destroyed.
+			return _value.fetch_sub(1, std::memory_order_acq_rel) == 1;
+		}
+
+		uint32_t Get() const { return _value.load(std::memory_order_relaxed); }
+
+	private:
+		atomic<uint32_t> _value{ 0 };
+	};
+
+	struct LocalCount
+	{
+		void Increment()
+		{
+			CheckThread();
+			++_value;
+		}
+
+		bool Decrement()
+		{
+			CheckThread();
+			return --_value == 0;
+		}
+
+		uint32_t Get() const { return _value; }
+
+	private:
+#ifdef FIRE_DEBUG
+		void CheckThread()
+		{
+			if(_value == 0)
+			{
+				_owner = std::this_thread::get_id();
+			}
+			FIRE_ASSERT_MSG(_owner == std::this_thread::get_id(),
+				"a LocalRefCounted object was referenced from more than one thread, derive from RefCounted instead");
+		}
+
+		std::thread::id _owner;
+#else
+		void CheckThread() {}
+#endif
+		uint32_t _value{ 0 };
+	};
+}
+
+/**
+	\class BasicRefCounted
+
+	Base class for objects that are held by IntrusivePtr. The count lives in the object itself, so handing out a
+	reference never allocates a control block and never takes a second cache miss to get to the count.
+
+	Use RefCounted for objects that are shared between threads, and LocalRefCounted for objects that are only
+	ever referenced from a single thread, which skips the atomic read-modify-writes altogether. In debug builds
+	LocalRefCounted asserts if it's referenced from the wrong thread.
+
+	Objects start out with no references. The first IntrusivePtr to one takes ownership of it, and the object is
+	handed to Destroy once the last one lets go.
+ **/
+template<class Count_t>
+class BasicRefCounted
+{
+public:
+	void AddRef() const { _refCount.Increment(); }
+
+	void Release() const
+	{
+		if(_refCount.Decrement())
+		{
+			Destroy();
+		}
+	}
+
+	uint32_t GetRefCount() const { return _refCount.Get(); }
+
+protected:
+	BasicRefCounted() = default;
+
+	// a copy is a new object, nothing refers to it yet.
+	BasicRefCounted(const BasicRefCounted&) {}
+	BasicRefCounted& operator=(const BasicRefCounted&) { return *this; }
+
+	virtual ~BasicRefCounted() = default;
+
+	/**
+		Called when the last reference goes away. Deletes the object by default. Override it for objects that
+		came out of somewhere other than new, like an ObjectPool.
+	 **/
+	virtual void Destroy() const
+	{
+		delete this;
+	}
+
+private:
+	mutable Count_t _refCount;
+};
+
+using RefCounted = BasicRefCounted<RefCountDetail::AtomicCount>;
+using LocalRefCounted = BasicRefCounted<RefCountDetail::LocalCount>;
+
+/**
+	\class IntrusivePtr
+
+	A strong reference to a RefCounted (or LocalRefCounted) object. Works like RefPtr, minus the control block:
+	it's a single pointer wide, and can be made straight from a raw pointer to the object at any time without
+	splitting the count.
+ **/
+template<class T>
+class IntrusivePtr final
+{
+	template<class U>
+	using EnableIfConvertible = eastl::enable_if_t<eastl::is_convertible<U*, T*>::value>;
+public:
+	using element_type = T;
+
+	IntrusivePtr() = default;
+	IntrusivePtr(std::nullptr_t) {}
+
+	IntrusivePtr(T* ptr)
+	: _ptr(ptr)
+	{
+		if(_ptr)
+		{
+			_ptr->AddRef();
+		}
+	}
+
+	IntrusivePtr(const IntrusivePtr& other)
+	: IntrusivePtr(other._ptr)
+	{
+	}
+
+	IntrusivePtr(IntrusivePtr&& other) noexcept
+	: _ptr(other._ptr)
+	{
+		other._ptr = nullptr;
+	}
+
+	template<class U, class = EnableIfConvertible<U>>
+	IntrusivePtr(const IntrusivePtr<U>& other)
+	: IntrusivePtr(other.get())
+	{
+	}
+
+	template<class U, class = EnableIfConvertible<U>>
+	IntrusivePtr(IntrusivePtr<U>&& other) noexcept
+	: _ptr(other.detach())
+	{
+	}
+
+	~IntrusivePtr()
+	{
+		if(_ptr)
+		{
+			_ptr->Release();
+		}
+	}
+
+	IntrusivePtr& operator=(const IntrusivePtr& other)
+	{
+		IntrusivePtr(other).swap(*this);
+		return *this;
+	}
+
+	IntrusivePtr& operator=(IntrusivePtr&& other) noexcept
+	{
+		IntrusivePtr(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	IntrusivePtr& operator=(T* ptr)
+	{
+		IntrusivePtr(ptr).swap(*this);
+		return *this;
+	}
+
+	IntrusivePtr& operator=(std::nullptr_t)
+	{
+		reset();
+		return *this;
+	}
+
+	void reset()
+	{
+		IntrusivePtr().swap(*this);
+	}
+
+	void swap(IntrusivePtr& other) noexcept
+	{
+		T* ptr = _ptr;
+		_ptr = other._ptr;
+		other._ptr = ptr;
+	}
+
+	/**
+		Give up the reference without releasing it. The caller is responsible for calling Release on the result.
+	 **/
+	T* detach()
+	{
+		T* ptr = _ptr;
+		_ptr = nullptr;
+		return ptr;
+	}
+
+	T* get() const { return _ptr; }
+	T& operator*() const { return *_ptr; }
+	T* operator->() const { return _ptr; }
+	explicit operator bool() const { return _ptr != nullptr; }
+
+	uint32_t use_count() const { return _ptr ? _ptr->GetRefCount() : 0; }
+
+private:
+	T* _ptr{ nullptr };
+};
+
+template<class T, class U>
+inline bool operator==(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) { return a.get() == b.get(); }
+
+template<class T, class U>
+inline bool operator!=(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) { return a.get() != b.get(); }
+
+template<class T>
+inline bool operator==(const IntrusivePtr<T>& a, std::nullptr_t) { return a.get() == nullptr; }
+
+template<class T>
+inline bool operator!=(const IntrusivePtr<T>& a, std::nullptr_t) { return a.get() != nullptr; }
+
+template<class T>
+inline bool operator==(std::nullptr_t, const IntrusivePtr<T>& b) { return b.get() == nullptr; }
+
+template<class T>
+inline bool operator!=(std::nullptr_t, const IntrusivePtr<T>& b) { return b.get() != nullptr; }
+
+/**
+	Make a new T and hand back the first reference to it.
+ **/
+template<class T, class... Args_t>
+inline IntrusivePtr<T> MakeIntrusive(Args_t&&... args)
+{
+	return IntrusivePtr<T>(new T(std::forward<Args_t>(args)...));
+}
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -0,0 +1,438 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  JobSystem
+//
+//  A work stealing job scheduler that spreads work across all of the cores on the machine.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "JobSystem.h"
+#include "Logger.h"
+#include "Profiler.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// the JobSystem the calling thread works for, and which worker it is.
+static thread_local const JobSystem* tl_jobSystem = nullptr;
+static thread_local size_t tl_workerIndex = 0;
+
+static const size_t s_invalidWorker = eastl::numeric_limits<size_t>::max();
+
+static const size_t s_injectionCapacity = 16384;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct JobSystem::JobData
+{
+	Job         Fn;
+	JobCounter* Counter;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+	Fixed capacity Chase-Lev work stealing deque (Le, Pop, Cohen, Zappa Nardelli - "Correct and Efficient
+	Work-Stealing for Weak Memory Models"). Only the owning worker may Push and Pop. Anybody may Steal.
+ **/
+class WorkStealingDeque final
+{
+public:
+	static constexpr int64_t Capacity = 4096;
+	static constexpr int64_t Mask = Capacity - 1;
+
+	WorkStealingDeque()
+	{
+		for(int64_t i = 0; i < Capacity; ++i)
+		{
+			_buffer[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	// returns false if the deque is full.
+	bool Push(void* item)
+	{
+		int64_t b = _bottom.load(std::memory_order_relaxed);
+		int64_t t = _top.load(std::memory_order_acquire);
+		if(b - t >= Capacity)
+		{
+			return false;
+		}
+		_buffer[b & Mask].store(item, std::memory_order_relaxed);
+		_bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	void* Pop()
+	{
+		int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+		_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = _top.load(std::memory_order_relaxed);
+
+		void* item = nullptr;
+		if(t <= b)
+		{
+			item = _buffer[b & Mask].load(std::memory_order_relaxed);
+			if(t == b)
+			{
+				// last item in the deque. race the thieves for it.
+				if(!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					item = nullptr;
+				}
+				_bottom.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	void* Steal()
+	{
+		int64_t t = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = _bottom.load(std::memory_order_acquire);
+		if(t < b)
+		{
+			void* item = _buffer[t & Mask].load(std::memory_order_relaxed);
+			if(!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+			return item;
+		}
+		return nullptr;
+	}
+
+private:
+	// top and bottom live on separate cache lines since thieves hammer one and the owner hammers the other.
+	alignas(64) atomic<int64_t> _top{ 0 };
+	alignas(64) atomic<int64_t> _bottom{ 0 };
+	alignas(64) atomic<void*>   _buffer[Capacity];
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct JobSystem::Worker
+{
+	WorkStealingDeque Deque;
+	thread            Thread;
+	size_t            NextVictim{ 0 };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+JobSystem::JobSystem(size_t numThreads)
+: _injected(s_injectionCapacity)
+{
+	if(numThreads == 0)
+	{
+		numThreads = std::thread::hardware_concurrency();
+	}
+	// always keep at least one background worker around, otherwise nothing runs until somebody calls Wait.
+	numThreads = eastl::max<size_t>(numThreads, 2);
+
+	_workers.reserve(numThreads);
+	for(size_t i = 0; i < numThreads; ++i)
+	{
+		Worker* worker = new Worker;
+		worker->NextVictim = i + 1;
+		_workers.push_back(worker);
+	}
+
+	// the constructing thread is worker 0. it doesn't get a thread object, it helps out in Wait.
+	_previousJobSystem = tl_jobSystem;
+	_previousWorkerIndex = tl_workerIndex;
+	tl_jobSystem = this;
+	tl_workerIndex = 0;
+
+	for(size_t i = 1; i < numThreads; ++i)
+	{
+		// kept short, linux cuts thread names off at 15 characters.
+		string name;
+		name.append_sprintf("Job[%zu]", i);
+		_workers[i]->Thread = thread(std::bind(&JobSystem::WorkerRun, this, i));
+		libCore::SetThreadName(_workers[i]->Thread, name);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+	for(Worker* worker : _workers)
+	{
+		delete worker;
+	}
+	_workers.clear();
+
+	if(tl_jobSystem == this)
+	{
+		tl_jobSystem = _previousJobSystem;
+		tl_workerIndex = _previousWorkerIndex;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::Submit(Job job, JobCounter* counter)
+{
+	if(counter)
+	{
+		counter->_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	Enqueue(new JobData{ std::move(job), counter });
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	size_t index = GetWorkerIndex();
+	while(!counter.IsDone())
+	{
+		JobData* job = FindJob(index);
+		if(job)
+		{
+			Execute(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::ParallelFor(size_t count, size_t grainSize, const RangeJob& job)
+{
+	if(count == 0)
+	{
+		return;
+	}
+	if(grainSize == 0)
+	{
+		// a few chunks per thread so that the stealing has something to balance with.
+		grainSize = eastl::max<size_t>(count / (GetNumThreads() * 4), 1);
+	}
+	if(grainSize >= count)
+	{
+		job(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	const RangeJob* jobPtr = &job;
+
+	// keep the first chunk for ourselves.
+	for(size_t begin = grainSize; begin < count; begin += grainSize)
+	{
+		size_t end = eastl::min(begin + grainSize, count);
+		Submit([jobPtr, begin, end]() { (*jobPtr)(begin, end); }, &counter);
+	}
+	try
+	{
+		job(0, grainSize);
+	}
+	catch(...)
+	{
+		// the other chunks still point at the job and the counter, so they have to be done before this returns.
+		Wait(counter);
+		throw;
+	}
+
+	Wait(counter);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t JobSystem::GetNumThreads() const
+{
+	return _workers.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool JobSystem::IsWorkerThread() const
+{
+	return tl_jobSystem == this;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::Shutdown()
+{
+	{
+		std::unique_lock<mutex> lock(_sleepLock);
+		_quit = true;
+	}
+	_sleepCv.notify_all();
+
+	for(size_t i = 1; i < _workers.size(); ++i)
+	{
+		if(_workers[i]->Thread.joinable())
+		{
+			_workers[i]->Thread.join();
+		}
+	}
+
+	// the workers are gone. whatever is left over gets run here so no one waits forever on a counter.
+	for(size_t i = 0; i < _workers.size(); ++i)
+	{
+		while(JobData* job = static_cast<JobData*>(_workers[i]->Deque.Steal()))
+		{
+			Execute(job);
+		}
+	}
+	while(JobData* job = PopInjected())
+	{
+		Execute(job);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::WorkerRun(size_t workerIndex)
+{
+	tl_jobSystem = this;
+	tl_workerIndex = workerIndex;
+
+#ifdef FIRE_PROFILING
+	string name;
+	name.append_sprintf("Job[%zu]", workerIndex);
+	FIRE_PROFILE_THREAD(name.c_str());
+#endif
+
+	while(!_quit.load(std::memory_order_relaxed))
+	{
+		JobData* job = FindJob(workerIndex);
+		if(job)
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<mutex> lock(_sleepLock);
+		_numSleeping.fetch_add(1);
+		_sleepCv.wait(lock, [this] {
+			return _quit.load() || _numPending.load() > 0;
+		});
+		_numSleeping.fetch_sub(1);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::Enqueue(JobData* job)
+{
+	size_t index = GetWorkerIndex();
+	if(index == s_invalidWorker || !_workers[index]->Deque.Push(job))
+	{
+		// if the injection queue is full too, back off until the workers make some room.
+		while(!_injected.TryPush(job))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	_numPending.fetch_add(1);
+	if(_numSleeping.load() > 0)
+	{
+		// taking the lock here closes the window between a worker checking _numPending and going to sleep.
+		{
+			std::unique_lock<mutex> lock(_sleepLock);
+		}
+		_sleepCv.notify_one();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+JobSystem::JobData* JobSystem::FindJob(size_t workerIndex)
+{
+	JobData* job = nullptr;
+	if(workerIndex != s_invalidWorker)
+	{
+		job = static_cast<JobData*>(_workers[workerIndex]->Deque.Pop());
+	}
+	if(!job)
+	{
+		job = PopInjected();
+	}
+	if(!job)
+	{
+		size_t numWorkers = _workers.size();
+		size_t start = workerIndex != s_invalidWorker ? _workers[workerIndex]->NextVictim : 0;
+		for(size_t i = 0; i < numWorkers && !job; ++i)
+		{
+			size_t victim = (start + i) % numWorkers;
+			if(victim == workerIndex)
+			{
+				continue;
+			}
+			job = static_cast<JobData*>(_workers[victim]->Deque.Steal());
+			if(job && workerIndex != s_invalidWorker)
+			{
+				// come back to the same victim next time, it probably has more.
+				_workers[workerIndex]->NextVictim = victim;
+			}
+		}
+	}
+	if(job)
+	{
+		_numPending.fetch_sub(1);
+	}
+	return job;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+JobSystem::JobData* JobSystem::PopInjected()
+{
+	JobData* job = nullptr;
+	if(_injected.TryPop(job))
+	{
+		return job;
+	}
+	return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void JobSystem::Execute(JobData* job)
+{
+	try
+	{
+		job->Fn();
+	}
+	catch(std::exception& e)
+	{
+		FIRE_LOG_ERROR("Exception in JobSystem job: %s", e.what());
+	}
+
+	if(job->Counter)
+	{
+		job->Counter->_count.fetch_sub(1, std::memory_order_release);
+	}
+	delete job;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t JobSystem::GetWorkerIndex() const
+{
+	return tl_jobSystem == this ? tl_workerIndex : s_invalidWorker;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  JobSystem
+//
+//  A work stealing job scheduler that spreads work across all of the cores on the machine.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_JOBSYSTEM_H_
+#define LIBCORE_JOBSYSTEM_H_
+#pragma once
+
+#include "libCore.h"
+#include "MPMCQueue.h"
+#include <condition_variable>
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class JobCounter
+
+	Tracks the number of outstanding jobs that were submitted against it. Pass one of these into
+	#JobSystem::Submit and then hand it to #JobSystem::Wait to fence on the completion of every job
+	that was submitted with it.
+
+	\warning A JobCounter must outlive every job that was submitted against it.
+ **/
+class JobCounter final
+{
+public:
+	JobCounter() = default;
+
+	/**
+		Retrieve whether or not every job submitted against this counter has finished.
+	 **/
+	bool IsDone() const { return _count.load(std::memory_order_acquire) == 0; }
+
+	/**
+		Retrieve the number of jobs that have not yet finished.
+	 **/
+	uint32_t GetNumPending() const { return _count.load(std::memory_order_acquire); }
+
+private:
+	friend class JobSystem;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	atomic<uint32_t> _count{ 0 };
+};
+
+/**
+	\class JobSystem
+
+	The shared scheduler for the engine. One worker thread is spawned per hardware thread (minus the thread
+	that constructed the JobSystem, which counts as worker 0 and helps out whenever it calls #JobSystem::Wait).
+
+	Each worker owns a Chase-Lev deque. Jobs submitted from a worker thread go onto the bottom of its own deque
+	and idle workers steal from the top of everybody else's. Jobs submitted from threads that the JobSystem
+	doesn't own go through a shared lock free injection queue.
+ **/
+class JobSystem final
+{
+public:
+	using Job = function<void(void)>;
+	using RangeJob = function<void(size_t /*begin*/, size_t /*end*/)>;
+
+	/**
+		Spin up the workers. Passing 0 sizes the JobSystem to \c std::thread::hardware_concurrency. There is
+		always at least one background worker.
+	 **/
+	explicit JobSystem(size_t numThreads = 0);
+	~JobSystem();
+
+	/**
+		Submit a job to be run on any of the workers. If \c counter is provided it will be incremented
+		now and decremented once the job has finished running.
+	 **/
+	void Submit(Job job, JobCounter* counter = nullptr);
+
+	/**
+		Block until every job submitted against \c counter has finished. The calling thread runs jobs
+		while it waits rather than sitting idle.
+	 **/
+	void Wait(JobCounter& counter);
+
+	/**
+		Split the range [0, count) into chunks of \c grainSize and run \c job over each of them in parallel.
+		Passing a grainSize of 0 picks one that gives every worker a few chunks to balance over.
+		Returns once every chunk has been processed.
+	 **/
+	void ParallelFor(size_t count, size_t grainSize, const RangeJob& job);
+
+	/**
+		Retrieve the number of threads that run jobs, including the thread that owns the JobSystem.
+	 **/
+	size_t GetNumThreads() const;
+
+	/**
+		Retrieve whether or not the calling thread is one of the threads that belongs to this JobSystem.
+	 **/
+	bool IsWorkerThread() const;
+
+	/**
+		Signal to the workers that it's time to shut down. Any jobs that are still queued are run on the
+		calling thread so that nothing waiting on a JobCounter is left hanging.
+	 **/
+	void Shutdown();
+
+private:
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	struct JobData;
+	struct Worker;
+
+	void WorkerRun(size_t workerIndex);
+
+	void Enqueue(JobData* job);
+	JobData* FindJob(size_t workerIndex);
+	JobData* PopInjected();
+	void Execute(JobData* job);
+
+	size_t GetWorkerIndex() const;
+
+	vector<Worker*> _workers;
+
+	// what the constructing thread worked for before, put back when this is destroyed.
+	const JobSystem* _previousJobSystem{ nullptr };
+	size_t           _previousWorkerIndex{ 0 };
+
+	MPMCQueue<JobData*> _injected;
+
+	mutex                   _sleepLock;
+	std::condition_variable _sleepCv;
+	atomic<size_t>          _numPending{ 0 };
+	atomic<size_t>          _numSleeping{ 0 };
+	atomic<bool>            _quit{ false };
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
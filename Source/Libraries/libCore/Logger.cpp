@@ -9,6 +9,9 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #include "stdafx.h"
 #include "Logger.h"
+#include "MemoryTracker.h"
+
+#include <condition_variable>
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -16,11 +19,414 @@ Logger Logger::DEBUG_LOGGER(std::cout);
 Logger Logger::WARN_LOGGER(std::cout);
 Logger Logger::ERROR_LOGGER(std::cerr);
 
-std::mutex Logger::_s_allLock;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+	A single producer, single consumer ring of log records. The owning thread appends records and moves Head,
+	the drain thread moves Tail once the records have been written out. Records never straddle the end of the
+	ring, a kWrap record fills up the rest of it instead.
+ **/
+struct LogRing
+{
+	static const size_t Capacity = 64 * 1024;
+	static const uint64_t Mask = Capacity - 1;
+
+	enum State : uint32_t
+	{
+		kInUse,
+		kRetired, // the owning thread has exited, the ring is freed up once it's drained.
+		kFree
+	};
+
+	alignas(64) atomic<uint64_t> Head{ 0 };
+	alignas(64) atomic<uint64_t> Tail{ 0 };
+	atomic<uint64_t> Dropped{ 0 };
+	atomic<uint32_t> RingState{ kInUse };
+	uint64_t ReportedDropped{ 0 }; // only touched by the drain thread.
+	LogRing* Next{ nullptr };
+	alignas(8) char Data[Capacity];
+};
+
+struct ThreadRing
+{
+	~ThreadRing()
+	{
+		if(Ring)
+		{
+			Ring->RingState.store(LogRing::kRetired, std::memory_order_release);
+			Ring = nullptr;
+		}
+		// anything logged after this during thread teardown is written straight to the stream.
+		Released = true;
+	}
+
+	LogRing* Ring;
+	bool     Released;
+};
+
+static const size_t s_recordAlignment = 8;
+static const auto   s_idleWait = std::chrono::milliseconds(5);
+
+static atomic<bool>              s_logShutDown{ false };
+static atomic<LogOverflowPolicy> s_overflowPolicy{ LogOverflowPolicy::Block };
+
+static thread_local ThreadRing tl_ring;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t AlignRecord(size_t size)
+{
+	return (size + s_recordAlignment - 1) & ~(s_recordAlignment - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class LogBackend final
+{
+public:
+	static LogBackend& Get()
+	{
+		static LogBackend s_backend;
+		return s_backend;
+	}
+
+	static LogBackend* TryGet()
+	{
+		return s_instance.load(std::memory_order_acquire);
+	}
+
+	LogBackend()
+	: _thread([this] { Run(); })
+	{
+		s_instance.store(this, std::memory_order_release);
+	}
+
+	~LogBackend()
+	{
+		s_logShutDown.store(true, std::memory_order_release);
+		_stop.store(true, std::memory_order_release);
+		Wake();
+		_thread.join();
+	}
+
+	/**
+		Hand the calling thread a ring, reusing one that an exited thread left behind if there is one.
+	 **/
+	LogRing* Attach()
+	{
+		for(LogRing* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->Next)
+		{
+			uint32_t expected = LogRing::kFree;
+			if(ring->RingState.compare_exchange_strong(expected, LogRing::kInUse, std::memory_order_acq_rel))
+			{
+				return ring;
+			}
+		}
+
+		// rings live for as long as the process does and get handed from thread to thread.
+		LogRing* ring = new(UntrackedAllocator::Allocate(sizeof(LogRing), alignof(LogRing))) LogRing;
+		LogRing* head = _rings.load(std::memory_order_relaxed);
+		do
+		{
+			ring->Next = head;
+		} while(!_rings.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+		return ring;
+	}
+
+	void Wake()
+	{
+		_wakeRequested.store(true, std::memory_order_release);
+		_wakeSignal.notify_one();
+	}
+
+	void Flush()
+	{
+		for(LogRing* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->Next)
+		{
+			const uint64_t head = ring->Head.load(std::memory_order_acquire);
+			while(ring->Tail.load(std::memory_order_acquire) < head && !_stop.load(std::memory_order_acquire))
+			{
+				Wake();
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	uint64_t GetNumDropped() const
+	{
+		uint64_t numDropped = 0;
+		for(LogRing* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->Next)
+		{
+			numDropped += ring->Dropped.load(std::memory_order_relaxed);
+		}
+		return numDropped;
+	}
+
+private:
+	// batched per stream rather than per logger, since several loggers can share a stream and their messages
+	// have to come out in the order they were logged in.
+	struct Batch
+	{
+		std::ostream* Stream;
+		string        Text;
+	};
+
+	struct Drained
+	{
+		LogRing* Ring;
+		uint32_t State;
+		uint64_t Tail;
+	};
+
+	void Run()
+	{
+		for(;;)
+		{
+			if(DrainOnce() > 0)
+			{
+				continue;
+			}
+			if(_stop.load(std::memory_order_acquire))
+			{
+				// one last pass for anything that was logged while the flag went up.
+				if(DrainOnce() == 0)
+				{
+					return;
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(_wakeLock);
+			_wakeSignal.wait_for(lock, s_idleWait, [this] {
+				return _wakeRequested.load(std::memory_order_acquire) || _stop.load(std::memory_order_acquire);
+			});
+			_wakeRequested.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	string& GetBatch(const Logger* target)
+	{
+		for(Batch& batch : _batches)
+		{
+			if(batch.Stream == &target->_ostream)
+			{
+				return batch.Text;
+			}
+		}
+		_batches.push_back(Batch{ &target->_ostream, string() });
+		return _batches.back().Text;
+	}
+
+	/**
+		Format everything that's in the rings, write it out a stream at a time, and only then hand the space back
+		to the threads that logged it. Returns the number of messages that were written.
+	 **/
+	size_t DrainOnce()
+	{
+		size_t numRecords = 0;
+		_drained.clear();
+		for(LogRing* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->Next)
+		{
+			// read the state first, once a ring is retired its head doesn't move anymore.
+			const uint32_t state = ring->RingState.load(std::memory_order_acquire);
+			const uint64_t head = ring->Head.load(std::memory_order_acquire);
+			uint64_t tail = ring->Tail.load(std::memory_order_relaxed);
+
+			const uint64_t dropped = ring->Dropped.load(std::memory_order_relaxed);
+			if(dropped != ring->ReportedDropped)
+			{
+				GetBatch(&Logger::WARN_LOGGER).append_sprintf("!! the log dropped %llu messages because a ring was full !!\n",
+					static_cast<unsigned long long>(dropped - ring->ReportedDropped));
+				ring->ReportedDropped = dropped;
+			}
+
+			while(tail != head)
+			{
+				const char* record = ring->Data + (tail & LogRing::Mask);
+				uint32_t size;
+				uint32_t kind;
+				memcpy(&size, record, sizeof(size));
+				memcpy(&kind, record + sizeof(size), sizeof(kind));
+				if(kind != LogDetail::kWrap)
+				{
+					LogDetail::RecordHeader header;
+					memcpy(&header, record, sizeof(header));
+					string& text = GetBatch(header.Target);
+					if(kind == LogDetail::kDeferred)
+					{
+						header.Decode(header.Format, record + sizeof(header), text);
+					}
+					else
+					{
+						text.append(record + sizeof(header));
+					}
+					text.push_back('\n');
+					++numRecords;
+				}
+				tail += size;
+			}
+			_drained.push_back(Drained{ ring, state, tail });
+		}
+
+		for(Batch& batch : _batches)
+		{
+			if(!batch.Text.empty())
+			{
+				batch.Stream->write(batch.Text.data(), batch.Text.size());
+				batch.Stream->flush();
+				batch.Text.clear();
+			}
+		}
+
+		for(const Drained& drained : _drained)
+		{
+			drained.Ring->Tail.store(drained.Tail, std::memory_order_release);
+			if(drained.State == LogRing::kRetired)
+			{
+				drained.Ring->RingState.store(LogRing::kFree, std::memory_order_release);
+			}
+		}
+		return numRecords;
+	}
+
+	static atomic<LogBackend*> s_instance;
+
+	atomic<LogRing*>        _rings{ nullptr };
+	atomic<bool>            _stop{ false };
+	atomic<bool>            _wakeRequested{ false };
+	std::mutex              _wakeLock;
+	std::condition_variable _wakeSignal;
+	vector<Batch>           _batches;
+	vector<Drained>         _drained;
+	std::thread             _thread;
+};
 
-Logger::Logger(std::ostream& ostream)
-: _ostream(ostream)
+atomic<LogBackend*> LogBackend::s_instance{ nullptr };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Logger::Flush()
+{
+	LogBackend* backend = LogBackend::TryGet();
+	if(backend && !s_logShutDown.load(std::memory_order_acquire))
+	{
+		backend->Flush();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Logger::SetOverflowPolicy(LogOverflowPolicy policy)
+{
+	s_overflowPolicy.store(policy, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LogOverflowPolicy Logger::GetOverflowPolicy()
+{
+	return s_overflowPolicy.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t Logger::GetNumDropped()
+{
+	LogBackend* backend = LogBackend::TryGet();
+	return backend ? backend->GetNumDropped() : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Logger::IsAsync()
+{
+	if(tl_ring.Ring)
+	{
+		return !s_logShutDown.load(std::memory_order_relaxed);
+	}
+	if(tl_ring.Released || s_logShutDown.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	tl_ring.Ring = LogBackend::Get().Attach();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+char* Logger::Reserve(size_t size)
+{
+	LogRing* ring = tl_ring.Ring;
+	size = AlignRecord(size);
+
+	uint64_t head = ring->Head.load(std::memory_order_relaxed);
+	const size_t contiguous = LogRing::Capacity - static_cast<size_t>(head & LogRing::Mask);
+	const size_t needed = size > contiguous ? size + contiguous : size;
+	while(LogRing::Capacity - (head - ring->Tail.load(std::memory_order_acquire)) < needed)
+	{
+		if(s_overflowPolicy.load(std::memory_order_relaxed) == LogOverflowPolicy::Drop ||
+		   s_logShutDown.load(std::memory_order_acquire))
+		{
+			ring->Dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		LogBackend::Get().Wake();
+		std::this_thread::yield();
+	}
+
+	if(size > contiguous)
+	{
+		const uint32_t wrap[2] = { static_cast<uint32_t>(contiguous), LogDetail::kWrap };
+		memcpy(ring->Data + (head & LogRing::Mask), wrap, sizeof(wrap));
+		head += contiguous;
+		ring->Head.store(head, std::memory_order_release);
+	}
+	return ring->Data + (head & LogRing::Mask);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Logger::Commit(size_t size)
 {
+	LogRing* ring = tl_ring.Ring;
+	const uint32_t alignedSize = static_cast<uint32_t>(AlignRecord(size));
+	const uint64_t head = ring->Head.load(std::memory_order_relaxed);
+	memcpy(ring->Data + (head & LogRing::Mask), &alignedSize, sizeof(alignedSize));
+	ring->Head.store(head + alignedSize, std::memory_order_release);
 }
 
-CLOSE_NAMESPACE(Firestorm);
\ No newline at end of file
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Logger::Submit(const char* text, size_t length) const
+{
+	if(!IsAsync())
+	{
+		WriteNow(text, length);
+		return;
+	}
+
+	length = eastl::min(length, MaxRecordSize - sizeof(RecordHeader) - 1);
+	const size_t size = sizeof(RecordHeader) + length + 1;
+	char* record = Reserve(size);
+	if(record)
+	{
+		RecordHeader header{ 0, LogDetail::kFormatted, this, nullptr, nullptr };
+		memcpy(record, &header, sizeof(header));
+		memcpy(record + sizeof(header), text, length);
+		record[sizeof(header) + length] = '\0';
+		Commit(size);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Logger::WriteNow(const char* text, size_t length) const
+{
+	std::unique_lock lock(_s_allLock);
+	_ostream.write(text, length);
+	_ostream << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
@@ -12,8 +12,29 @@
 #pragma once
 
 #include "libCore.h"
+#include "Arena.h"
+#include "InstrumentedMutex.h"
 #include <iostream>
 #include <mutex>
+#include <cstring>
+#include <string>
+
+/**
+	Log levels below FIRE_LOG_LEVEL are compiled out, arguments and all. Define it up front to override the default, which keeps
+	everything in debug and release builds and drops debug output from final builds.
+ **/
+#define FIRE_LOG_LEVEL_DEBUG   0
+#define FIRE_LOG_LEVEL_WARNING 1
+#define FIRE_LOG_LEVEL_ERROR   2
+#define FIRE_LOG_LEVEL_NONE    3
+
+#ifndef FIRE_LOG_LEVEL
+# ifdef FIRE_FINAL
+#  define FIRE_LOG_LEVEL FIRE_LOG_LEVEL_WARNING
+# else
+#  define FIRE_LOG_LEVEL FIRE_LOG_LEVEL_DEBUG
+# endif
+#endif
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -27,67 +48,271 @@ static string Format(const char* fmt, ...)
 	return s;
 }
 
+/**
+	What a thread does when its log ring is full.
+ **/
+enum class LogOverflowPolicy
+{
+	Drop,  // throw the message away and count it. The count is reported once there's room again.
+	Block  // wait for the drain thread to make room.
+};
+
+class Logger;
+
+namespace LogDetail
+{
+	using DecodeFunc = void(*)(const char* format, const char* args, string& out);
+
+	enum RecordKind : uint32_t
+	{
+		kWrap,      // filler at the end of the ring, skip to the start.
+		kDeferred,  // a format and its raw arguments, formatted by the drain thread.
+		kFormatted  // text that was formatted by the thread that logged it.
+	};
+
+	struct RecordHeader
+	{
+		uint32_t      Size;
+		uint32_t      Kind;
+		const Logger* Target;
+		const char*   Format;
+		DecodeFunc    Decode;
+	};
+
+	/**
+		How a single argument is captured into a record and handed back to the formatter. Numbers, enums and
+		pointers are copied as they are. Strings are copied in full since they may be gone by the time the drain
+		thread gets to them.
+	 **/
+	template<class T>
+	struct Arg
+	{
+		static_assert(eastl::is_arithmetic<T>::value || eastl::is_enum<T>::value || eastl::is_pointer<T>::value,
+			"only numbers, enums, pointers and strings can be logged");
+
+		static size_t GetSize(const T&) { return sizeof(T); }
+		static T Pass(const T& value) { return value; }
+
+		static void Write(char*& cursor, const T& value)
+		{
+			memcpy(cursor, &value, sizeof(T));
+			cursor += sizeof(T);
+		}
+
+		static T Read(const char*& cursor)
+		{
+			T value;
+			memcpy(&value, cursor, sizeof(T));
+			cursor += sizeof(T);
+			return value;
+		}
+	};
+
+	struct StringArg
+	{
+		static size_t GetSize(const char* value) { return sizeof(uint32_t) + (value ? strlen(value) : 6) + 1; }
+		static const char* Pass(const char* value) { return value; }
+
+		static void Write(char*& cursor, const char* value)
+		{
+			if(!value)
+			{
+				value = "(null)";
+			}
+			const uint32_t length = static_cast<uint32_t>(strlen(value));
+			memcpy(cursor, &length, sizeof(length));
+			memcpy(cursor + sizeof(length), value, length + 1);
+			cursor += sizeof(length) + length + 1;
+		}
+
+		static const char* Read(const char*& cursor)
+		{
+			uint32_t length;
+			memcpy(&length, cursor, sizeof(length));
+			const char* value = cursor + sizeof(length);
+			cursor += sizeof(length) + length + 1;
+			return value;
+		}
+	};
+
+	template<> struct Arg<const char*> : StringArg {};
+	template<> struct Arg<char*> : StringArg {};
+
+	template<>
+	struct Arg<string> : StringArg
+	{
+		static size_t GetSize(const string& value) { return StringArg::GetSize(value.c_str()); }
+		static const char* Pass(const string& value) { return value.c_str(); }
+		static void Write(char*& cursor, const string& value) { StringArg::Write(cursor, value.c_str()); }
+	};
+
+	template<>
+	struct Arg<std::string> : StringArg
+	{
+		static size_t GetSize(const std::string& value) { return StringArg::GetSize(value.c_str()); }
+		static const char* Pass(const std::string& value) { return value.c_str(); }
+		static void Write(char*& cursor, const std::string& value) { StringArg::Write(cursor, value.c_str()); }
+	};
+
+	template<class T>
+	using ArgOf = Arg<eastl::decay_t<T>>;
+
+	template<class... Args, size_t... Is>
+	void DecodeImpl(const char* format, const char* args, string& out, eastl::index_sequence<Is...>)
+	{
+		// braced initialization runs left to right, so the arguments come back out in the order they went in.
+		eastl::tuple<decltype(Arg<Args>::Read(args))...> values{ Arg<Args>::Read(args)... };
+		out.append_sprintf(format, eastl::get<Is>(values)...);
+	}
+
+	template<class... Args>
+	void Decode(const char* format, const char* args, string& out)
+	{
+		DecodeImpl<Args...>(format, args, out, eastl::index_sequence_for<Args...>());
+	}
+
+	inline const char* GetFormatString(const char* format) { return format; }
+	inline const char* GetFormatString(const string& format) { return format.c_str(); }
+}
+
+/**
+	\class Logger
+
+	Logging doesn't touch the output stream on the thread that logs. Every thread gets its own lock free ring
+	that the message is copied into, and a background thread drains the rings, formats the messages and writes
+	them out in batches.
+
+	When the format is a string literal formatting is deferred as well: only the format pointer and the raw
+	arguments are captured, and the drain thread does the printf. Any other format (or a va_list) is formatted
+	up front into scratch memory and the text is queued instead.
+
+	Messages from a single thread come out in the order they were logged. Messages from different threads may
+	interleave differently than they were logged in. Errors flush the log, so they're out before anything else
+	goes wrong.
+
+	\note Only numbers, enums, pointers and strings can be passed as arguments. Strings are copied, so passing a
+	\c string for a \c %s is fine.
+	\warning Any char array passed as the format is taken to be a string literal. Don't log with a format that
+	lives in a local buffer.
+	\note The drain thread starts with the first message. Once it has shut down at exit, messages are written
+	straight to the stream.
+ **/
 class Logger
 {
+	using RecordHeader = LogDetail::RecordHeader;
 public:
-	Logger(std::ostream& ostream);
+	constexpr Logger(std::ostream& ostream)
+	: _ostream(ostream)
+	{
+	}
+
+	template<class Format_t, class... Args>
+	void Log(const Format_t& format, const Args&... args) const
+	{
+		if constexpr(eastl::is_array<Format_t>::value)
+		{
+			const size_t size = sizeof(RecordHeader) + (LogDetail::ArgOf<Args>::GetSize(args) + ... + 0);
+			if(size <= MaxRecordSize && IsAsync())
+			{
+				char* record = Reserve(size);
+				if(record)
+				{
+					RecordHeader header{ 0, LogDetail::kDeferred, this, format, &LogDetail::Decode<eastl::decay_t<Args>...> };
+					memcpy(record, &header, sizeof(header));
+					char* cursor = record + sizeof(header);
+					(LogDetail::ArgOf<Args>::Write(cursor, args), ...);
+					Commit(size);
+				}
+				return;
+			}
+		}
 
-	void Write(const char* format, va_list list)
+		// format into scratch memory so that logging doesn't have to go to the heap.
+		ScratchArena::Scope scratch;
+		ScratchString s;
+		s.append_sprintf(LogDetail::GetFormatString(format), LogDetail::ArgOf<Args>::Pass(args)...);
+		Submit(s.c_str(), s.size());
+	}
+
+	void Write(const char* format, va_list list) const
 	{
-		std::unique_lock lock(_s_allLock);
-		string s;
+		ScratchArena::Scope scratch;
+		ScratchString s;
 		s.append_sprintf_va_list(format, list);
-		_ostream << s.c_str()<<std::endl<<std::flush;
+		Submit(s.c_str(), s.size());
 	}
 
+	/**
+		Wait until everything logged so far, from every thread, has been written out.
+	 **/
+	static void Flush();
+
+	static void SetOverflowPolicy(LogOverflowPolicy policy);
+	static LogOverflowPolicy GetOverflowPolicy();
+
+	/**
+		Retrieve how many messages have been dropped because a ring was full.
+	 **/
+	static uint64_t GetNumDropped();
+
+	// the largest message that can be queued. Anything bigger is formatted up front and cut short to fit.
+	static const size_t MaxRecordSize = 16 * 1024;
+
 	static Logger DEBUG_LOGGER;
 	static Logger WARN_LOGGER;
 	static Logger ERROR_LOGGER;
 
 private:
-	static std::mutex _s_allLock;
-	std::ostream& _ostream;
-};
+	friend class LogBackend;
 
-static void FIRE_LOG_DEBUG(const char* format, ...)
-{
-	va_list l;
-	va_start(l, format);
-	Logger::DEBUG_LOGGER.Write(format, l);
-	va_end(l);
-}
+	// false while messages have to be written straight to the stream.
+	static bool IsAsync();
 
-static void FIRE_LOG_DEBUG(const char* format, va_list l)
-{
-	Logger::DEBUG_LOGGER.Write(format, l);
-}
+	// room for a record of \c size bytes in the calling thread's ring, or nullptr if the message was dropped.
+	static char* Reserve(size_t size);
+	static void Commit(size_t size);
 
-static void FIRE_LOG_WARNING(const char* format, ...)
-{
-	va_list l;
-	va_start(l, format);
-	Logger::WARN_LOGGER.Write(format, l);
-	va_end(l);
-}
+	void Submit(const char* text, size_t length) const;
+	void WriteNow(const char* text, size_t length) const;
 
-static void FIRE_LOG_WARNING(const char* format, va_list l)
-{
-	Logger::WARN_LOGGER.Write(format, l);
-}
+	static inline FIRE_MUTEX(_s_allLock, "Logger::_s_allLock");
+	std::ostream& _ostream;
+};
 
-static void FIRE_LOG_ERROR(const char* format, ...)
+namespace LogDetail
 {
-	va_list l;
-	va_start(l, format);
-	Logger::ERROR_LOGGER.Write(format, l);
-	va_end(l);
-}
+	template<class Format_t, class... Args>
+	inline void Log(const Logger& logger, const Format_t& format, const Args&... args)
+	{
+		logger.Log(format, args...);
+	}
 
-static void FIRE_LOG_ERROR(const char* format, va_list l)
-{
-	Logger::ERROR_LOGGER.Write(format, l);
+	inline void Log(const Logger& logger, const char* format, va_list l)
+	{
+		logger.Write(format, l);
+	}
 }
 
 CLOSE_NAMESPACE(Firestorm);
 
-#endif
\ No newline at end of file
+// the log macros take either a format and its arguments, or a format and a va_list. Below FIRE_LOG_LEVEL they
+// expand to nothing, so their arguments aren't evaluated either.
+#if FIRE_LOG_LEVEL <= FIRE_LOG_LEVEL_DEBUG
+#define FIRE_LOG_DEBUG(...) ::Firestorm::LogDetail::Log(::Firestorm::Logger::DEBUG_LOGGER, __VA_ARGS__)
+#else
+#define FIRE_LOG_DEBUG(...) ((void)0)
+#endif
+
+#if FIRE_LOG_LEVEL <= FIRE_LOG_LEVEL_WARNING
+#define FIRE_LOG_WARNING(...) ::Firestorm::LogDetail::Log(::Firestorm::Logger::WARN_LOGGER, __VA_ARGS__)
+#else
+#define FIRE_LOG_WARNING(...) ((void)0)
+#endif
+
+#if FIRE_LOG_LEVEL <= FIRE_LOG_LEVEL_ERROR
+#define FIRE_LOG_ERROR(...) (::Firestorm::LogDetail::Log(::Firestorm::Logger::ERROR_LOGGER, __VA_ARGS__), ::Firestorm::Logger::Flush())
+#else
+#define FIRE_LOG_ERROR(...) ((void)0)
+#endif
+
+#endif
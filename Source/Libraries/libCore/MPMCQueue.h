@@ -0,0 +1,516 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MPMCQueue
+//
+//  A bounded lock free queue that any number of threads can push into and pop out of.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_MPMCQUEUE_H_
+#define LIBCORE_MPMCQUEUE_H_
+#pragma once
+
+#include "libCore.h"
+#include "Assert.h"
+#include "AtomicWait.h"
+
+#include <chrono>
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class MPMCQueue
+
+	Bounded multi-producer/multi-consumer ring buffer, after Dmitry Vyukov's design. Every cell carries a sequence
+	number that tells producers and consumers whether it's their turn with it, so a push or pop is a single CAS on
+	the shared position plus an uncontended store on the cell.
+
+	The capacity is rounded up to the next power of two.
+
+	\note Unlike SynchronizedQueue nothing in here ever blocks. When you need to wait for items (or for room) use
+	BlockingMPMCQueue.
+ **/
+template <class T>
+class MPMCQueue final
+{
+public:
+	explicit MPMCQueue(size_t capacity)
+	{
+		FIRE_ASSERT_MSG(capacity >= 2, "MPMCQueue needs room for at least two items");
+		_capacity = 2;
+		while(_capacity < capacity)
+		{
+			_capacity <<= 1;
+		}
+		_mask = _capacity - 1;
+
+		_cells = new Cell[_capacity];
+		for(size_t i = 0; i < _capacity; ++i)
+		{
+			_cells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	~MPMCQueue()
+	{
+		// whatever is left in the queue still needs to be destroyed.
+		size_t pushPos = _pushPos.load();
+		for(size_t pos = _popPos.load(); pos != pushPos; ++pos)
+		{
+			Cell& cell = _cells[pos & _mask];
+			if(cell.Sequence.load() == pos + 1)
+			{
+				reinterpret_cast<T*>(&cell.Storage)->~T();
+			}
+		}
+		delete[] _cells;
+	}
+
+	/**
+		Push a copy of \c item into the queue. Returns false if the queue is full.
+	 **/
+	bool TryPush(const T& item)
+	{
+		size_t pos;
+		Cell* cell = ClaimPush(pos);
+		if(cell == nullptr)
+		{
+			return false;
+		}
+		new(&cell->Storage) T(item);
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+		Move \c item into the queue. Returns false if the queue is full, in which case \c item is left untouched.
+	 **/
+	bool TryPush(T&& item)
+	{
+		size_t pos;
+		Cell* cell = ClaimPush(pos);
+		if(cell == nullptr)
+		{
+			return false;
+		}
+		new(&cell->Storage) T(std::move(item));
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+		Pop the item at the front of the queue into \c item. Returns false if the queue is empty.
+	 **/
+	bool TryPop(T& item)
+	{
+		size_t pos = _popPos.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			Cell& cell = _cells[pos & _mask];
+			size_t seq = cell.Sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+			if(diff == 0)
+			{
+				if(_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					ConsumeCell(cell, pos, item);
+					return true;
+				}
+			}
+			else if(diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _popPos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+		Push as many of the \c count items starting at \c items as there is room for. All of them are claimed with
+		a single CAS. Returns the number of items that were pushed, which will always be a prefix of \c items.
+	 **/
+	size_t PushBulk(const T* items, size_t count)
+	{
+		if(count == 0)
+		{
+			return 0;
+		}
+		size_t pos = _pushPos.load(std::memory_order_relaxed);
+		size_t claimed = 0;
+		for(;;)
+		{
+			claimed = CountReady(pos, count, 0);
+			if(claimed == 0)
+			{
+				// either the queue is full, or somebody else moved the position and we need to look again.
+				if(!IsCellReady(pos, 0) && _pushPos.load(std::memory_order_relaxed) == pos)
+				{
+					return 0;
+				}
+				pos = _pushPos.load(std::memory_order_relaxed);
+				continue;
+			}
+			if(_pushPos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+
+		for(size_t i = 0; i < claimed; ++i)
+		{
+			Cell& cell = _cells[(pos + i) & _mask];
+			new(&cell.Storage) T(items[i]);
+			cell.Sequence.store(pos + i + 1, std::memory_order_release);
+		}
+		return claimed;
+	}
+
+	/**
+		Pop up to \c maxCount items into \c items. All of them are claimed with a single CAS.
+		Returns the number of items that were popped.
+	 **/
+	size_t PopBulk(T* items, size_t maxCount)
+	{
+		if(maxCount == 0)
+		{
+			return 0;
+		}
+		size_t pos = _popPos.load(std::memory_order_relaxed);
+		size_t claimed = 0;
+		for(;;)
+		{
+			claimed = CountReady(pos, maxCount, 1);
+			if(claimed == 0)
+			{
+				if(!IsCellReady(pos, 1) && _popPos.load(std::memory_order_relaxed) == pos)
+				{
+					return 0;
+				}
+				pos = _popPos.load(std::memory_order_relaxed);
+				continue;
+			}
+			if(_popPos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+
+		for(size_t i = 0; i < claimed; ++i)
+		{
+			ConsumeCell(_cells[(pos + i) & _mask], pos + i, items[i]);
+		}
+		return claimed;
+	}
+
+	/**
+		Retrieve the number of items the queue can hold.
+	 **/
+	size_t GetCapacity() const { return _capacity; }
+
+	/**
+		Retrieve roughly how many items are in the queue. Only exact when nobody else is touching it.
+	 **/
+	size_t GetSizeApprox() const
+	{
+		size_t push = _pushPos.load(std::memory_order_relaxed);
+		size_t pop = _popPos.load(std::memory_order_relaxed);
+		return push > pop ? push - pop : 0;
+	}
+
+private:
+	MPMCQueue(const MPMCQueue&) = delete;
+	MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+	struct alignas(64) Cell
+	{
+		atomic<size_t> Sequence;
+		typename eastl::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+	};
+
+	// a cell at position pos is free for a producer when its sequence is pos, and full for a consumer when
+	// its sequence is pos + 1. a cell can only move out of either state by whoever owns pos, so once we've seen
+	// a run of ready cells they stay ready for as long as the shared position hasn't moved past them.
+	bool IsCellReady(size_t pos, size_t offset) const
+	{
+		return _cells[pos & _mask].Sequence.load(std::memory_order_acquire) == pos + offset;
+	}
+
+	size_t CountReady(size_t pos, size_t maxCount, size_t offset) const
+	{
+		size_t count = 0;
+		while(count < maxCount && count < _capacity && IsCellReady(pos + count, offset))
+		{
+			++count;
+		}
+		return count;
+	}
+
+	Cell* ClaimPush(size_t& pos)
+	{
+		pos = _pushPos.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			Cell& cell = _cells[pos & _mask];
+			size_t seq = cell.Sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if(diff == 0)
+			{
+				if(_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					return &cell;
+				}
+			}
+			else if(diff < 0)
+			{
+				return nullptr;
+			}
+			else
+			{
+				pos = _pushPos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void ConsumeCell(Cell& cell, size_t pos, T& item)
+	{
+		T* stored = reinterpret_cast<T*>(&cell.Storage);
+		item = std::move(*stored);
+		stored->~T();
+		cell.Sequence.store(pos + _mask + 1, std::memory_order_release);
+	}
+
+	Cell* _cells{ nullptr };
+	size_t _capacity{ 0 };
+	size_t _mask{ 0 };
+
+	alignas(64) atomic<size_t> _pushPos{ 0 };
+	alignas(64) atomic<size_t> _popPos{ 0 };
+};
+
+/**
+	\class BlockingMPMCQueue
+
+	MPMCQueue with the option to sleep while the queue is empty (or full). The fast path is exactly the lock free
+	queue, the waiting side sleeps on AtomicWait rather than a mutex and condition variable so that nobody has to
+	take a lock just to hand an item over.
+ **/
+template <class T>
+class BlockingMPMCQueue final
+{
+public:
+	static const uint32_t Infinite = AtomicWait::Infinite;
+
+	explicit BlockingMPMCQueue(size_t capacity)
+	: _queue(capacity)
+	{
+	}
+
+	bool TryPush(const T& item)
+	{
+		if(_queue.TryPush(item))
+		{
+			NotifyPushed();
+			return true;
+		}
+		return false;
+	}
+
+	bool TryPush(T&& item)
+	{
+		if(_queue.TryPush(std::move(item)))
+		{
+			NotifyPushed();
+			return true;
+		}
+		return false;
+	}
+
+	bool TryPop(T& item)
+	{
+		if(_queue.TryPop(item))
+		{
+			NotifyPopped();
+			return true;
+		}
+		return false;
+	}
+
+	size_t PushBulk(const T* items, size_t count)
+	{
+		size_t pushed = _queue.PushBulk(items, count);
+		if(pushed > 0)
+		{
+			NotifyPushed(pushed);
+		}
+		return pushed;
+	}
+
+	size_t PopBulk(T* items, size_t maxCount)
+	{
+		size_t popped = _queue.PopBulk(items, maxCount);
+		if(popped > 0)
+		{
+			NotifyPopped(popped);
+		}
+		return popped;
+	}
+
+	/**
+		Push \c item, sleeping while the queue is full. Returns false if the queue was shut down or the timeout
+		ran out before there was room.
+	 **/
+	bool Push(T item, uint32_t timeoutMs = Infinite)
+	{
+		return WaitFor(_popEpoch, _numWaitingProducers, timeoutMs, [this, &item]() {
+			return TryPush(std::move(item));
+		});
+	}
+
+	/**
+		Pop into \c item, sleeping while the queue is empty. Returns false if the queue was shut down or the
+		timeout ran out before anything showed up.
+	 **/
+	bool Pop(T& item, uint32_t timeoutMs = Infinite)
+	{
+		return WaitFor(_pushEpoch, _numWaitingConsumers, timeoutMs, [this, &item]() {
+			return TryPop(item);
+		});
+	}
+
+	/**
+		Pop at least one and up to \c maxCount items, sleeping while the queue is empty.
+		Returns the number of items popped, which is 0 on shutdown or timeout.
+	 **/
+	size_t PopBulk(T* items, size_t maxCount, uint32_t timeoutMs)
+	{
+		size_t popped = 0;
+		WaitFor(_pushEpoch, _numWaitingConsumers, timeoutMs, [this, items, maxCount, &popped]() {
+			popped = PopBulk(items, maxCount);
+			return popped > 0;
+		});
+		return popped;
+	}
+
+	/**
+		Wake everybody that is waiting and make every blocking call from here on return false once the queue
+		can't satisfy it. Items still in the queue can be popped with the Try functions.
+	 **/
+	void Shutdown()
+	{
+		_shutdown.store(true);
+		_pushEpoch.fetch_add(1);
+		_popEpoch.fetch_add(1);
+		AtomicWait::WakeAll(_pushEpoch);
+		AtomicWait::WakeAll(_popEpoch);
+	}
+
+	bool IsShutdown() const { return _shutdown.load(); }
+
+	size_t GetCapacity() const { return _queue.GetCapacity(); }
+	size_t GetSizeApprox() const { return _queue.GetSizeApprox(); }
+
+private:
+	void NotifyPushed(size_t count = 1)
+	{
+		_pushEpoch.fetch_add(1);
+		if(_numWaitingConsumers.load() > 0)
+		{
+			if(count > 1)
+			{
+				AtomicWait::WakeAll(_pushEpoch);
+			}
+			else
+			{
+				AtomicWait::WakeOne(_pushEpoch);
+			}
+		}
+	}
+
+	void NotifyPopped(size_t count = 1)
+	{
+		_popEpoch.fetch_add(1);
+		if(_numWaitingProducers.load() > 0)
+		{
+			if(count > 1)
+			{
+				AtomicWait::WakeAll(_popEpoch);
+			}
+			else
+			{
+				AtomicWait::WakeOne(_popEpoch);
+			}
+		}
+	}
+
+	template <class Attempt_t>
+	bool WaitFor(atomic<uint32_t>& epoch, atomic<uint32_t>& numWaiting, uint32_t timeoutMs, const Attempt_t& attempt)
+	{
+		using clock = std::chrono::steady_clock;
+		const clock::time_point deadline = clock::now() + std::chrono::milliseconds(timeoutMs);
+
+		for(;;)
+		{
+			// handoffs are usually quick, so spin for a little while before paying for a trip into the kernel.
+			for(size_t spin = 0; spin < s_spinCount; ++spin)
+			{
+				if(attempt())
+				{
+					return true;
+				}
+				if(_shutdown.load())
+				{
+					return false;
+				}
+				std::this_thread::yield();
+			}
+
+			// announce ourselves before sampling the epoch. the other side bumps the epoch before it checks for
+			// waiters, so either it sees us and wakes us, or we see its bump and the futex won't put us to sleep.
+			numWaiting.fetch_add(1);
+			uint32_t observed = epoch.load();
+			bool keepWaiting = true;
+			if(attempt())
+			{
+				numWaiting.fetch_sub(1);
+				return true;
+			}
+			if(!_shutdown.load())
+			{
+				uint32_t waitMs = Infinite;
+				if(timeoutMs != Infinite)
+				{
+					clock::time_point now = clock::now();
+					waitMs = now >= deadline ? 0 :
+						static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+				}
+				keepWaiting = waitMs > 0 && AtomicWait::Wait(epoch, observed, waitMs);
+			}
+			numWaiting.fetch_sub(1);
+
+			if(!keepWaiting)
+			{
+				return attempt();
+			}
+		}
+	}
+
+	static const size_t s_spinCount = 64;
+
+	MPMCQueue<T> _queue;
+
+	alignas(64) atomic<uint32_t> _pushEpoch{ 0 };
+	atomic<uint32_t> _numWaitingConsumers{ 0 };
+
+	alignas(64) atomic<uint32_t> _popEpoch{ 0 };
+	atomic<uint32_t> _numWaitingProducers{ 0 };
+
+	atomic<bool> _shutdown{ false };
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -12,33 +12,393 @@
 #pragma once
 
 #include "SOA.h"
+#include "Hash.h"
+
+#include <EASTL/span.h>
 
 OPEN_NAMESPACE(Firestorm);
 
-template<class PrimaryKey, class... TypesT>
-struct MapSOA final
+/**
+	\class MapSOA
+
+	A structure of arrays where every row belongs to a unique key. The rows are always tightly packed: inserting
+	appends a row and erasing moves the last row into the hole (swap and pop), so iterating over the columns never
+	runs into gaps no matter how much the rows churn.
+
+	The key is stored as column 0 and the members follow it, so \c 0_soa is the key column and \c 1_soa is the
+	first member. Looking a key up, inserting and erasing are all O(1).
+
+	Row indices move around as other rows get erased. A Handle doesn't: it keeps referring to the same row until
+	that row is erased, after which it's rejected by Resolve and IsValid.
+
+	\warning Never write to the key column directly, the key to row mapping would go out of sync.
+	\warning Inserting and erasing invalidate the column pointers, and erasing invalidates row indices. Don't do
+	either from inside of ForEach.
+ **/
+template<class Key_t, class... Ts>
+class MapSOA final
 {
-	using SOAType = SOA<TypesT...>;
-	using KeyToIndexMap = unordered_map<PrimaryKey, size_t>;
-	using IndexToKeyMap = vector<PrimaryKey>;
+	using SOAType = SOA<Key_t, Ts...>;
+	using KeyToIndexMap = Hash<Key_t, size_t>;
 public:
+	static constexpr size_t InvalidIndex = eastl::numeric_limits<size_t>::max();
+
+	/**
+		A reference to a row that survives other rows being inserted and erased.
+	 **/
+	struct Handle
+	{
+		uint32_t Slot{ 0xFFFFFFFF };
+		uint32_t Generation{ 0 };
+
+		bool operator==(const Handle& other) const { return Slot == other.Slot && Generation == other.Generation; }
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
 	MapSOA() {}
 	~MapSOA() = default;
 
-	void Insert(const PrimaryKey& key)
+	size_t Size() const { return _soa.size(); }
+	bool Empty() const { return _soa.size() == 0; }
+
+	/**
+		Make room for \c numRows rows without reallocating.
+	 **/
+	void Reserve(size_t numRows)
+	{
+		_soa.reserve(numRows);
+		_keyToIndexMap.reserve(numRows);
+		_indexToSlot.reserve(numRows);
+	}
+
+	/**
+		Remove every row. Every handle handed out so far becomes invalid.
+	 **/
+	void Clear()
+	{
+		for(size_t i = 0; i < _indexToSlot.size(); ++i)
+		{
+			ReleaseSlot(_indexToSlot[i]);
+		}
+		_soa.clear();
+		_keyToIndexMap.clear();
+		_indexToSlot.clear();
+	}
+
+	bool Contains(const Key_t& key) const
+	{
+		return _keyToIndexMap.contains(key);
+	}
+
+	/**
+		Retrieve the row index of \c key, or InvalidIndex if it isn't in the container.
+	 **/
+	size_t Find(const Key_t& key) const
+	{
+		auto found = _keyToIndexMap.find(key);
+		return found != _keyToIndexMap.end() ? found->second : InvalidIndex;
+	}
+
+	const Key_t& GetKey(size_t index) const
+	{
+		FIRE_ASSERT_MSG(index < Size(), Format("index '%zu' out of bounds", index));
+		return _soa.template get<0>()[index];
+	}
+
+	/**
+		Append a row for \c key with its members default constructed.
+
+		\return The index of the new row.
+	 **/
+	size_t Insert(const Key_t& key)
 	{
 		FIRE_ASSERT_MSG(Contains(key) == false, "can not double insert a key...");
-		size_t index = _indexToKeyMap.size();
-		_indexToKeyMap.push_back(key);
-		_keyToIndex[index] = index;
+		const size_t index = _soa.size();
+		_soa.push_back();
+		_soa.template get<0>()[index] = key;
+		Link(key, index);
+		return index;
+	}
+
+	/**
+		Append a row for \c key with its members copied from \c members.
+
+		\return The index of the new row.
+	 **/
+	size_t Insert(const Key_t& key, const Ts&... members)
+	{
+		FIRE_ASSERT_MSG(Contains(key) == false, "can not double insert a key...");
+		const size_t index = _soa.size();
+		_soa.push_back(key, members...);
+		Link(key, index);
+		return index;
+	}
+
+	/**
+		Insert a default constructed row for every key in \c keys that isn't in the container yet.
+
+		\return The number of rows that were inserted.
+	 **/
+	size_t InsertBulk(eastl::span<const Key_t> keys)
+	{
+		Reserve(Size() + keys.size());
+		size_t numInserted = 0;
+		for(const Key_t& key : keys)
+		{
+			if(!Contains(key))
+			{
+				Insert(key);
+				++numInserted;
+			}
+		}
+		return numInserted;
+	}
+
+	/**
+		Erase the row of \c key by moving the last row into its place.
+
+		\return Whether or not \c key was in the container.
+	 **/
+	bool Erase(const Key_t& key)
+	{
+		const size_t index = Find(key);
+		if(index == InvalidIndex)
+		{
+			return false;
+		}
+		EraseAt(index);
+		return true;
+	}
+
+	/**
+		Erase the row that \c handle refers to, see Erase(const Key_t&).
+	 **/
+	bool Erase(Handle handle)
+	{
+		const size_t index = Resolve(handle);
+		if(index == InvalidIndex)
+		{
+			return false;
+		}
+		EraseAt(index);
+		return true;
+	}
+
+	/**
+		Erase the row at \c index by moving the last row into its place.
+	 **/
+	void EraseAt(size_t index)
+	{
+		FIRE_ASSERT_MSG(index < Size(), Format("index '%zu' out of bounds", index));
+		Key_t* keys = _soa.template get<0>();
+		const size_t last = _soa.size() - 1;
+
+		_keyToIndexMap.erase(keys[index]);
+		ReleaseSlot(_indexToSlot[index]);
+		if(index != last)
+		{
+			_keyToIndexMap.find(keys[last])->second = index;
+			_indexToSlot[index] = _indexToSlot[last];
+			_slots[_indexToSlot[index]].Index = static_cast<uint32_t>(index);
+		}
+		_indexToSlot.pop_back();
+		_soa.erase_unsorted(_soa.begin() + index);
+	}
+
+	/**
+		Erase the rows of every key in \c keys. Keys that aren't in the container are skipped.
+
+		\return The number of rows that were erased.
+	 **/
+	size_t EraseBulk(eastl::span<const Key_t> keys)
+	{
+		size_t numErased = 0;
+		for(const Key_t& key : keys)
+		{
+			numErased += Erase(key) ? 1 : 0;
+		}
+		return numErased;
+	}
+
+	/**
+		Retrieve a handle to the row at \c index.
+	 **/
+	Handle GetHandle(size_t index) const
+	{
+		FIRE_ASSERT_MSG(index < Size(), Format("index '%zu' out of bounds", index));
+		const uint32_t slot = _indexToSlot[index];
+		return Handle{ slot, _slots[slot].Generation };
+	}
+
+	/**
+		Retrieve the row index that \c handle refers to, or InvalidIndex if the row has been erased since.
+	 **/
+	size_t Resolve(Handle handle) const
+	{
+		if(handle.Slot >= _slots.size() || _slots[handle.Slot].Generation != handle.Generation)
+		{
+			return InvalidIndex;
+		}
+		return _slots[handle.Slot].Index;
+	}
+
+	bool IsValid(Handle handle) const
+	{
+		return Resolve(handle) != InvalidIndex;
+	}
+
+	/**
+		Call \c func(key, members...) for every row, in the order that the rows are stored in. The members are
+		passed by reference and can be modified.
+	 **/
+	template<class Func_t>
+	void ForEach(Func_t&& func)
+	{
+		ForEachImpl(func, eastl::make_index_sequence<sizeof...(Ts)>());
+	}
+
+	template<class Func_t>
+	void ForEach(Func_t&& func) const
+	{
+		ForEachImpl(func, eastl::make_index_sequence<sizeof...(Ts)>());
+	}
+
+	/**
+		Walk the selected columns a chunk at a time, see SOA::ForEachChunk. Column 0 holds the keys.
+	 **/
+	template<size_t... I, class Func_t>
+	void ForEachChunk(soa_columns<I...> columns, Func_t&& func, size_t chunkSize = 0)
+	{
+		_soa.ForEachChunk(columns, func, chunkSize);
+	}
+
+	/**
+		Walk the selected columns a chunk at a time on every thread of \c jobSystem, see SOA::ParallelForEach.
+	 **/
+	template<size_t... I, class Func_t>
+	void ParallelForEach(JobSystem& jobSystem, soa_columns<I...> columns, Func_t&& func, size_t chunkSize = 0)
+	{
+		_soa.ParallelForEach(jobSystem, columns, func, chunkSize);
+	}
+
+	/**
+		Append a snapshot of every column, keys included, to \c out. See SOA::SaveColumns.
+	 **/
+	void SaveColumns(vector<char>& out) const
+	{
+		_soa.SaveColumns(out);
+	}
+
+	/**
+		Replace the contents of the container with the snapshot in \c data. The key to row mapping is rebuilt from
+		the key column, and every handle handed out so far becomes invalid. On failure the container is left empty.
+	 **/
+	Result<void, Error> LoadColumns(span<const char> data)
+	{
+		Clear();
+		Result<void, Error> result = _soa.LoadColumns(data);
+		if(!result)
+		{
+			return result;
+		}
+
+		const Key_t* keys = _soa.template get<0>();
+		const size_t size = _soa.size();
+		_keyToIndexMap.reserve(size);
+		_indexToSlot.reserve(size);
+		for(size_t i = 0; i < size; ++i)
+		{
+			if(Contains(keys[i]))
+			{
+				Clear();
+				return FIRE_ERROR(SOASnapshotErrors::DUPLICATE_KEY, Format("row %zu repeats an earlier key", i));
+			}
+			Link(keys[i], i);
+		}
+		return result;
+	}
+
+	/**
+		Retrieve the column at \c I. Column 0 holds the keys.
+	 **/
+	template<size_t I>
+	const eastl::TupleVecInternal::tuplevec_element_t<I, Key_t, Ts...>* operator[](soa_index<I> index) const
+	{
+		return _soa[index];
+	}
+
+	template<size_t I>
+	eastl::TupleVecInternal::tuplevec_element_t<I, Key_t, Ts...>* operator[](soa_index<I> index)
+	{
+		return _soa[index];
 	}
 
 private:
+	struct Slot
+	{
+		uint32_t Index;      // the row while the slot is in use, the next free slot when it isn't.
+		uint32_t Generation;
+	};
+
+	static const uint32_t kNoSlot = 0xFFFFFFFF;
+
+	void Link(const Key_t& key, size_t index)
+	{
+		FIRE_ASSERT_MSG(index < kNoSlot, "MapSOA handles only cover 2^32 rows");
+		_keyToIndexMap.try_emplace(key, index);
+
+		uint32_t slot = _freeSlot;
+		if(slot != kNoSlot)
+		{
+			_freeSlot = _slots[slot].Index;
+		}
+		else
+		{
+			slot = static_cast<uint32_t>(_slots.size());
+			_slots.push_back(Slot{ 0, 0 });
+		}
+		_slots[slot].Index = static_cast<uint32_t>(index);
+		_indexToSlot.push_back(slot);
+	}
+
+	void ReleaseSlot(uint32_t slot)
+	{
+		++_slots[slot].Generation;
+		_slots[slot].Index = _freeSlot;
+		_freeSlot = slot;
+	}
+
+	template<class Func_t, size_t... Is>
+	void ForEachImpl(Func_t& func, eastl::index_sequence<Is...>)
+	{
+		const Key_t* keys = _soa.template get<0>();
+		auto columns = eastl::make_tuple(_soa.template get<Is + 1>()...);
+		const size_t size = _soa.size();
+		for(size_t i = 0; i < size; ++i)
+		{
+			func(keys[i], eastl::get<Is>(columns)[i]...);
+		}
+	}
+
+	template<class Func_t, size_t... Is>
+	void ForEachImpl(Func_t& func, eastl::index_sequence<Is...>) const
+	{
+		const Key_t* keys = _soa.template get<0>();
+		auto columns = eastl::make_tuple(_soa.template get<Is + 1>()...);
+		const size_t size = _soa.size();
+		for(size_t i = 0; i < size; ++i)
+		{
+			func(keys[i], eastl::get<Is>(columns)[i]...);
+		}
+	}
+
 	SOAType _soa;
 	KeyToIndexMap _keyToIndexMap;
-	IndexToKeyMap _indexToKeyMap;
+	vector<uint32_t> _indexToSlot;
+	vector<Slot> _slots;
+	uint32_t _freeSlot{ kNoSlot };
 };
 
 CLOSE_NAMESPACE(Firestorm);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,474 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MemoryTracker
+//
+//  Keeps tabs on who allocated what through libCore, so that leaks can be reported and memory use can be broken
+//  down by subsystem.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "MemoryTracker.h"
+
+#ifdef FIRE_MEMORY_TRACKING
+
+#include "Allocator.h"
+#include "Assert.h"
+#include "ThreadSlot.h"
+#include "Logger.h"
+#include <EASTL/sort.h>
+#include <cstdio>
+
+// OnAllocate and OnFree run inside of libCore::Alloc and libCore::Free, so they may not allocate themselves.
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct TrackedSite
+{
+	atomic<uint64_t> Key;     // the callsite with (tag + 1) packed into the top byte. 0 while the site is unused.
+	atomic<int64_t>  LiveBytes;
+	atomic<int64_t>  LiveAllocations;
+	atomic<uint64_t> TotalAllocations;
+	atomic<int64_t>  BaselineBytes;
+	atomic<int64_t>  BaselineAllocations;
+};
+
+struct TrackedTag
+{
+	atomic<int64_t>  LiveBytes;
+	atomic<int64_t>  LiveAllocations;
+	atomic<int64_t>  PeakBytes;
+	atomic<uint64_t> TotalAllocations;
+};
+
+enum EventOp : uint8_t
+{
+	kAllocate,
+	kFree
+};
+
+struct TrackedEvent
+{
+	const void* Block;
+	const void* Callsite;
+	uint64_t    Size;
+	uint32_t    ThreadId;
+	uint8_t     Op;
+	uint8_t     Tag;
+};
+
+// written only by the thread that owns the ThreadSlot. Head counts every event ever written, so the live events
+// are the last min(Head, LogCapacity) of them.
+struct TrackedLog
+{
+	atomic<uint64_t> Head;
+	TrackedEvent     Events[MemoryTracker::LogCapacity];
+};
+
+static const uint64_t s_tagShift = 56;
+static const uint64_t s_callsiteMask = (uint64_t(1) << s_tagShift) - 1;
+
+static TrackedSite         s_sites[MemoryTracker::MaxSites];
+static TrackedTag          s_tags[static_cast<size_t>(MemoryTag::Count)];
+static atomic<TrackedLog*> s_logs[ThreadSlot::MaxSlots];
+static atomic<size_t>      s_numUntracked{ 0 };
+static atomic<bool>        s_enabled{ true };
+
+static thread_local MemoryTag tl_currentTag = MemoryTag::Untagged;
+static thread_local uint32_t  tl_threadId = 0;
+
+static const char* s_tagNames[] = {
+	"Untagged",
+	"App",
+	"Core",
+	"ECS",
+	"IO",
+	"Json",
+	"Math",
+	"Mirror",
+	"Scene",
+	"Script",
+	"Serial",
+	"UI"
+};
+static_assert(sizeof(s_tagNames) / sizeof(s_tagNames[0]) == static_cast<size_t>(MemoryTag::Count), "every MemoryTag needs a name");
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline MemoryTag GetSiteTag(uint64_t key)
+{
+	return static_cast<MemoryTag>((key >> s_tagShift) - 1);
+}
+
+static inline const void* GetSiteCallsite(uint64_t key)
+{
+	return reinterpret_cast<const void*>(key & s_callsiteMask);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// returns the site id, which is the index into s_sites plus one so that 0 can mean "not tracked".
+static uint16_t FindOrAddSite(const void* callsite, MemoryTag tag)
+{
+	const uint64_t key = (reinterpret_cast<uint64_t>(callsite) & s_callsiteMask) | ((uint64_t(tag) + 1) << s_tagShift);
+
+	// fibonacci hash of the key, then probe linearly. sites are never removed so a probe can stop at the first
+	// empty slot.
+	size_t index = static_cast<size_t>((key * 11400714819323198485ull) >> 50) & (MemoryTracker::MaxSites - 1);
+	for(size_t probe = 0; probe < MemoryTracker::MaxSites; ++probe)
+	{
+		TrackedSite& site = s_sites[index];
+		uint64_t existing = site.Key.load(std::memory_order_acquire);
+		if(existing == 0 && site.Key.compare_exchange_strong(existing, key, std::memory_order_acq_rel))
+		{
+			return static_cast<uint16_t>(index + 1);
+		}
+		if(existing == key)
+		{
+			return static_cast<uint16_t>(index + 1);
+		}
+		index = (index + 1) & (MemoryTracker::MaxSites - 1);
+	}
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void AppendEvent(EventOp op, MemoryTag tag, const void* block, size_t size, const void* callsite)
+{
+	const size_t slot = ThreadSlot::Get();
+	if(slot == ThreadSlot::Invalid)
+	{
+		return;
+	}
+
+	TrackedLog* log = s_logs[slot].load(std::memory_order_acquire);
+	if(log == nullptr)
+	{
+		// the log outlives the thread and gets inherited by whoever picks the slot up next.
+		log = static_cast<TrackedLog*>(std::calloc(1, sizeof(TrackedLog)));
+		if(log == nullptr)
+		{
+			return;
+		}
+		s_logs[slot].store(log, std::memory_order_release);
+	}
+
+	if(tl_threadId == 0)
+	{
+		tl_threadId = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+	}
+
+	const uint64_t head = log->Head.load(std::memory_order_relaxed);
+	TrackedEvent& event = log->Events[head & (MemoryTracker::LogCapacity - 1)];
+	event.Block = block;
+	event.Callsite = callsite;
+	event.Size = size;
+	event.ThreadId = tl_threadId;
+	event.Op = op;
+	event.Tag = static_cast<uint8_t>(tag);
+	log->Head.store(head + 1, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryTracker::OnAllocate(void* block, size_t size, const void* callsite)
+{
+	if(!s_enabled.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	const MemoryTag tag = tl_currentTag;
+	const uint16_t id = FindOrAddSite(callsite, tag);
+	if(id == 0)
+	{
+		s_numUntracked.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	Allocator::SetTrackingId(block, id);
+
+	TrackedSite& site = s_sites[id - 1];
+	site.LiveBytes.fetch_add(size, std::memory_order_relaxed);
+	site.LiveAllocations.fetch_add(1, std::memory_order_relaxed);
+	site.TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	TrackedTag& counters = s_tags[static_cast<size_t>(tag)];
+	int64_t live = counters.LiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	counters.LiveAllocations.fetch_add(1, std::memory_order_relaxed);
+	counters.TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+	int64_t peak = counters.PeakBytes.load(std::memory_order_relaxed);
+	while(live > peak && !counters.PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+	{
+	}
+
+	AppendEvent(kAllocate, tag, block, size, callsite);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryTracker::OnFree(void* block)
+{
+	const uint16_t id = Allocator::GetTrackingId(block);
+	if(id == 0)
+	{
+		return;
+	}
+
+	// charge the free to the site the block came from, even if tracking has since been switched off.
+	TrackedSite& site = s_sites[id - 1];
+	const uint64_t key = site.Key.load(std::memory_order_relaxed);
+	const MemoryTag tag = GetSiteTag(key);
+	const int64_t size = static_cast<int64_t>(Allocator::GetAllocationSize(block));
+	site.LiveBytes.fetch_sub(size, std::memory_order_relaxed);
+	site.LiveAllocations.fetch_sub(1, std::memory_order_relaxed);
+
+	TrackedTag& counters = s_tags[static_cast<size_t>(tag)];
+	counters.LiveBytes.fetch_sub(size, std::memory_order_relaxed);
+	counters.LiveAllocations.fetch_sub(1, std::memory_order_relaxed);
+
+	Allocator::SetTrackingId(block, 0);
+	if(s_enabled.load(std::memory_order_relaxed))
+	{
+		AppendEvent(kFree, tag, block, size, GetSiteCallsite(key));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryTracker::SetEnabled(bool enabled)
+{
+	s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MemoryTracker::IsEnabled()
+{
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryTag MemoryTracker::SetCurrentTag(MemoryTag tag)
+{
+	MemoryTag previous = tl_currentTag;
+	tl_currentTag = tag;
+	return previous;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryTag MemoryTracker::GetCurrentTag()
+{
+	return tl_currentTag;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* MemoryTracker::GetTagName(MemoryTag tag)
+{
+	return tag < MemoryTag::Count ? s_tagNames[static_cast<size_t>(tag)] : "Invalid";
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryTracker::Stats MemoryTracker::GetTagStats(MemoryTag tag)
+{
+	const TrackedTag& counters = s_tags[static_cast<size_t>(tag)];
+	Stats stats;
+	stats.LiveBytes = counters.LiveBytes.load(std::memory_order_relaxed);
+	stats.LiveAllocations = counters.LiveAllocations.load(std::memory_order_relaxed);
+	stats.PeakBytes = counters.PeakBytes.load(std::memory_order_relaxed);
+	stats.TotalAllocations = counters.TotalAllocations.load(std::memory_order_relaxed);
+	return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t MemoryTracker::GetNumUntrackedAllocations()
+{
+	return s_numUntracked.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryTracker::MarkBaseline()
+{
+	for(TrackedSite& site : s_sites)
+	{
+		if(site.Key.load(std::memory_order_relaxed) != 0)
+		{
+			site.BaselineBytes.store(site.LiveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			site.BaselineAllocations.store(site.LiveAllocations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MemoryTracker::Baseline MemoryTracker::GetBaseline()
+{
+	Baseline baseline;
+	baseline.Bytes.resize(MaxSites);
+	baseline.Allocations.resize(MaxSites);
+	for(size_t i = 0; i < MaxSites; ++i)
+	{
+		baseline.Bytes[i] = s_sites[i].BaselineBytes.load(std::memory_order_relaxed);
+		baseline.Allocations[i] = s_sites[i].BaselineAllocations.load(std::memory_order_relaxed);
+	}
+	return baseline;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MemoryTracker::RestoreBaseline(const Baseline& baseline)
+{
+	FIRE_ASSERT(baseline.Bytes.size() == MaxSites && baseline.Allocations.size() == MaxSites);
+	for(size_t i = 0; i < MaxSites; ++i)
+	{
+		s_sites[i].BaselineBytes.store(baseline.Bytes[i], std::memory_order_relaxed);
+		s_sites[i].BaselineAllocations.store(baseline.Allocations[i], std::memory_order_relaxed);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t MemoryTracker::ReportLeaks()
+{
+	struct Leak
+	{
+		uint64_t Key;
+		int64_t  Bytes;
+		int64_t  Allocations;
+	};
+
+	// gather everything up first. the report allocates, and that shouldn't end up in the report.
+	vector<Leak> leaks;
+	leaks.reserve(256);
+	for(TrackedSite& site : s_sites)
+	{
+		uint64_t key = site.Key.load(std::memory_order_relaxed);
+		int64_t allocations = site.LiveAllocations.load(std::memory_order_relaxed) - site.BaselineAllocations.load(std::memory_order_relaxed);
+		if(key != 0 && allocations > 0)
+		{
+			int64_t bytes = site.LiveBytes.load(std::memory_order_relaxed) - site.BaselineBytes.load(std::memory_order_relaxed);
+			leaks.push_back({ key, bytes, allocations });
+		}
+	}
+
+	if(leaks.empty())
+	{
+		FIRE_LOG_DEBUG("No memory leaks detected.");
+		return 0;
+	}
+
+	eastl::sort(leaks.begin(), leaks.end(), [](const Leak& a, const Leak& b) { return a.Bytes > b.Bytes; });
+
+	size_t numLeaked = 0;
+	int64_t bytesLeaked = 0;
+	for(const Leak& leak : leaks)
+	{
+		numLeaked += static_cast<size_t>(leak.Allocations);
+		bytesLeaked += leak.Bytes;
+	}
+
+	FIRE_LOG_WARNING("!! Detected %llu leaked allocations (%lld bytes) across %u callsites !!",
+		(unsigned long long)numLeaked, (long long)bytesLeaked, (unsigned)leaks.size());
+	for(const Leak& leak : leaks)
+	{
+		FIRE_LOG_WARNING("    :: [%s] %p -> %lld allocations, %lld bytes",
+			GetTagName(GetSiteTag(leak.Key)), GetSiteCallsite(leak.Key), (long long)leak.Allocations, (long long)leak.Bytes);
+	}
+	return numLeaked;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+string MemoryTracker::DumpJson()
+{
+	string json;
+	json.reserve(64 * 1024);
+
+	json.append("{\n\t\"tags\": [");
+	for(size_t i = 0; i < static_cast<size_t>(MemoryTag::Count); ++i)
+	{
+		Stats stats = GetTagStats(static_cast<MemoryTag>(i));
+		json.append_sprintf("%s\n\t\t{ \"name\": \"%s\", \"liveBytes\": %lld, \"liveAllocations\": %lld, \"peakBytes\": %lld, \"totalAllocations\": %llu }",
+			i == 0 ? "" : ",", s_tagNames[i], (long long)stats.LiveBytes, (long long)stats.LiveAllocations,
+			(long long)stats.PeakBytes, (unsigned long long)stats.TotalAllocations);
+	}
+
+	json.append("\n\t],\n\t\"sites\": [");
+	bool first = true;
+	for(TrackedSite& site : s_sites)
+	{
+		uint64_t key = site.Key.load(std::memory_order_relaxed);
+		if(key == 0)
+		{
+			continue;
+		}
+		json.append_sprintf("%s\n\t\t{ \"callsite\": \"%p\", \"tag\": \"%s\", \"liveBytes\": %lld, \"liveAllocations\": %lld, \"totalAllocations\": %llu }",
+			first ? "" : ",", GetSiteCallsite(key), GetTagName(GetSiteTag(key)),
+			(long long)site.LiveBytes.load(std::memory_order_relaxed),
+			(long long)site.LiveAllocations.load(std::memory_order_relaxed),
+			(unsigned long long)site.TotalAllocations.load(std::memory_order_relaxed));
+		first = false;
+	}
+
+	json.append("\n\t],\n\t\"threads\": [");
+	first = true;
+	for(size_t slot = 0; slot < ThreadSlot::MaxSlots; ++slot)
+	{
+		TrackedLog* log = s_logs[slot].load(std::memory_order_acquire);
+		if(log == nullptr)
+		{
+			continue;
+		}
+
+		// only events that the owner can't have started overwriting by the time we're done are written out.
+		const uint64_t headBefore = log->Head.load(std::memory_order_acquire);
+		const uint64_t begin = headBefore > LogCapacity ? headBefore - LogCapacity : 0;
+		string events;
+		for(uint64_t i = begin; i < headBefore; ++i)
+		{
+			const TrackedEvent& event = log->Events[i & (LogCapacity - 1)];
+			events.append_sprintf("%s\n\t\t\t\t{ \"index\": %llu, \"thread\": %u, \"op\": \"%s\", \"tag\": \"%s\", \"block\": \"%p\", \"size\": %llu, \"callsite\": \"%p\" }",
+				i == begin ? "" : ",", (unsigned long long)i, event.ThreadId, event.Op == kAllocate ? "alloc" : "free",
+				GetTagName(static_cast<MemoryTag>(event.Tag)), event.Block, (unsigned long long)event.Size, event.Callsite);
+		}
+		const uint64_t headAfter = log->Head.load(std::memory_order_acquire);
+		const uint64_t overwritten = headAfter > LogCapacity ? headAfter - LogCapacity : 0;
+
+		json.append_sprintf("%s\n\t\t{ \"slot\": %u, \"totalEvents\": %llu, \"overwrittenWhileDumping\": %s, \"events\": [%s\n\t\t\t] }",
+			first ? "" : ",", (unsigned)slot, (unsigned long long)headAfter, overwritten > begin ? "true" : "false", events.c_str());
+		first = false;
+	}
+	json.append_sprintf("\n\t],\n\t\"untrackedAllocations\": %llu\n}\n", (unsigned long long)GetNumUntrackedAllocations());
+	return json;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MemoryTracker::DumpJson(const char* filename)
+{
+	string json = DumpJson();
+	FILE* file = fopen(filename, "wb");
+	if(file == nullptr)
+	{
+		FIRE_LOG_ERROR("MemoryTracker couldn't open %s to dump to", filename);
+		return false;
+	}
+	bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+	fclose(file);
+	return written;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -0,0 +1,235 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MemoryTracker
+//
+//  Keeps tabs on who allocated what through libCore, so that leaks can be reported and memory use can be broken
+//  down by subsystem.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_MEMORYTRACKER_H_
+#define LIBCORE_MEMORYTRACKER_H_
+#pragma once
+
+#include "libCore.h"
+#include "Allocator.h"
+
+#ifndef FIRE_FINAL
+#define FIRE_MEMORY_TRACKING
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FIRE_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define FIRE_RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class UntrackedAllocator
+
+	Hands out memory that the MemoryTracker never sees. It's meant for things that are made once and then live for
+	as long as the process does, like interned names, log rings and metrics. Those get made for the first time
+	whenever somebody first asks for them, which is often long after the leak baseline was taken, so going through
+	libCore::Alloc would report every one of them as a leak.
+
+	It goes straight to the Allocator. It's also an EASTL allocator, so containers that live as long can use it,
+	see UntrackedVector.
+ **/
+class UntrackedAllocator
+{
+public:
+	static void* Allocate(size_t size, size_t alignment = Allocator::MinAlignment)
+	{
+		return Allocator::Allocate(size, alignment);
+	}
+
+	static void Free(void* block)
+	{
+		Allocator::Free(block);
+	}
+
+	// everything below is what EASTL expects of an allocator.
+	explicit UntrackedAllocator(const char* = nullptr) {}
+	UntrackedAllocator(const UntrackedAllocator&, const char*) {}
+
+	void* allocate(size_t n, int = 0) { return Allocate(n); }
+	void* allocate(size_t n, size_t alignment, size_t, int = 0) { return Allocate(n, alignment); }
+	void deallocate(void* p, size_t) { Free(p); }
+
+	const char* get_name() const { return "UntrackedAllocator"; }
+	void set_name(const char*) {}
+
+	bool operator==(const UntrackedAllocator&) const { return true; }
+	bool operator!=(const UntrackedAllocator&) const { return false; }
+};
+
+template<class T> using UntrackedVector = eastl::vector<T, UntrackedAllocator>;
+
+/**
+	The subsystem an allocation is charged to. Allocations pick up whatever tag is current on the thread that makes
+	them, see FIRE_MEMORY_TAG.
+ **/
+enum class MemoryTag : uint8_t
+{
+	Untagged,
+	App,
+	Core,
+	ECS,
+	IO,
+	Json,
+	Math,
+	Mirror,
+	Scene,
+	Script,
+	Serial,
+	UI,
+
+	Count
+};
+
+#ifdef FIRE_MEMORY_TRACKING
+
+/**
+	\class MemoryTracker
+
+	Sits underneath libCore::Alloc and records every allocation it sees. Each allocation is charged to a site, which
+	is the pair of the code address that asked for the memory and the thread's current MemoryTag. The site's id is
+	kept in the block header so that the free can be charged back to the same place no matter which thread or tag
+	it happens under.
+
+	- Live bytes, live allocations, peak bytes and total allocations are kept per tag and per site.
+	- Every allocation and free is also appended to a fixed size log owned by the thread that made it. The logs are
+	  lock free and single writer, and only keep the most recent LogCapacity events per thread.
+	- ReportLeaks logs every site that still has live allocations. DumpJson writes all of it out for offline
+	  analysis.
+
+	Callsites are recorded as raw code addresses. Resolve them against the symbols of the same build.
+
+	\note The tracker only exists when FIRE_MEMORY_TRACKING is defined, which is every configuration but FIRE_FINAL.
+	\note Once every site is taken new sites aren't tracked. GetNumUntrackedAllocations says how often that happened.
+ **/
+struct MemoryTracker final
+{
+	static const size_t MaxSites = 1 << 14;
+	static const size_t LogCapacity = 4096;
+
+	struct Stats
+	{
+		int64_t  LiveBytes;
+		int64_t  LiveAllocations;
+		int64_t  PeakBytes;
+		uint64_t TotalAllocations;
+	};
+
+	/**
+		Record an allocation of \c size bytes at \c block, made from \c callsite.
+	 **/
+	static void OnAllocate(void* block, size_t size, const void* callsite);
+
+	/**
+		Record that \c block is about to be freed. Blocks that weren't tracked when they were allocated are ignored.
+	 **/
+	static void OnFree(void* block);
+
+	/**
+		Turn tracking on or off at runtime. It's on by default.
+	 **/
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+
+	/**
+		Set the tag that allocations made on the calling thread are charged to, returning the previous one.
+	 **/
+	static MemoryTag SetCurrentTag(MemoryTag tag);
+	static MemoryTag GetCurrentTag();
+
+	static const char* GetTagName(MemoryTag tag);
+
+	/**
+		Retrieve the counters for everything charged to \c tag.
+	 **/
+	static Stats GetTagStats(MemoryTag tag);
+
+	/**
+		Retrieve the number of allocations that couldn't be given a site.
+	 **/
+	static size_t GetNumUntrackedAllocations();
+
+	/**
+		Remember how many allocations every site currently has live. ReportLeaks only reports what was allocated on
+		top of that, so anything that was allocated at start up and is meant to live forever doesn't show up.
+	 **/
+	static void MarkBaseline();
+
+	/**
+		The baseline of every site, as taken by GetBaseline.
+	 **/
+	struct Baseline
+	{
+		vector<int64_t> Bytes;
+		vector<int64_t> Allocations;
+	};
+
+	/**
+		Retrieve a copy of the current baseline, so that code that needs to move it for a while (like a test) can
+		put it back afterwards with RestoreBaseline.
+	 **/
+	static Baseline GetBaseline();
+	static void RestoreBaseline(const Baseline& baseline);
+
+	/**
+		Log every site that has more allocations live than it did at the baseline.
+
+		\return The number of leaked allocations.
+	 **/
+	static size_t ReportLeaks();
+
+	/**
+		Write the per tag counters, the per site counters and the per thread logs out as JSON.
+	 **/
+	static string DumpJson();
+	static bool DumpJson(const char* filename);
+};
+
+/**
+	\class MemoryTagScope
+
+	Charges every allocation the thread makes to \c tag until the scope ends.
+ **/
+class MemoryTagScope final
+{
+public:
+	explicit MemoryTagScope(MemoryTag tag)
+	: _previous(MemoryTracker::SetCurrentTag(tag))
+	{
+	}
+
+	~MemoryTagScope()
+	{
+		MemoryTracker::SetCurrentTag(_previous);
+	}
+
+private:
+	MemoryTagScope(const MemoryTagScope&) = delete;
+	MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+	MemoryTag _previous;
+};
+
+#define _FIRE_MEMORY_TAG_NAME2(LINE) _fireMemoryTag##LINE
+#define _FIRE_MEMORY_TAG_NAME(LINE) _FIRE_MEMORY_TAG_NAME2(LINE)
+#define FIRE_MEMORY_TAG(TAG) ::Firestorm::MemoryTagScope _FIRE_MEMORY_TAG_NAME(__LINE__)(::Firestorm::MemoryTag::TAG)
+
+#else
+
+#define FIRE_MEMORY_TAG(TAG)
+
+#endif
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
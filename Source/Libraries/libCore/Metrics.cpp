@@ -0,0 +1,636 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Metrics
+//
+//  Named counters, gauges and latency histograms that can be read out while the app is running.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "Metrics.h"
+#include "Assert.h"
+#include "MemoryTracker.h"
+
+#include <cstring>
+#include <mutex>
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// padded out so that two threads' shards never share a cache line, wherever they're allocated.
+struct MetricCounter::Shard
+{
+	atomic<uint64_t> Value;
+	char             Pad[120];
+};
+
+struct MetricHistogram::Shard
+{
+	atomic<uint64_t> Count;
+	atomic<uint64_t> Sum;
+	atomic<uint64_t> Min;
+	atomic<uint64_t> Max;
+	atomic<uint64_t> Buckets[MetricHistogram::NumBuckets];
+};
+
+// the last periodic snapshot. It's kept apart from MetricsSnapshot so that its lists can be untracked as well.
+struct StoredSnapshot
+{
+	uint64_t                                         Time{ 0 };
+	double                                           Interval{ 0 };
+	UntrackedVector<MetricsSnapshot::CounterValue>   Counters;
+	UntrackedVector<MetricsSnapshot::GaugeValue>     Gauges;
+	UntrackedVector<MetricsSnapshot::HistogramValue> Histograms;
+};
+
+// the metrics, their shards and the registry all live for as long as the process does.
+
+struct MetricsRegistry
+{
+	std::mutex                        Lock;
+	UntrackedVector<MetricCounter*>     Counters;
+	UntrackedVector<MetricGauge*>       Gauges;
+	UntrackedVector<MetricHistogram*>   Histograms;
+	UntrackedVector<uint64_t>           LastCounterValues;  // the counters at the last periodic snapshot.
+	uint64_t                            LastSnapshotTime{ 0 };
+	double                              SnapshotInterval{ 1.0 };
+	StoredSnapshot                      LastSnapshot;
+	UntrackedVector<Metrics::Listener>  Listeners;
+};
+
+static atomic<uint64_t> s_nextSnapshotTime{ 0 };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// metrics are looked up from static initializers all over, so the registry has to be made on first use.
+static MetricsRegistry& GetRegistry()
+{
+	static MetricsRegistry registry;
+	return registry;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t GetShardIndex()
+{
+	const size_t slot = ThreadSlot::Get();
+	return slot == ThreadSlot::Invalid ? MetricsDetail::NumShards - 1 : slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// makes the shard at index if nobody has yet. the last shard is shared, so two threads can race to make it.
+template<class Shard_t, class Init_f>
+static Shard_t& GetOrMakeShard(atomic<Shard_t*>* shards, Init_f init)
+{
+	atomic<Shard_t*>& slot = shards[GetShardIndex()];
+	Shard_t* shard = slot.load(std::memory_order_acquire);
+	if(shard == nullptr)
+	{
+		Shard_t* made = static_cast<Shard_t*>(UntrackedAllocator::Allocate(sizeof(Shard_t)));
+		FIRE_ASSERT_MSG(made != nullptr, "failed to allocate a metrics shard");
+		memset(made, 0, sizeof(Shard_t));
+		init(*made);
+		if(slot.compare_exchange_strong(shard, made, std::memory_order_acq_rel))
+		{
+			shard = made;
+		}
+		else
+		{
+			UntrackedAllocator::Free(made);
+		}
+	}
+	return *shard;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void StoreMin(atomic<uint64_t>& min, uint64_t value)
+{
+	uint64_t current = min.load(std::memory_order_relaxed);
+	while(value < current && !min.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void StoreMax(atomic<uint64_t>& max, uint64_t value)
+{
+	uint64_t current = max.load(std::memory_order_relaxed);
+	while(value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t ToBits(double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline double FromBits(uint64_t bits)
+{
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void AppendJsonString(string& out, const char* value)
+{
+	out.push_back('"');
+	for(const char* c = value; *c; ++c)
+	{
+		if(*c == '"' || *c == '\\')
+		{
+			out.push_back('\\');
+		}
+		out.push_back(*c);
+	}
+	out.push_back('"');
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricCounter::MetricCounter(const char* name)
+: _name(name)
+{
+	for(atomic<Shard*>& shard : _shards)
+	{
+		shard.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricCounter::Shard& MetricCounter::GetShard()
+{
+	return GetOrMakeShard(_shards, [](Shard&) {});
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MetricCounter::Add(uint64_t amount)
+{
+	GetShard().Value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t MetricCounter::GetValue() const
+{
+	uint64_t value = 0;
+	for(const atomic<Shard*>& shard : _shards)
+	{
+		const Shard* s = shard.load(std::memory_order_acquire);
+		value += s ? s->Value.load(std::memory_order_relaxed) : 0;
+	}
+	return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricGauge::MetricGauge(const char* name)
+: _name(name)
+, _bits(ToBits(0.0))
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MetricGauge::Set(double value)
+{
+	_bits.store(ToBits(value), std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MetricGauge::Add(double amount)
+{
+	uint64_t current = _bits.load(std::memory_order_relaxed);
+	while(!_bits.compare_exchange_weak(current, ToBits(FromBits(current) + amount), std::memory_order_relaxed))
+	{
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double MetricGauge::GetValue() const
+{
+	return FromBits(_bits.load(std::memory_order_relaxed));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricHistogram::MetricHistogram(const char* name)
+: _name(name)
+{
+	for(atomic<Shard*>& shard : _shards)
+	{
+		shard.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricHistogram::Shard& MetricHistogram::GetShard()
+{
+	return GetOrMakeShard(_shards, [](Shard& shard) {
+		shard.Min.store(eastl::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MetricHistogram::Record(uint64_t value)
+{
+	Shard& shard = GetShard();
+	shard.Buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	shard.Count.fetch_add(1, std::memory_order_relaxed);
+	shard.Sum.fetch_add(value, std::memory_order_relaxed);
+	StoreMin(shard.Min, value);
+	StoreMax(shard.Max, value);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vector<uint64_t> MetricHistogram::GetBuckets() const
+{
+	vector<uint64_t> buckets(NumBuckets, 0);
+	for(const atomic<Shard*>& shard : _shards)
+	{
+		const Shard* s = shard.load(std::memory_order_acquire);
+		for(size_t i = 0; s && i < NumBuckets; ++i)
+		{
+			buckets[i] += s->Buckets[i].load(std::memory_order_relaxed);
+		}
+	}
+	return buckets;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+HistogramSummary MetricHistogram::GetSummary() const
+{
+	HistogramSummary summary{ 0, 0, eastl::numeric_limits<uint64_t>::max(), 0, 0.0, 0, 0, 0, 0 };
+	for(const atomic<Shard*>& shard : _shards)
+	{
+		const Shard* s = shard.load(std::memory_order_acquire);
+		if(s)
+		{
+			summary.Sum += s->Sum.load(std::memory_order_relaxed);
+			summary.Min = eastl::min(summary.Min, s->Min.load(std::memory_order_relaxed));
+			summary.Max = eastl::max(summary.Max, s->Max.load(std::memory_order_relaxed));
+		}
+	}
+
+	// the count comes from the buckets so that the percentiles add up even while other threads are recording.
+	const vector<uint64_t> buckets = GetBuckets();
+	for(uint64_t count : buckets)
+	{
+		summary.Count += count;
+	}
+	if(summary.Count == 0)
+	{
+		summary.Min = 0;
+		return summary;
+	}
+	summary.Mean = static_cast<double>(summary.Sum) / static_cast<double>(summary.Count);
+
+	uint64_t* percentiles[] = { &summary.P50, &summary.P90, &summary.P99, &summary.P999 };
+	const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	size_t next = 0;
+	uint64_t seen = 0;
+	for(size_t i = 0; i < NumBuckets && next < 4; ++i)
+	{
+		seen += buckets[i];
+		while(next < 4 && seen >= static_cast<uint64_t>(quantiles[next] * summary.Count + 0.5) && seen > 0)
+		{
+			*percentiles[next++] = eastl::min(GetBucketUpperBound(i), summary.Max);
+		}
+	}
+	return summary;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricTimer::MetricTimer(MetricHistogram& histogram)
+: _histogram(histogram)
+, _start(Metrics::GetTime())
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricTimer::~MetricTimer()
+{
+	_histogram.Record(Metrics::GetTime() - _start);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+string MetricsSnapshot::ToText() const
+{
+	string text;
+	text.append_sprintf("Metrics (%.2fs interval)\n", Interval);
+	for(const CounterValue& counter : Counters)
+	{
+		text.append_sprintf("  counter   %-40s %14llu  %12.2f/s\n", counter.Name, (unsigned long long)counter.Value, counter.Rate);
+	}
+	for(const GaugeValue& gauge : Gauges)
+	{
+		text.append_sprintf("  gauge     %-40s %14.3f\n", gauge.Name, gauge.Value);
+	}
+	for(const HistogramValue& histogram : Histograms)
+	{
+		const HistogramSummary& s = histogram.Summary;
+		text.append_sprintf("  histogram %-40s %14llu  min %llu  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu  mean %.1f\n",
+			histogram.Name, (unsigned long long)s.Count, (unsigned long long)s.Min, (unsigned long long)s.P50,
+			(unsigned long long)s.P90, (unsigned long long)s.P99, (unsigned long long)s.P999, (unsigned long long)s.Max, s.Mean);
+	}
+	return text;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+string MetricsSnapshot::ToJson() const
+{
+	string json;
+	json.append_sprintf("{\n\t\"time\": %llu,\n\t\"interval\": %.6f,\n\t\"counters\": {", (unsigned long long)Time, Interval);
+	for(size_t i = 0; i < Counters.size(); ++i)
+	{
+		json.append(i == 0 ? "\n\t\t" : ",\n\t\t");
+		AppendJsonString(json, Counters[i].Name);
+		json.append_sprintf(": { \"value\": %llu, \"rate\": %.6f }", (unsigned long long)Counters[i].Value, Counters[i].Rate);
+	}
+	json.append("\n\t},\n\t\"gauges\": {");
+	for(size_t i = 0; i < Gauges.size(); ++i)
+	{
+		json.append(i == 0 ? "\n\t\t" : ",\n\t\t");
+		AppendJsonString(json, Gauges[i].Name);
+		json.append_sprintf(": %.6f", Gauges[i].Value);
+	}
+	json.append("\n\t},\n\t\"histograms\": {");
+	for(size_t i = 0; i < Histograms.size(); ++i)
+	{
+		const HistogramSummary& s = Histograms[i].Summary;
+		json.append(i == 0 ? "\n\t\t" : ",\n\t\t");
+		AppendJsonString(json, Histograms[i].Name);
+		json.append_sprintf(": { \"count\": %llu, \"sum\": %llu, \"min\": %llu, \"max\": %llu, \"mean\": %.3f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu }",
+			(unsigned long long)s.Count, (unsigned long long)s.Sum, (unsigned long long)s.Min, (unsigned long long)s.Max, s.Mean,
+			(unsigned long long)s.P50, (unsigned long long)s.P90, (unsigned long long)s.P99, (unsigned long long)s.P999);
+	}
+	json.append("\n\t}\n}\n");
+	return json;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// every name is unique across all three kinds of metric. the registry lock has to be held.
+static bool IsNameTaken(MetricsRegistry& registry, const char* name)
+{
+	auto matches = [name](auto* metric) { return strcmp(metric->GetName(), name) == 0; };
+	return eastl::any_of(registry.Counters.begin(), registry.Counters.end(), matches)
+		|| eastl::any_of(registry.Gauges.begin(), registry.Gauges.end(), matches)
+		|| eastl::any_of(registry.Histograms.begin(), registry.Histograms.end(), matches);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// metrics can only be made by Metrics, so it hands in how to make one in the memory it's given.
+template<class Metric_t, class Make_f>
+static Metric_t& FindOrAdd(MetricsRegistry& registry, UntrackedVector<Metric_t*>& metrics, const char* name, Make_f make)
+{
+	FIRE_ASSERT_MSG(name != nullptr, "metrics need a name");
+	for(Metric_t* metric : metrics)
+	{
+		if(strcmp(metric->GetName(), name) == 0)
+		{
+			return *metric;
+		}
+	}
+	FIRE_ASSERT_MSG(!IsNameTaken(registry, name), "a metric with this name already exists as a different kind of metric");
+	void* memory = UntrackedAllocator::Allocate(sizeof(Metric_t));
+	FIRE_ASSERT_MSG(memory != nullptr, "failed to allocate a metric");
+	metrics.push_back(make(memory, name));
+	return *metrics.back();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricCounter& Metrics::GetCounter(const char* name)
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	return FindOrAdd(registry, registry.Counters, name, [](void* memory, const char* n) { return new(memory) MetricCounter(n); });
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricGauge& Metrics::GetGauge(const char* name)
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	return FindOrAdd(registry, registry.Gauges, name, [](void* memory, const char* n) { return new(memory) MetricGauge(n); });
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricHistogram& Metrics::GetHistogram(const char* name)
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	return FindOrAdd(registry, registry.Histograms, name, [](void* memory, const char* n) { return new(memory) MetricHistogram(n); });
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// the registry lock has to be held.
+static MetricsSnapshot BuildSnapshot(MetricsRegistry& registry, uint64_t now)
+{
+	MetricsSnapshot snapshot;
+	snapshot.Time = now;
+	snapshot.Interval = registry.LastSnapshotTime != 0 ? (now - registry.LastSnapshotTime) / 1e9 : 0.0;
+
+	// counters made since the last periodic snapshot started out at 0 after it.
+	registry.LastCounterValues.resize(registry.Counters.size(), 0);
+	snapshot.Counters.reserve(registry.Counters.size());
+	for(size_t i = 0; i < registry.Counters.size(); ++i)
+	{
+		const uint64_t value = registry.Counters[i]->GetValue();
+		const uint64_t last = eastl::min(value, registry.LastCounterValues[i]);
+		const double rate = snapshot.Interval > 0.0 ? (value - last) / snapshot.Interval : 0.0;
+		snapshot.Counters.push_back(MetricsSnapshot::CounterValue{ registry.Counters[i]->GetName(), value, rate });
+	}
+
+	snapshot.Gauges.reserve(registry.Gauges.size());
+	for(MetricGauge* gauge : registry.Gauges)
+	{
+		snapshot.Gauges.push_back(MetricsSnapshot::GaugeValue{ gauge->GetName(), gauge->GetValue() });
+	}
+
+	snapshot.Histograms.reserve(registry.Histograms.size());
+	for(MetricHistogram* histogram : registry.Histograms)
+	{
+		snapshot.Histograms.push_back(MetricsSnapshot::HistogramValue{ histogram->GetName(), histogram->GetSummary() });
+	}
+	return snapshot;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricsSnapshot Metrics::TakeSnapshot()
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	return BuildSnapshot(registry, GetTime());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Metrics::Update()
+{
+	// checked without the lock, since this runs every frame and almost never has anything to do.
+	const uint64_t now = GetTime();
+	const uint64_t next = s_nextSnapshotTime.load(std::memory_order_relaxed);
+	if(next == eastl::numeric_limits<uint64_t>::max() || now < next)
+	{
+		return false;
+	}
+
+	MetricsRegistry& registry = GetRegistry();
+	vector<Listener> listeners;
+	MetricsSnapshot snapshot;
+	{
+		std::scoped_lock lock(registry.Lock);
+		if(registry.SnapshotInterval <= 0.0 || now < s_nextSnapshotTime.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+		snapshot = BuildSnapshot(registry, now);
+		for(size_t i = 0; i < snapshot.Counters.size(); ++i)
+		{
+			registry.LastCounterValues[i] = snapshot.Counters[i].Value;
+		}
+		registry.LastSnapshotTime = now;
+		registry.LastSnapshot.Time = snapshot.Time;
+		registry.LastSnapshot.Interval = snapshot.Interval;
+		registry.LastSnapshot.Counters.assign(snapshot.Counters.begin(), snapshot.Counters.end());
+		registry.LastSnapshot.Gauges.assign(snapshot.Gauges.begin(), snapshot.Gauges.end());
+		registry.LastSnapshot.Histograms.assign(snapshot.Histograms.begin(), snapshot.Histograms.end());
+		s_nextSnapshotTime.store(now + static_cast<uint64_t>(registry.SnapshotInterval * 1e9), std::memory_order_relaxed);
+		listeners.assign(registry.Listeners.begin(), registry.Listeners.end());
+	}
+
+	// called without the lock so that listeners can look metrics up themselves.
+	for(const Listener& listener : listeners)
+	{
+		listener(snapshot);
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Metrics::SetSnapshotInterval(double seconds)
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	registry.SnapshotInterval = seconds;
+	if(seconds <= 0.0)
+	{
+		s_nextSnapshotTime.store(eastl::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+	}
+	else
+	{
+		const uint64_t from = registry.LastSnapshotTime != 0 ? registry.LastSnapshotTime : GetTime();
+		s_nextSnapshotTime.store(from + static_cast<uint64_t>(seconds * 1e9), std::memory_order_relaxed);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MetricsSnapshot Metrics::GetLastSnapshot()
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	const StoredSnapshot& last = registry.LastSnapshot;
+	MetricsSnapshot snapshot;
+	snapshot.Time = last.Time;
+	snapshot.Interval = last.Interval;
+	snapshot.Counters.assign(last.Counters.begin(), last.Counters.end());
+	snapshot.Gauges.assign(last.Gauges.begin(), last.Gauges.end());
+	snapshot.Histograms.assign(last.Histograms.begin(), last.Histograms.end());
+	return snapshot;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Metrics::AddListener(const Listener& listener)
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	registry.Listeners.push_back(listener);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Metrics::ClearListeners()
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	registry.Listeners.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Metrics::Reset()
+{
+	MetricsRegistry& registry = GetRegistry();
+	std::scoped_lock lock(registry.Lock);
+	for(MetricCounter* counter : registry.Counters)
+	{
+		for(atomic<MetricCounter::Shard*>& shard : counter->_shards)
+		{
+			MetricCounter::Shard* s = shard.load(std::memory_order_acquire);
+			if(s)
+			{
+				s->Value.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+	for(MetricGauge* gauge : registry.Gauges)
+	{
+		gauge->Set(0.0);
+	}
+	for(MetricHistogram* histogram : registry.Histograms)
+	{
+		for(atomic<MetricHistogram::Shard*>& shard : histogram->_shards)
+		{
+			MetricHistogram::Shard* s = shard.load(std::memory_order_acquire);
+			if(s)
+			{
+				s->Count.store(0, std::memory_order_relaxed);
+				s->Sum.store(0, std::memory_order_relaxed);
+				s->Min.store(eastl::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+				s->Max.store(0, std::memory_order_relaxed);
+				for(atomic<uint64_t>& bucket : s->Buckets)
+				{
+					bucket.store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+	eastl::fill(registry.LastCounterValues.begin(), registry.LastCounterValues.end(), uint64_t(0));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
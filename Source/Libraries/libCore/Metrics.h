@@ -0,0 +1,293 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Metrics
+//
+//  Named counters, gauges and latency histograms that can be read out while the app is running.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_METRICS_H_
+#define LIBCORE_METRICS_H_
+#pragma once
+
+#include "libCore.h"
+#include "ThreadSlot.h"
+
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+namespace MetricsDetail
+{
+	// one shard per ThreadSlot, plus one that's shared by threads that didn't get a slot.
+	static const size_t NumShards = ThreadSlot::MaxSlots + 1;
+}
+
+/**
+	\class MetricCounter
+
+	A count that only goes up, like the number of resources loaded. Every thread adds to its own shard, and the
+	shards are summed when the counter is read.
+ **/
+class MetricCounter final
+{
+public:
+	void Add(uint64_t amount = 1);
+
+	uint64_t GetValue() const;
+	const char* GetName() const { return _name; }
+
+private:
+	friend struct Metrics;
+	struct Shard;
+
+	explicit MetricCounter(const char* name);
+
+	Shard& GetShard();
+
+	const char*    _name;
+	atomic<Shard*> _shards[MetricsDetail::NumShards];
+};
+
+/**
+	\class MetricGauge
+
+	A value that's set to whatever it currently is, like the frame time or the number of live entities. Last
+	write wins, so a gauge is a single value rather than being sharded.
+ **/
+class MetricGauge final
+{
+public:
+	void Set(double value);
+	void Add(double amount);
+
+	double GetValue() const;
+	const char* GetName() const { return _name; }
+
+private:
+	friend struct Metrics;
+
+	explicit MetricGauge(const char* name);
+
+	const char*      _name;
+	atomic<uint64_t> _bits{ 0 };
+};
+
+/**
+	What a MetricHistogram looked like when it was read. Percentiles are the highest value that falls in the same
+	bucket as the percentile, so they're never under reported.
+ **/
+struct HistogramSummary
+{
+	uint64_t Count;
+	uint64_t Sum;
+	uint64_t Min;
+	uint64_t Max;
+	double   Mean;
+	uint64_t P50;
+	uint64_t P90;
+	uint64_t P99;
+	uint64_t P999;
+};
+
+/**
+	\class MetricHistogram
+
+	An HDR style histogram of 64 bit values, usually latencies in nanoseconds. Values are put in log-linear buckets:
+	NumSubBuckets buckets per power of two, which keeps every bucket within about 6% of the values in it across
+	the whole 64 bit range, and makes recording a shift, a mask and an add.
+
+	Every thread records into its own shard, which is allocated the first time the thread records anything. The
+	shards are merged when the histogram is read.
+ **/
+class MetricHistogram final
+{
+public:
+	static const size_t SubBucketBits = 4;
+	static const size_t NumSubBuckets = 1 << SubBucketBits;
+	static const size_t NumBuckets = (64 - SubBucketBits + 1) * NumSubBuckets;
+
+	void Record(uint64_t value);
+
+	HistogramSummary GetSummary() const;
+
+	/**
+		Retrieve the number of values in each bucket, merged across the threads.
+	 **/
+	vector<uint64_t> GetBuckets() const;
+
+	const char* GetName() const { return _name; }
+
+	static size_t GetBucketIndex(uint64_t value)
+	{
+		if(value < NumSubBuckets)
+		{
+			return static_cast<size_t>(value);
+		}
+		const size_t shift = GetHighestBit(value) - SubBucketBits;
+		return (shift + 1) * NumSubBuckets + static_cast<size_t>((value >> shift) & (NumSubBuckets - 1));
+	}
+
+	/**
+		Retrieve the smallest and largest values that land in the bucket at \c index.
+	 **/
+	static uint64_t GetBucketLowerBound(size_t index)
+	{
+		if(index < NumSubBuckets)
+		{
+			return index;
+		}
+		const size_t shift = index / NumSubBuckets - 1;
+		return (static_cast<uint64_t>(NumSubBuckets + index % NumSubBuckets)) << shift;
+	}
+
+	static uint64_t GetBucketUpperBound(size_t index)
+	{
+		if(index < NumSubBuckets)
+		{
+			return index;
+		}
+		const size_t shift = index / NumSubBuckets - 1;
+		return GetBucketLowerBound(index) + ((uint64_t(1) << shift) - 1);
+	}
+
+private:
+	friend struct Metrics;
+	struct Shard;
+
+	explicit MetricHistogram(const char* name);
+
+	Shard& GetShard();
+
+	static size_t GetHighestBit(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - __builtin_clzll(value);
+#endif
+	}
+
+	const char*    _name;
+	atomic<Shard*> _shards[MetricsDetail::NumShards];
+};
+
+/**
+	\class MetricTimer
+
+	Records how long the scope it lives in took, in nanoseconds.
+ **/
+class MetricTimer final
+{
+public:
+	explicit MetricTimer(MetricHistogram& histogram);
+	~MetricTimer();
+
+private:
+	MetricTimer(const MetricTimer&) = delete;
+	MetricTimer& operator=(const MetricTimer&) = delete;
+
+	MetricHistogram& _histogram;
+	uint64_t         _start;
+};
+
+/**
+	Every metric, read out at once.
+ **/
+struct MetricsSnapshot
+{
+	struct CounterValue
+	{
+		const char* Name;
+		uint64_t    Value;
+		double      Rate;   // per second, since the last periodic snapshot. 0 until there's been one.
+	};
+
+	struct GaugeValue
+	{
+		const char* Name;
+		double      Value;
+	};
+
+	struct HistogramValue
+	{
+		const char*      Name;
+		HistogramSummary Summary;
+	};
+
+	uint64_t               Time{ 0 };      // steady clock nanoseconds.
+	double                 Interval{ 0 };  // seconds since the last periodic snapshot.
+	vector<CounterValue>   Counters;
+	vector<GaugeValue>     Gauges;
+	vector<HistogramValue> Histograms;
+
+	string ToText() const;
+	string ToJson() const;
+};
+
+/**
+	\class Metrics
+
+	The registry every metric lives in. Metrics are looked up by name and live until the process exits, so look
+	them up once and hang on to the reference:
+
+		static MetricCounter& loads = Metrics::GetCounter("io.loads");
+		loads.Add();
+
+	Call Update once a frame and a snapshot is taken every snapshot interval and handed to every listener, which
+	is where it can be logged or shipped off. TakeSnapshot reads everything out on demand.
+
+	\warning Names aren't copied. Use string literals.
+ **/
+struct Metrics final
+{
+	using Listener = function<void(const MetricsSnapshot&)>;
+
+	static MetricCounter& GetCounter(const char* name);
+	static MetricGauge& GetGauge(const char* name);
+	static MetricHistogram& GetHistogram(const char* name);
+
+	static uint64_t GetTime()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/**
+		Read every metric out now. Counter rates are measured against the last periodic snapshot.
+	 **/
+	static MetricsSnapshot TakeSnapshot();
+
+	/**
+		Take a periodic snapshot if the snapshot interval has gone by since the last one.
+
+		\return true if a snapshot was taken.
+	 **/
+	static bool Update();
+
+	/**
+		Set how many seconds go by between periodic snapshots. 0 turns them off. Defaults to 1.
+	 **/
+	static void SetSnapshotInterval(double seconds);
+
+	static MetricsSnapshot GetLastSnapshot();
+
+	static void AddListener(const Listener& listener);
+	static void ClearListeners();
+
+	/**
+		Zero every counter, gauge and histogram.
+	 **/
+	static void Reset();
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -11,9 +11,13 @@
 #define LIBCORE_OBJECTPOOL_H_
 #pragma once
 
+#include "libCore.h"
 #include "Assert.h"
+#include "BatchStack.h"
+#include "Logger.h"
+#include "ThreadSlot.h"
+#include "InstrumentedMutex.h"
 #include <mutex>
-#include <forward_list>
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -23,7 +27,7 @@ template<class T>
 class PoolPtr final
 {
 public:
-	PoolPtr(T* ptr, ObjectPool<T>& pool);
+	PoolPtr(T* ptr, const ObjectPool<T>& pool);
 	PoolPtr(PoolPtr&& other);
 
 	~PoolPtr();
@@ -63,13 +67,31 @@ private:
 	PoolPtr& operator=(PoolPtr&& other) = delete;
 
 	T* _ptr{ nullptr };
-	ObjectPool<T>& _pool;
+	const ObjectPool<T>& _pool;
 };
 
+/**
+	\class ObjectPool
+
+	Hands out storage for objects of type T out of 64 KiB slabs, so objects that are churned through together
+	also sit next to each other in memory.
+
+	Freed objects go onto a free list that belongs to the thread that freed them (see ThreadSlot), so a Get/Return
+	pair on the same thread never touches shared state other than the statistics. When a thread's list grows past
+	a couple of batches, a batch is spilled onto a global lock free list where any other thread can pick it up.
+	Fresh slabs are only allocated when both are empty, and slabs are only handed back when the pool is destroyed.
+
+	\warning Objects that are still live when the pool is destroyed are not destructed.
+ **/
 template <class T>
 class ObjectPool final
 {
 public:
+	static const size_t SlabSize = 64 * 1024;
+
+	ObjectPool() = default;
+	~ObjectPool();
+
 	template<class... Args_t>
 	T* Get(Args_t&&... args) const;
 
@@ -77,17 +99,78 @@ public:
 	PoolPtr<T> GetManaged(Args_t&&... args) const;
 
 	template<class U>
-	void Return(U* ptr);
+	void Return(U* ptr) const;
+
+	/**
+		Retrieve the number of objects that have been handed out and not yet returned.
+	 **/
+	size_t GetNumLive() const { return _numLive.load(std::memory_order_relaxed); }
+
+	/**
+		Retrieve the highest number of objects that were ever live at the same time.
+	 **/
+	size_t GetHighWaterMark() const { return _highWaterMark.load(std::memory_order_relaxed); }
+
+	/**
+		Retrieve the number of slabs the pool has allocated.
+	 **/
+	size_t GetNumSlabs() const { return _numSlabs.load(std::memory_order_relaxed); }
+
+	/**
+		Retrieve the number of objects that fit in a single slab.
+	 **/
+	static constexpr size_t GetNumObjectsPerSlab() { return SlotsPerSlab; }
 
 private:
-	mutable std::mutex _poolLock;
-	mutable std::forward_list<T> _pool;
-	mutable std::mutex _recycleLock;
-	mutable vector<T*> _recycle;
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	// lives in the storage of a slot while it's free.
+	using FreeNode = BatchNode;
+
+	struct Slab
+	{
+		Slab* Next;
+	};
+
+	struct alignas(64) Cache
+	{
+		FreeNode* Head{ nullptr };
+		size_t Count{ 0 };
+	};
+
+	static constexpr size_t RoundUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+	static constexpr size_t SlotAlign = alignof(T) > alignof(FreeNode) ? alignof(T) : alignof(FreeNode);
+	static constexpr size_t SlotSize = RoundUp(sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode), SlotAlign);
+	static constexpr size_t SlabHeaderSize = RoundUp(sizeof(Slab), SlotAlign);
+	static constexpr size_t MinSlotsPerSlab = 8;
+	static constexpr size_t SlotsPerSlab = (SlabSize - SlabHeaderSize) / SlotSize > MinSlotsPerSlab ?
+		(SlabSize - SlabHeaderSize) / SlotSize : MinSlotsPerSlab;
+	static constexpr size_t SlabBytes = SlabHeaderSize + SlotsPerSlab * SlotSize;
+	static const size_t BatchSize = 32;
+
+	FreeNode* Allocate() const;
+	void Deallocate(FreeNode* node) const;
+	FreeNode* AllocateSlab(size_t& count) const;
+
+	void TrackGet() const;
+
+	mutable Cache _caches[ThreadSlot::MaxSlots];
+
+	// slabs are never freed while the pool is alive, which is what makes popping from it safe.
+	mutable BatchStack _globalFree;
+
+	mutable FIRE_MUTEX(_slabLock, "ObjectPool::_slabLock");
+	mutable Slab* _slabs{ nullptr };
+
+	mutable atomic<size_t> _numSlabs{ 0 };
+	mutable atomic<size_t> _numLive{ 0 };
+	mutable atomic<size_t> _highWaterMark{ 0 };
 };
 
 template<class T>
-PoolPtr<T>::PoolPtr(T* ptr, ObjectPool<T>& pool)
+PoolPtr<T>::PoolPtr(T* ptr, const ObjectPool<T>& pool)
 : _ptr(ptr)
 , _pool(pool)
 {
@@ -133,21 +216,39 @@ bool PoolPtr<T>::IsValid() const
 	return _ptr != nullptr;
 }
 
+template<class T>
+ObjectPool<T>::~ObjectPool()
+{
+	if(_numLive.load() != 0)
+	{
+		FIRE_LOG_WARNING("ObjectPool destroyed with %d objects still live", _numLive.load());
+	}
+
+	Slab* slab = _slabs;
+	while(slab)
+	{
+		Slab* next = slab->Next;
+		libCore::Free(slab);
+		slab = next;
+	}
+}
+
 template<class T>
 template<class... Args_t>
 T* ObjectPool<T>::Get(Args_t&&... args) const
 {
-	std::unique_lock<mutex> recycleLock(_recycleLock);
-	if(_recycle.empty())
+	FreeNode* node = Allocate();
+	T* item;
+	try
+	{
+		item = new (node) T(std::forward<Args_t>(args)...);
+	}
+	catch(...)
 	{
-		std::unique_lock<mutex> poolLock(_poolLock);
-		T& item = _pool.emplace_front(std::forward<Args_t>(args)...);
-		return &item;
+		Deallocate(node);
+		throw;
 	}
-	auto item = _recycle.back();
-	_recycle.pop_back();
-	recycleLock.unlock();
-	new (item) T(std::forward<Args_t>(args)...);
+	TrackGet();
 	return item;
 }
 
@@ -155,12 +256,12 @@ template<class T>
 template<class... Args_t>
 PoolPtr<T> ObjectPool<T>::GetManaged(Args_t&&... args) const
 {
-	return PoolPtr<T>{ Get(args), *this };
+	return PoolPtr<T>{ Get(std::forward<Args_t>(args)...), *this };
 }
 
 template<class T>
 template<class U>
-void ObjectPool<T>::Return(U* ptr)
+void ObjectPool<T>::Return(U* ptr) const
 {
 	static_assert(
 		std::is_same<T, U>::value ||
@@ -172,8 +273,124 @@ void ObjectPool<T>::Return(U* ptr)
 	T* ptrT = static_cast<T*>(ptr);
 	ptrT->~T();
 
-	std::unique_lock<mutex> lock(_recycleLock);
-	_recycle.push_back(ptrT);
+	_numLive.fetch_sub(1, std::memory_order_relaxed);
+	Deallocate(reinterpret_cast<FreeNode*>(ptrT));
+}
+
+template<class T>
+typename ObjectPool<T>::FreeNode* ObjectPool<T>::Allocate() const
+{
+	size_t slot = ThreadSlot::Get();
+	if(slot == ThreadSlot::Invalid)
+	{
+		// no cache for this thread. grab a batch, keep one and put the rest straight back.
+		size_t count = 0;
+		FreeNode* node = _globalFree.Pop(count);
+		if(node == nullptr)
+		{
+			node = AllocateSlab(count);
+		}
+		if(count > 1)
+		{
+			_globalFree.Push(node->Next, count - 1);
+		}
+		return node;
+	}
+
+	Cache& cache = _caches[slot];
+	if(cache.Head == nullptr)
+	{
+		cache.Head = _globalFree.Pop(cache.Count);
+		if(cache.Head == nullptr)
+		{
+			cache.Head = AllocateSlab(cache.Count);
+		}
+	}
+	FreeNode* node = cache.Head;
+	cache.Head = node->Next;
+	--cache.Count;
+	return node;
+}
+
+template<class T>
+void ObjectPool<T>::Deallocate(FreeNode* node) const
+{
+	size_t slot = ThreadSlot::Get();
+	if(slot == ThreadSlot::Invalid)
+	{
+		node->Next = nullptr;
+		_globalFree.Push(node, 1);
+		return;
+	}
+
+	Cache& cache = _caches[slot];
+	node->Next = cache.Head;
+	cache.Head = node;
+	++cache.Count;
+
+	if(cache.Count >= BatchSize * 2)
+	{
+		// spill a batch so the other threads can have at it.
+		FreeNode* first = cache.Head;
+		FreeNode* last = first;
+		for(size_t i = 1; i < BatchSize; ++i)
+		{
+			last = last->Next;
+		}
+		cache.Head = last->Next;
+		cache.Count -= BatchSize;
+		last->Next = nullptr;
+		_globalFree.Push(first, BatchSize);
+	}
+}
+
+template<class T>
+typename ObjectPool<T>::FreeNode* ObjectPool<T>::AllocateSlab(size_t& count) const
+{
+	Slab* slab = static_cast<Slab*>(libCore::AlignedAlloc(SlabBytes, SlotAlign > 64 ? SlotAlign : 64));
+	FIRE_ASSERT_MSG(slab != nullptr, "ObjectPool failed to allocate a slab");
+	FIRE_ASSERT_MSG(BatchStack::CanHold(slab), "slab address doesn't leave room for the ABA tag");
+
+	{
+		std::scoped_lock lock(_slabLock);
+		slab->Next = _slabs;
+		_slabs = slab;
+	}
+	_numSlabs.fetch_add(1, std::memory_order_relaxed);
+
+	// carve the slab up into batches. the first one goes to the caller and the rest go to the global list.
+	char* slots = reinterpret_cast<char*>(slab) + SlabHeaderSize;
+	FreeNode* first = nullptr;
+	count = 0;
+	for(size_t batchStart = 0; batchStart < SlotsPerSlab; batchStart += BatchSize)
+	{
+		size_t batchEnd = batchStart + BatchSize < SlotsPerSlab ? batchStart + BatchSize : SlotsPerSlab;
+		for(size_t i = batchStart; i < batchEnd; ++i)
+		{
+			FreeNode* node = reinterpret_cast<FreeNode*>(slots + i * SlotSize);
+			node->Next = i + 1 < batchEnd ? reinterpret_cast<FreeNode*>(slots + (i + 1) * SlotSize) : nullptr;
+		}
+
+		FreeNode* batch = reinterpret_cast<FreeNode*>(slots + batchStart * SlotSize);
+		if(first == nullptr)
+		{
+			first = batch;
+			count = batchEnd - batchStart;
+		}
+		else
+		{
+			_globalFree.Push(batch, batchEnd - batchStart);
+		}
+	}
+	return first;
+}
+
+template<class T>
+void ObjectPool<T>::TrackGet() const
+{
+	size_t live = _numLive.fetch_add(1, std::memory_order_relaxed) + 1;
+	size_t highWater = _highWaterMark.load(std::memory_order_relaxed);
+	while(live > highWater && !_highWaterMark.compare_exchange_weak(highWater, live, std::memory_order_relaxed));
 }
 
 CLOSE_NAMESPACE(Firestorm);
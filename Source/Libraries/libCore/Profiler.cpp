@@ -0,0 +1,370 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Profiler
+//
+//  Records where the time goes, scope by scope, so that it can be looked at in a trace viewer.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "Profiler.h"
+
+#ifdef FIRE_PROFILING
+
+#include "Assert.h"
+#include "ThreadSlot.h"
+#include "Logger.h"
+#include <cstdio>
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// single producer, single consumer. Head is only written by the thread that owns the ThreadSlot, Tail only by
+// whoever holds s_captureLock.
+struct ProfileRing
+{
+	alignas(64) atomic<uint64_t> Head;
+	alignas(64) atomic<uint64_t> Tail;
+	Profiler::Event Events[Profiler::RingCapacity];
+};
+
+static_assert((Profiler::RingCapacity & (Profiler::RingCapacity - 1)) == 0, "the ring capacity has to be a power of two");
+
+static atomic<ProfileRing*>                  s_rings[ThreadSlot::MaxSlots];
+static atomic<uint64_t>                      s_numDropped{ 0 };
+static atomic<bool>                          s_enabled{ true };
+
+static std::mutex                            s_captureLock;
+static vector<Profiler::Event>               s_capture;
+static uint64_t                              s_numFrames{ 0 };
+static vector<eastl::pair<uint32_t, string>> s_threadNames;
+
+static thread_local uint32_t tl_threadId = 0;
+static thread_local size_t   tl_numOpenScopes = 0;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t GetThreadId()
+{
+	if(tl_threadId == 0)
+	{
+		tl_threadId = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+	}
+	return tl_threadId;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static ProfileRing* GetRing()
+{
+	const size_t slot = ThreadSlot::Get();
+	if(slot == ThreadSlot::Invalid)
+	{
+		return nullptr;
+	}
+
+	ProfileRing* ring = s_rings[slot].load(std::memory_order_acquire);
+	if(ring == nullptr)
+	{
+		// the ring outlives the thread and gets inherited by whoever picks the slot up next.
+		ring = static_cast<ProfileRing*>(std::calloc(1, sizeof(ProfileRing)));
+		if(ring)
+		{
+			s_rings[slot].store(ring, std::memory_order_release);
+		}
+	}
+	return ring;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void Append(ProfileRing* ring, const char* name, Profiler::EventType type)
+{
+	const uint64_t head = ring->Head.load(std::memory_order_relaxed);
+	Profiler::Event& event = ring->Events[head & (Profiler::RingCapacity - 1)];
+	event.Name = name;
+	event.Time = Profiler::GetTime();
+	event.ThreadId = GetThreadId();
+	event.Type = type;
+	ring->Head.store(head + 1, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// moves everything in the ring into the capture. s_captureLock has to be held.
+static void Drain(ProfileRing* ring, bool keep)
+{
+	const uint64_t head = ring->Head.load(std::memory_order_acquire);
+	const uint64_t tail = ring->Tail.load(std::memory_order_relaxed);
+	for(uint64_t i = tail; keep && i < head; ++i)
+	{
+		if(s_capture.size() >= Profiler::MaxCapturedEvents)
+		{
+			s_numDropped.fetch_add(head - i, std::memory_order_relaxed);
+			break;
+		}
+		s_capture.push_back(ring->Events[i & (Profiler::RingCapacity - 1)]);
+	}
+	ring->Tail.store(head, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void AppendJsonString(string& out, const char* value)
+{
+	out.push_back('"');
+	for(const char* c = value; *c; ++c)
+	{
+		if(*c == '"' || *c == '\\')
+		{
+			out.push_back('\\');
+			out.push_back(*c);
+		}
+		else if(static_cast<unsigned char>(*c) < 0x20)
+		{
+			out.append_sprintf("\\u%04x", static_cast<unsigned>(*c));
+		}
+		else
+		{
+			out.push_back(*c);
+		}
+	}
+	out.push_back('"');
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Profiler::BeginScope(const char* name)
+{
+	if(!s_enabled.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+	ProfileRing* ring = GetRing();
+	if(ring == nullptr)
+	{
+		s_numDropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// leave room for this begin, its end, and the ends of every scope that's already open.
+	const uint64_t used = ring->Head.load(std::memory_order_relaxed) - ring->Tail.load(std::memory_order_acquire);
+	if(used + tl_numOpenScopes + 2 > RingCapacity)
+	{
+		s_numDropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	Append(ring, name, kBegin);
+	++tl_numOpenScopes;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Profiler::EndScope()
+{
+	FIRE_ASSERT_MSG(tl_numOpenScopes > 0, "EndScope was called without a matching BeginScope");
+	--tl_numOpenScopes;
+	Append(s_rings[ThreadSlot::Get()].load(std::memory_order_relaxed), nullptr, kEnd);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Profiler::EndFrame()
+{
+	const Event frame{ nullptr, GetTime(), GetThreadId(), kFrame };
+
+	std::scoped_lock lock(s_captureLock);
+	if(s_capture.size() < MaxCapturedEvents)
+	{
+		s_capture.push_back(frame);
+	}
+	for(size_t slot = 0; slot < ThreadSlot::MaxSlots; ++slot)
+	{
+		ProfileRing* ring = s_rings[slot].load(std::memory_order_acquire);
+		if(ring)
+		{
+			Drain(ring, true);
+		}
+	}
+	++s_numFrames;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Profiler::SetThreadName(const char* name)
+{
+	const uint32_t threadId = GetThreadId();
+	std::scoped_lock lock(s_captureLock);
+	for(auto& threadName : s_threadNames)
+	{
+		if(threadName.first == threadId)
+		{
+			threadName.second = name;
+			return;
+		}
+	}
+	s_threadNames.push_back(eastl::make_pair(threadId, string(name)));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Profiler::SetEnabled(bool enabled)
+{
+	s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Profiler::IsEnabled()
+{
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Profiler::Clear()
+{
+	std::scoped_lock lock(s_captureLock);
+	for(size_t slot = 0; slot < ThreadSlot::MaxSlots; ++slot)
+	{
+		ProfileRing* ring = s_rings[slot].load(std::memory_order_acquire);
+		if(ring)
+		{
+			Drain(ring, false);
+		}
+	}
+	s_capture.clear();
+	s_numFrames = 0;
+	s_numDropped.store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t Profiler::GetNumCapturedEvents()
+{
+	std::scoped_lock lock(s_captureLock);
+	return s_capture.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t Profiler::GetNumFrames()
+{
+	std::scoped_lock lock(s_captureLock);
+	return s_numFrames;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t Profiler::GetNumDropped()
+{
+	return s_numDropped.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+vector<Profiler::Event> Profiler::GetCapturedEvents()
+{
+	std::scoped_lock lock(s_captureLock);
+	return s_capture;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+string Profiler::ExportChromeTrace()
+{
+	std::scoped_lock lock(s_captureLock);
+
+	uint64_t start = eastl::numeric_limits<uint64_t>::max();
+	for(const Event& event : s_capture)
+	{
+		start = eastl::min(start, event.Time);
+	}
+
+	string json("{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [");
+	bool first = true;
+	for(const auto& threadName : s_threadNames)
+	{
+		json.append_sprintf("%s\n\t\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %u, \"args\": { \"name\": ",
+			first ? "" : ",", threadName.first);
+		AppendJsonString(json, threadName.second.c_str());
+		json.append(" } }");
+		first = false;
+	}
+
+	// how deep each thread is, so that ends whose begin was cleared or dropped can be left out.
+	vector<eastl::pair<uint32_t, size_t>> depths;
+	uint64_t frame = 0;
+	for(const Event& event : s_capture)
+	{
+		const double timestamp = static_cast<double>(event.Time - start) / 1000.0;
+		switch(event.Type)
+		{
+		case kBegin:
+		case kEnd:
+		{
+			auto depth = eastl::find_if(depths.begin(), depths.end(), [&event](const eastl::pair<uint32_t, size_t>& d) {
+				return d.first == event.ThreadId;
+			});
+			if(depth == depths.end())
+			{
+				depths.push_back(eastl::make_pair(event.ThreadId, size_t(0)));
+				depth = depths.end() - 1;
+			}
+
+			if(event.Type == kBegin)
+			{
+				++depth->second;
+				json.append_sprintf("%s\n\t\t{ \"name\": ", first ? "" : ",");
+				AppendJsonString(json, event.Name ? event.Name : "(null)");
+				json.append_sprintf(", \"ph\": \"B\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f }", event.ThreadId, timestamp);
+			}
+			else if(depth->second > 0)
+			{
+				--depth->second;
+				json.append_sprintf("%s\n\t\t{ \"ph\": \"E\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f }",
+					first ? "" : ",", event.ThreadId, timestamp);
+			}
+			else
+			{
+				continue;
+			}
+			break;
+		}
+		case kFrame:
+			json.append_sprintf("%s\n\t\t{ \"name\": \"Frame %llu\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f }",
+				first ? "" : ",", (unsigned long long)frame++, event.ThreadId, timestamp);
+			break;
+		}
+		first = false;
+	}
+	json.append("\n\t]\n}\n");
+	return json;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Profiler::ExportChromeTrace(const char* filename)
+{
+	string json = ExportChromeTrace();
+	FILE* file = fopen(filename, "wb");
+	if(file == nullptr)
+	{
+		FIRE_LOG_ERROR("Profiler couldn't open %s to export to", filename);
+		return false;
+	}
+	bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+	fclose(file);
+	return written;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
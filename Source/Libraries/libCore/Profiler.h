@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Profiler
+//
+//  Records where the time goes, scope by scope, so that it can be looked at in a trace viewer.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_PROFILER_H_
+#define LIBCORE_PROFILER_H_
+#pragma once
+
+#include "libCore.h"
+
+#include <chrono>
+
+#ifndef FIRE_FINAL
+#define FIRE_PROFILING
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+#ifdef FIRE_PROFILING
+
+/**
+	\class Profiler
+
+	A hierarchical CPU profiler. Every thread that enters a profiled scope gets its own lock free ring that begin
+	and end events are written into, so recording a scope is two clock reads and two stores. The rings are
+	drained into the capture once a frame by EndFrame, and the capture can be written out as a Chrome trace that
+	about:tracing, Perfetto or Speedscope can open. Scopes nest, so the viewer shows them as a call tree per thread.
+
+	- A scope is only begun when its end is guaranteed to fit in the ring as well, so a full ring never cuts a
+	  scope in half. Scopes that didn't fit are counted in GetNumDropped.
+	- The capture holds at most MaxCapturedEvents. Once it's full new events are dropped until it's cleared, and
+	  the export leaves out any end whose begin didn't make it in.
+	- Times are steady clock nanoseconds. The exported trace counts them from the first event in the capture.
+
+	\warning Scope names aren't copied. Use string literals, or names that live at least as long as the capture.
+	\note The profiler only exists when FIRE_PROFILING is defined, which is every configuration but FIRE_FINAL. Use
+	the FIRE_PROFILE_ macros and it compiles away with it.
+ **/
+struct Profiler final
+{
+	static const size_t RingCapacity = 1 << 16;
+	static const size_t MaxCapturedEvents = 1 << 20;
+
+	enum EventType : uint32_t
+	{
+		kBegin,
+		kEnd,
+		kFrame
+	};
+
+	struct Event
+	{
+		const char* Name;      // nullptr for kEnd. The end matches the closest unmatched begin on its thread.
+		uint64_t    Time;
+		uint32_t    ThreadId;
+		uint32_t    Type;
+	};
+
+	static uint64_t GetTime()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/**
+		Begin a scope called \c name on the calling thread.
+
+		\return false if the profiler is off or the thread's ring is too full. EndScope must only be called for
+		scopes that were begun.
+	 **/
+	static bool BeginScope(const char* name);
+	static void EndScope();
+
+	/**
+		Mark the end of a frame and move everything the threads have recorded since the last one into the
+		capture. Called once a frame by the main loop.
+	 **/
+	static void EndFrame();
+
+	/**
+		Give the calling thread a name in the exported trace. The name is copied.
+	 **/
+	static void SetThreadName(const char* name);
+
+	/**
+		Turn recording on or off at runtime. It's on by default. Scopes that were already begun still end.
+	 **/
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+
+	/**
+		Throw the capture away, along with anything the threads have recorded that hasn't been collected yet.
+	 **/
+	static void Clear();
+
+	static size_t GetNumCapturedEvents();
+	static uint64_t GetNumFrames();
+	static uint64_t GetNumDropped();
+
+	/**
+		Copy the capture out, in the order each thread recorded it.
+	 **/
+	static vector<Event> GetCapturedEvents();
+
+	/**
+		Write the capture out in the Chrome trace event format.
+	 **/
+	static string ExportChromeTrace();
+	static bool ExportChromeTrace(const char* filename);
+};
+
+/**
+	\class ProfileScope
+
+	Profiles everything until the end of the scope it lives in. Use FIRE_PROFILE_SCOPE rather than making these
+	directly.
+ **/
+class ProfileScope final
+{
+public:
+	explicit ProfileScope(const char* name)
+	: _begun(Profiler::BeginScope(name))
+	{
+	}
+
+	~ProfileScope()
+	{
+		if(_begun)
+		{
+			Profiler::EndScope();
+		}
+	}
+
+private:
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	bool _begun;
+};
+
+#define _FIRE_PROFILE_NAME2(LINE) _fireProfileScope##LINE
+#define _FIRE_PROFILE_NAME(LINE) _FIRE_PROFILE_NAME2(LINE)
+#define FIRE_PROFILE_SCOPE(NAME) ::Firestorm::ProfileScope _FIRE_PROFILE_NAME(__LINE__)(NAME)
+#define FIRE_PROFILE_FUNCTION() FIRE_PROFILE_SCOPE(__FUNCTION__)
+#define FIRE_PROFILE_FRAME() ::Firestorm::Profiler::EndFrame()
+#define FIRE_PROFILE_THREAD(NAME) ::Firestorm::Profiler::SetThreadName(NAME)
+
+#else
+
+#define FIRE_PROFILE_SCOPE(NAME)
+#define FIRE_PROFILE_FUNCTION()
+#define FIRE_PROFILE_FRAME()
+#define FIRE_PROFILE_THREAD(NAME)
+
+#endif
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -13,9 +13,12 @@
 
 #include <libCore/libCore.h>
 #include <libCore/Logger.h>
+#include <libCore/JobSystem.h>
+#include <libCore/SOASnapshot.h>
 #include <EASTL/utility.h>
 #include <EASTL/tuple.h>
 #include <EASTL/bonus/tuple_vector.h>
+#include <EASTL/span.h>
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -60,6 +63,19 @@ decltype(auto) operator"" _tvi()
 	return soa_index<parse<Digits...>()>{};
 }
 
+// A compile time set of columns, for the chunked iteration routines. Make one with SelectColumns(1_soa, 3_soa).
+template<size_t... I>
+struct soa_columns {};
+
+template<size_t... I>
+constexpr soa_columns<I...> SelectColumns(soa_index<I>...)
+{
+	return soa_columns<I...>{};
+}
+
+// How many bytes worth of the selected columns a chunk covers by default. About half of an L1 data cache.
+static const size_t SOA_CHUNK_BYTES = 16 * 1024;
+
 #ifdef FIRE_DISABLED
 template<typename... Types>
 static inline constexpr size_t CalculateSizeof()
@@ -138,6 +154,170 @@ public:
 		typedef eastl::TupleVecInternal::tuplevec_element_t<I, Ts...> Element;
 		return eastl::TupleVecInternal::TupleVecLeaf<I, Element>::mpData;
 	}
+
+	/**
+		Retrieve the number of rows that fit SOA_CHUNK_BYTES worth of \c columns.
+	 **/
+	template<size_t... I>
+	static constexpr size_t GetChunkSize(soa_columns<I...>)
+	{
+		constexpr size_t rowBytes = (0 + ... + sizeof(eastl::TupleVecInternal::tuplevec_element_t<I, Ts...>));
+		return rowBytes >= SOA_CHUNK_BYTES ? 1 : SOA_CHUNK_BYTES / rowBytes;
+	}
+
+	/**
+		\brief Walk the rows a chunk at a time.
+
+		Calls \c func(first, spans...) for every chunk of \c chunkSize rows, where \c first is the index of the
+		chunk's first row and there's one eastl::span per selected column, in the order they were selected.
+
+		\code{.cpp}
+		SOA<Entity, Vector3, Vector3> s;
+		s.ForEachChunk(SelectColumns(1_soa, 2_soa), [dt](size_t first, span<Vector3> pos, span<Vector3> vel) {
+			for(size_t i = 0; i < pos.size(); ++i)
+				pos[i] += vel[i] * dt;
+		});
+		\endcode
+
+		Passing a chunkSize of 0 picks the one from GetChunkSize.
+	 **/
+	template<size_t... I, class Func_t>
+	void ForEachChunk(soa_columns<I...> columns, Func_t&& func, size_t chunkSize = 0)
+	{
+		if(chunkSize == 0)
+		{
+			chunkSize = GetChunkSize(columns);
+		}
+		RunChunks(columns, func, 0, this->size(), chunkSize);
+	}
+
+	/**
+		\brief Walk the rows a chunk at a time on every thread of \c jobSystem.
+
+		Same as ForEachChunk, only the chunks are spread over the workers and \c func gets called from several
+		threads at once. Returns once every chunk has been processed.
+
+		\warning Don't insert or erase rows until this returns, and keep \c func away from rows outside of the
+		spans it was handed.
+	 **/
+	template<size_t... I, class Func_t>
+	void ParallelForEach(JobSystem& jobSystem, soa_columns<I...> columns, Func_t&& func, size_t chunkSize = 0)
+	{
+		if(chunkSize == 0)
+		{
+			chunkSize = GetChunkSize(columns);
+		}
+
+		// every job gets a handful of chunks so that millions of rows don't turn into millions of jobs. the
+		// chunks keep their size inside of the job so the working set still fits the cache.
+		const size_t count = this->size();
+		const size_t chunksPerJob = eastl::max<size_t>(count / (chunkSize * jobSystem.GetNumThreads() * 4), 1);
+		jobSystem.ParallelFor(count, chunkSize * chunksPerJob, [this, columns, &func, chunkSize](size_t first, size_t last) {
+			RunChunks(columns, func, first, last, chunkSize);
+		});
+	}
+
+	/**
+		\brief Append a snapshot of every column to \c out.
+
+		Trivially copyable columns are written as raw blobs with a single memcpy each, everything else goes through
+		ColumnCodec. See ColumnWriter for the layout.
+	 **/
+	void SaveColumns(vector<char>& out) const
+	{
+		ColumnWriter writer(out, sizeof...(Ts), this->size());
+		SaveColumnsImpl(writer, eastl::make_index_sequence<sizeof...(Ts)>());
+	}
+
+	/**
+		\brief Replace the contents of the container with the snapshot in \c data.
+
+		Every column has to match the type it was saved with. On failure the container is left empty.
+	 **/
+	Result<void, Error> LoadColumns(span<const char> data)
+	{
+		this->clear();
+		Result<ColumnReader, Error> reader = ColumnReader::Open(data);
+		if(!reader)
+		{
+			return FIRE_FORWARD_ERROR(reader.error());
+		}
+		if(reader->GetNumColumns() != sizeof...(Ts))
+		{
+			return FIRE_ERROR(SOASnapshotErrors::SCHEMA_MISMATCH,
+				Format("the snapshot has %zu columns, the container has %zu", reader->GetNumColumns(), sizeof...(Ts)));
+		}
+
+		// every column is checked against the data before the rows are allocated, so a corrupt row count is
+		// turned away rather than allocated.
+		Result<void, Error> check = CheckColumnsImpl(*reader);
+		if(!check)
+		{
+			return check;
+		}
+
+		this->resize(reader->GetNumRows());
+		Result<void, Error> result = LoadColumnsImpl(*reader);
+		if(!result)
+		{
+			this->clear();
+		}
+		return result;
+	}
+
+private:
+	template<size_t... I>
+	void SaveColumnsImpl(ColumnWriter& writer, eastl::index_sequence<I...>) const
+	{
+		(..., writer.Write(this->template get<I>(), this->size()));
+	}
+
+	template<size_t I = 0>
+	Result<void, Error> CheckColumnsImpl(const ColumnReader& reader) const
+	{
+		if constexpr(I < sizeof...(Ts))
+		{
+			Result<void, Error> result = reader.template CheckColumn<eastl::TupleVecInternal::tuplevec_element_t<I, Ts...>>(I);
+			if(!result)
+			{
+				return result;
+			}
+			return CheckColumnsImpl<I + 1>(reader);
+		}
+		else
+		{
+			return Result<void, Error>();
+		}
+	}
+
+	template<size_t I = 0>
+	Result<void, Error> LoadColumnsImpl(const ColumnReader& reader)
+	{
+		if constexpr(I < sizeof...(Ts))
+		{
+			Result<void, Error> result = reader.ReadColumn(I, this->template get<I>());
+			if(!result)
+			{
+				return result;
+			}
+			return LoadColumnsImpl<I + 1>(reader);
+		}
+		else
+		{
+			return Result<void, Error>();
+		}
+	}
+
+	template<size_t... I, class Func_t>
+	void RunChunks(soa_columns<I...>, Func_t& func, size_t first, size_t last, size_t chunkSize)
+	{
+		for(; first < last; first += chunkSize)
+		{
+			const size_t count = eastl::min(chunkSize, last - first);
+			func(first, eastl::span<eastl::TupleVecInternal::tuplevec_element_t<I, Ts...>>(
+				this->template get<I>() + first, count)...);
+		}
+	}
 };
 
 #ifdef FIRE_DISABLED
@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  SOASnapshot
+//
+//  A binary format for dumping columns of data out in bulk and reading them back in.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "SOASnapshot.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+FIRE_ERRORCODE_DEF(SOASnapshotErrors::BAD_HEADER, "the data is not a column snapshot");
+FIRE_ERRORCODE_DEF(SOASnapshotErrors::TRUNCATED, "the snapshot ends before all of its columns do");
+FIRE_ERRORCODE_DEF(SOASnapshotErrors::SCHEMA_MISMATCH, "the snapshot's columns don't match the container");
+FIRE_ERRORCODE_DEF(SOASnapshotErrors::DUPLICATE_KEY, "the snapshot holds the same key more than once");
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t AlignSnapshotOffset(size_t offset)
+{
+	return (offset + SOA_SNAPSHOT_ALIGNMENT - 1) & ~(SOA_SNAPSHOT_ALIGNMENT - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ColumnCodec<string>::Write(vector<char>& out, const string& value)
+{
+	const uint32_t length = static_cast<uint32_t>(value.size());
+	const size_t offset = out.size();
+	out.resize(offset + sizeof(length) + length);
+	memcpy(out.data() + offset, &length, sizeof(length));
+	memcpy(out.data() + offset + sizeof(length), value.data(), length);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ColumnCodec<string>::Read(const char*& cursor, const char* end, string& value)
+{
+	uint32_t length;
+	if(static_cast<size_t>(end - cursor) < sizeof(length))
+	{
+		return false;
+	}
+	memcpy(&length, cursor, sizeof(length));
+	if(static_cast<size_t>(end - cursor) - sizeof(length) < length)
+	{
+		return false;
+	}
+	value.assign(cursor + sizeof(length), cursor + sizeof(length) + length);
+	cursor += sizeof(length) + length;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ColumnWriter::ColumnWriter(vector<char>& out, size_t numColumns, size_t numRows)
+: _out(out)
+, _start(out.size())
+{
+	SnapshotHeader header{ kMagic, kVersion, numColumns, numRows, 0 };
+	_out.resize(_start + sizeof(header));
+	memcpy(_out.data() + _start, &header, sizeof(header));
+	Pad();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ColumnWriter::Pad()
+{
+	_out.resize(_start + AlignSnapshotOffset(_out.size() - _start), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t ColumnWriter::BeginColumn(uint64_t typeHash, uint32_t elementSize, Encoding encoding, size_t count)
+{
+	ColumnHeader header{ typeHash, elementSize, encoding, count, 0 };
+	const size_t offset = _out.size();
+	_out.resize(offset + sizeof(header));
+	memcpy(_out.data() + offset, &header, sizeof(header));
+	Pad();
+	return offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ColumnWriter::EndColumn(size_t header)
+{
+	// the column's data starts at the first aligned offset after its header.
+	const size_t payload = _start + AlignSnapshotOffset(header + sizeof(ColumnHeader) - _start);
+	const uint64_t byteSize = _out.size() - payload;
+	memcpy(_out.data() + header + offsetof(ColumnHeader, ByteSize), &byteSize, sizeof(byteSize));
+	Pad();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Result<ColumnReader, Error> ColumnReader::Open(span<const char> data)
+{
+	SnapshotHeader header;
+	if(data.size() < sizeof(header))
+	{
+		return FIRE_ERROR(SOASnapshotErrors::BAD_HEADER, "the data is too small to hold a snapshot header");
+	}
+	memcpy(&header, data.data(), sizeof(header));
+	if(header.Magic != ColumnWriter::kMagic || header.Version != ColumnWriter::kVersion)
+	{
+		return FIRE_ERROR(SOASnapshotErrors::BAD_HEADER, Format("magic %x version %d", header.Magic, header.Version));
+	}
+
+	ColumnReader reader;
+	reader._numRows = static_cast<size_t>(header.NumRows);
+	// the column count hasn't been checked yet, so don't take its word for how much to reserve.
+	reader._columns.reserve(static_cast<size_t>(eastl::min<uint64_t>(header.NumColumns, data.size() / sizeof(ColumnHeader))));
+
+	size_t offset = AlignSnapshotOffset(sizeof(header));
+	for(uint64_t i = 0; i < header.NumColumns; ++i)
+	{
+		Column column;
+		if(offset > data.size() || data.size() - offset < sizeof(column.Header))
+		{
+			return FIRE_ERROR(SOASnapshotErrors::TRUNCATED, Format("column %llu is missing its header", static_cast<unsigned long long>(i)));
+		}
+		memcpy(&column.Header, data.data() + offset, sizeof(column.Header));
+
+		const size_t payload = AlignSnapshotOffset(offset + sizeof(column.Header));
+		if(payload > data.size() || data.size() - payload < column.Header.ByteSize)
+		{
+			return FIRE_ERROR(SOASnapshotErrors::TRUNCATED, Format("column %llu is cut short", static_cast<unsigned long long>(i)));
+		}
+		column.Payload = data.data() + payload;
+		reader._columns.push_back(column);
+
+		offset = AlignSnapshotOffset(payload + static_cast<size_t>(column.Header.ByteSize));
+	}
+	return reader;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Result<void, Error> ColumnReader::CheckColumn(size_t column, uint64_t typeHash, uint32_t elementSize, uint32_t encoding) const
+{
+	if(column >= _columns.size())
+	{
+		return FIRE_ERROR(SOASnapshotErrors::SCHEMA_MISMATCH, Format("there is no column %zu", column));
+	}
+
+	const ColumnHeader& header = _columns[column].Header;
+	if(header.TypeHash != typeHash || header.ElementSize != elementSize || header.Encoding != encoding)
+	{
+		return FIRE_ERROR(SOASnapshotErrors::SCHEMA_MISMATCH, Format("column %zu holds a different type", column));
+	}
+	// ByteSize was checked against the data in Open. raw columns have to be exactly one element per row, and codec
+	// elements take at least a byte each, which keeps a bogus row count from being believed.
+	const bool sized = encoding == ColumnWriter::kRaw ?
+		header.ByteSize % elementSize == 0 && header.ByteSize / elementSize == header.Count :
+		header.Count <= header.ByteSize;
+	if(header.Count != _numRows || !sized)
+	{
+		return FIRE_ERROR(SOASnapshotErrors::TRUNCATED, Format("column %zu doesn't hold one element per row", column));
+	}
+	return Result<void, Error>();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  SOASnapshot
+//
+//  A binary format for dumping columns of data out in bulk and reading them back in.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_SOASNAPSHOT_H_
+#define LIBCORE_SOASNAPSHOT_H_
+#pragma once
+
+#include "libCore.h"
+#include "Assert.h"
+#include "Hash.h"
+#include "Result.h"
+#include "Logger.h"
+
+#include <EASTL/span.h>
+#include <cstring>
+
+OPEN_NAMESPACE(Firestorm);
+
+struct SOASnapshotErrors
+{
+	FIRE_ERRORCODE(BAD_HEADER);
+	FIRE_ERRORCODE(TRUNCATED);
+	FIRE_ERRORCODE(SCHEMA_MISMATCH);
+	FIRE_ERRORCODE(DUPLICATE_KEY);
+};
+
+/**
+	Every header and every column in a snapshot starts on a multiple of this, counted from the start of the
+	snapshot. Map a snapshot in at an aligned address and the raw columns can be used in place.
+ **/
+static const size_t SOA_SNAPSHOT_ALIGNMENT = 64;
+
+/**
+	\class ColumnCodec
+
+	Writes and reads the elements of columns that can't be copied around as raw bytes. Specialize it for any
+	member type that isn't trivially copyable.
+
+	Read advances \c cursor past what it read and returns false if it would have to read past \c end.
+
+	\note Write has to write at least one byte per element, so that a snapshot's row count can be checked against
+	its size before anything is allocated for it.
+ **/
+template<class T>
+struct ColumnCodec
+{
+	static void Write(vector<char>& out, const T& value)
+	{
+		static_assert(sizeof(T) == 0, "specialize ColumnCodec for columns that aren't trivially copyable");
+	}
+
+	static bool Read(const char*& cursor, const char* end, T& value)
+	{
+		static_assert(sizeof(T) == 0, "specialize ColumnCodec for columns that aren't trivially copyable");
+		return false;
+	}
+};
+
+template<>
+struct ColumnCodec<string>
+{
+	static void Write(vector<char>& out, const string& value);
+	static bool Read(const char*& cursor, const char* end, string& value);
+};
+
+/**
+	\class ColumnWriter
+
+	Appends a snapshot to a buffer, one column at a time. The layout is
+
+		SnapshotHeader | ColumnHeader | column 0 | ColumnHeader | column 1 | ...
+
+	...where every piece is padded out to SOA_SNAPSHOT_ALIGNMENT. Trivially copyable columns are written with a
+	single memcpy. Everything else goes through ColumnCodec one element at a time.
+ **/
+class ColumnWriter final
+{
+public:
+	ColumnWriter(vector<char>& out, size_t numColumns, size_t numRows);
+
+	template<class T>
+	void Write(const T* values, size_t count)
+	{
+		if constexpr(eastl::is_trivially_copyable<T>::value)
+		{
+			const size_t header = BeginColumn(GetTypeHash<T>(), sizeof(T), kRaw, count);
+			const size_t payload = _out.size();
+			_out.resize(payload + count * sizeof(T));
+			if(count > 0)
+			{
+				memcpy(_out.data() + payload, values, count * sizeof(T));
+			}
+			EndColumn(header);
+		}
+		else
+		{
+			const size_t header = BeginColumn(GetTypeHash<T>(), sizeof(T), kCodec, count);
+			for(size_t i = 0; i < count; ++i)
+			{
+				ColumnCodec<T>::Write(_out, values[i]);
+			}
+			EndColumn(header);
+		}
+	}
+
+private:
+	friend class ColumnReader;
+
+	enum Encoding : uint32_t
+	{
+		kRaw,
+		kCodec
+	};
+
+	struct SnapshotHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t NumColumns;
+		uint64_t NumRows;
+		uint64_t Reserved;
+	};
+
+	struct ColumnHeader
+	{
+		uint64_t TypeHash;
+		uint32_t ElementSize;
+		uint32_t Encoding;
+		uint64_t Count;
+		uint64_t ByteSize;   // the length of the column's data, not counting the padding after it.
+	};
+
+	static const uint32_t kMagic = 0x414F5346; // "FSOA"
+	static const uint32_t kVersion = 1;
+
+	void Pad();
+	size_t BeginColumn(uint64_t typeHash, uint32_t elementSize, Encoding encoding, size_t count);
+	void EndColumn(size_t header);
+
+	vector<char>& _out;
+	size_t        _start;
+};
+
+/**
+	\class ColumnReader
+
+	Reads back a snapshot made by ColumnWriter. Nothing is copied until ReadColumn is called, and GetColumn hands
+	out raw columns in place, so a memory mapped snapshot can be used without loading it at all.
+
+	\warning The reader points into the data it was opened on. Keep the data alive for as long as the reader.
+ **/
+class ColumnReader final
+{
+	using SnapshotHeader = ColumnWriter::SnapshotHeader;
+	using ColumnHeader = ColumnWriter::ColumnHeader;
+public:
+	/**
+		Check the headers of the snapshot in \c data and make a reader for it.
+	 **/
+	static Result<ColumnReader, Error> Open(span<const char> data);
+
+	size_t GetNumColumns() const { return _columns.size(); }
+	size_t GetNumRows() const { return _numRows; }
+
+	/**
+		Retrieve the raw column at \c column in place. Fails if the column wasn't written from a T, or wasn't
+		written raw.
+	 **/
+	template<class T>
+	Result<span<const T>, Error> GetColumn(size_t column) const
+	{
+		static_assert(eastl::is_trivially_copyable<T>::value, "only trivially copyable columns can be used in place");
+		Result<void, Error> check = CheckColumn(column, GetTypeHash<T>(), sizeof(T), ColumnWriter::kRaw);
+		if(!check)
+		{
+			return FIRE_FORWARD_ERROR(check.error());
+		}
+		return span<const T>(reinterpret_cast<const T*>(_columns[column].Payload), _numRows);
+	}
+
+	/**
+		Check that the column at \c column was written from a T and holds GetNumRows() elements that fit in the
+		data, without reading any of it.
+	 **/
+	template<class T>
+	Result<void, Error> CheckColumn(size_t column) const
+	{
+		return CheckColumn(column, GetTypeHash<T>(), sizeof(T),
+			eastl::is_trivially_copyable<T>::value ? ColumnWriter::kRaw : ColumnWriter::kCodec);
+	}
+
+	/**
+		Copy the column at \c column into the GetNumRows() elements at \c out.
+	 **/
+	template<class T>
+	Result<void, Error> ReadColumn(size_t column, T* out) const
+	{
+		if constexpr(eastl::is_trivially_copyable<T>::value)
+		{
+			Result<void, Error> check = CheckColumn(column, GetTypeHash<T>(), sizeof(T), ColumnWriter::kRaw);
+			if(check && _numRows > 0)
+			{
+				memcpy(out, _columns[column].Payload, _numRows * sizeof(T));
+			}
+			return check;
+		}
+		else
+		{
+			Result<void, Error> check = CheckColumn(column, GetTypeHash<T>(), sizeof(T), ColumnWriter::kCodec);
+			if(!check)
+			{
+				return check;
+			}
+			const char* cursor = _columns[column].Payload;
+			const char* end = cursor + _columns[column].Header.ByteSize;
+			for(size_t i = 0; i < _numRows; ++i)
+			{
+				if(!ColumnCodec<T>::Read(cursor, end, out[i]))
+				{
+					return FIRE_ERROR(SOASnapshotErrors::TRUNCATED, Format("column %zu ends after %zu elements", column, i));
+				}
+			}
+			return Result<void, Error>();
+		}
+	}
+
+private:
+	struct Column
+	{
+		ColumnHeader Header;
+		const char*  Payload;
+	};
+
+	Result<void, Error> CheckColumn(size_t column, uint64_t typeHash, uint32_t elementSize, uint32_t encoding) const;
+
+	vector<Column> _columns;
+	size_t         _numRows{ 0 };
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
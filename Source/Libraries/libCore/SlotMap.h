@@ -0,0 +1,514 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  SlotMap
+//
+//  Stores values behind generational handles that go stale once their value is erased.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_SLOTMAP_H_
+#define LIBCORE_SLOTMAP_H_
+#pragma once
+
+#include "libCore.h"
+#include "Assert.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class SlotHandle
+
+	A 64 bit handle made of a slot index in the low \c IndexBits bits and a generation in the rest. SlotHandle32
+	(32/32) suits most containers. SlotHandle40 (40/24) trades generations for room to address more than 4
+	billion slots.
+
+	The highest generation is never handed out, so a handle with every bit set (the default) is always null.
+ **/
+template<unsigned IndexBits>
+struct SlotHandle
+{
+	static_assert(IndexBits >= 8 && IndexBits <= 56, "leave room for both the index and the generation");
+
+	static constexpr unsigned NumIndexBits = IndexBits;
+	static constexpr unsigned GenerationBits = 64 - IndexBits;
+	static constexpr uint64_t IndexMask = (uint64_t(1) << IndexBits) - 1;
+	static constexpr uint64_t GenerationMask = (uint64_t(1) << GenerationBits) - 1;
+
+	using Index_t = eastl::conditional_t<IndexBits <= 32, uint32_t, uint64_t>;
+	using Generation_t = eastl::conditional_t<GenerationBits <= 32, uint32_t, uint64_t>;
+
+	uint64_t Value{ ~uint64_t(0) };
+
+	constexpr SlotHandle() = default;
+	constexpr SlotHandle(uint64_t index, uint64_t generation)
+	: Value(((generation & GenerationMask) << IndexBits) | (index & IndexMask))
+	{
+	}
+
+	Index_t GetIndex() const { return static_cast<Index_t>(Value & IndexMask); }
+	Generation_t GetGeneration() const { return static_cast<Generation_t>(Value >> IndexBits); }
+	bool IsNull() const { return Value == ~uint64_t(0); }
+
+	bool operator==(const SlotHandle& other) const { return Value == other.Value; }
+	bool operator!=(const SlotHandle& other) const { return Value != other.Value; }
+	bool operator<(const SlotHandle& other) const { return Value < other.Value; }
+};
+
+using SlotHandle32 = SlotHandle<32>;
+using SlotHandle40 = SlotHandle<40>;
+
+/**
+	\class SlotMap
+
+	Values live packed together in a dense array so iterating over them is a straight walk through memory. Each
+	handle points at a slot, and the slot knows where its value currently sits in the dense array and which
+	generation of value it holds. Inserting, erasing and looking a handle up are all O(1):
+
+	- Insert takes a slot off of the free list (or adds one) and appends the value.
+	- Erase moves the last value into the hole (swap and pop), bumps the slot's generation so every handle to the
+	  old value goes stale, and puts the slot back on the free list.
+	- Get checks the generation and follows the slot to the value.
+
+	A slot whose generation runs out is retired instead of being reused, so a stale handle can never alias a
+	newer value no matter how long it's held for.
+
+	\warning Inserting and erasing move values around in the dense array. Pointers to values and iterators are
+	invalidated by both. Handles are not.
+	\note Not thread safe. See ConcurrentSlotMap.
+ **/
+template<class T, class Handle_t = SlotHandle32>
+class SlotMap final
+{
+	using Index_t = typename Handle_t::Index_t;
+	using Generation_t = typename Handle_t::Generation_t;
+public:
+	using Handle = Handle_t;
+	using iterator = typename vector<T>::iterator;
+	using const_iterator = typename vector<T>::const_iterator;
+
+	size_t Size() const { return _values.size(); }
+	bool Empty() const { return _values.empty(); }
+
+	void Reserve(size_t numValues)
+	{
+		_values.reserve(numValues);
+		_valueToSlot.reserve(numValues);
+		_slots.reserve(numValues);
+	}
+
+	/**
+		Erase every value. Every handle handed out so far goes stale.
+	 **/
+	void Clear()
+	{
+		for(size_t i = 0; i < _valueToSlot.size(); ++i)
+		{
+			ReleaseSlot(_valueToSlot[i]);
+		}
+		_values.clear();
+		_valueToSlot.clear();
+	}
+
+	Handle Insert(const T& value) { return Emplace(value); }
+	Handle Insert(T&& value) { return Emplace(std::move(value)); }
+
+	template<class... Args_t>
+	Handle Emplace(Args_t&&... args)
+	{
+		const Index_t slot = AcquireSlot();
+		_slots[slot].Value = static_cast<Index_t>(_values.size());
+		_values.emplace_back(std::forward<Args_t>(args)...);
+		_valueToSlot.push_back(slot);
+		return Handle(slot, _slots[slot].Generation);
+	}
+
+	/**
+		Erase the value \c handle refers to.
+
+		\return Whether or not the handle was still valid.
+	 **/
+	bool Erase(Handle handle)
+	{
+		const size_t index = Find(handle);
+		if(index == InvalidIndex)
+		{
+			return false;
+		}
+
+		const size_t last = _values.size() - 1;
+		if(index != last)
+		{
+			_values[index] = std::move(_values[last]);
+			_valueToSlot[index] = _valueToSlot[last];
+			_slots[_valueToSlot[index]].Value = static_cast<Index_t>(index);
+		}
+		_values.pop_back();
+		_valueToSlot.pop_back();
+		ReleaseSlot(handle.GetIndex());
+		return true;
+	}
+
+	/**
+		Retrieve the value \c handle refers to, or nullptr if it has been erased.
+	 **/
+	T* Get(Handle handle)
+	{
+		const size_t index = Find(handle);
+		return index != InvalidIndex ? &_values[index] : nullptr;
+	}
+
+	const T* Get(Handle handle) const
+	{
+		const size_t index = Find(handle);
+		return index != InvalidIndex ? &_values[index] : nullptr;
+	}
+
+	bool Contains(Handle handle) const
+	{
+		return Find(handle) != InvalidIndex;
+	}
+
+	/**
+		Retrieve the handle of the value at \c index in the dense array, the same order that iteration goes in.
+	 **/
+	Handle GetHandle(size_t index) const
+	{
+		FIRE_ASSERT_MSG(index < Size(), Format("index '%zu' out of bounds", index));
+		const Index_t slot = _valueToSlot[index];
+		return Handle(slot, _slots[slot].Generation);
+	}
+
+	T* Data() { return _values.data(); }
+	const T* Data() const { return _values.data(); }
+
+	iterator begin() { return _values.begin(); }
+	iterator end() { return _values.end(); }
+	const_iterator begin() const { return _values.begin(); }
+	const_iterator end() const { return _values.end(); }
+
+	/**
+		Retrieve how many slots have been retired because their generation ran out.
+	 **/
+	size_t GetNumRetiredSlots() const { return _numRetired; }
+
+private:
+	static constexpr size_t InvalidIndex = eastl::numeric_limits<size_t>::max();
+	static constexpr Index_t NoSlot = static_cast<Index_t>(Handle_t::IndexMask);
+	static constexpr Generation_t LastGeneration = static_cast<Generation_t>(Handle_t::GenerationMask - 1);
+
+	struct Slot
+	{
+		Index_t      Value;      // where the value is while the slot is in use, the next free slot when it isn't.
+		Generation_t Generation;
+	};
+
+	size_t Find(Handle handle) const
+	{
+		const Index_t slot = handle.GetIndex();
+		if(slot >= _slots.size() || _slots[slot].Generation != handle.GetGeneration())
+		{
+			return InvalidIndex;
+		}
+		return _slots[slot].Value;
+	}
+
+	Index_t AcquireSlot()
+	{
+		Index_t slot = _freeSlot;
+		if(slot != NoSlot)
+		{
+			_freeSlot = _slots[slot].Value;
+			return slot;
+		}
+		FIRE_ASSERT_MSG(_slots.size() < NoSlot, "ran out of slots, use a handle with more index bits");
+		_slots.push_back(Slot{ 0, 0 });
+		return static_cast<Index_t>(_slots.size() - 1);
+	}
+
+	void ReleaseSlot(Index_t slot)
+	{
+		if(_slots[slot].Generation == LastGeneration)
+		{
+			// every generation has been handed out, so reusing the slot could bring a stale handle back to life.
+			_slots[slot].Generation = static_cast<Generation_t>(Handle_t::GenerationMask);
+			++_numRetired;
+			return;
+		}
+		++_slots[slot].Generation;
+		_slots[slot].Value = _freeSlot;
+		_freeSlot = slot;
+	}
+
+	vector<T>       _values;
+	vector<Index_t> _valueToSlot;
+	vector<Slot>    _slots;
+	Index_t         _freeSlot{ NoSlot };
+	size_t          _numRetired{ 0 };
+};
+
+/**
+	\class ConcurrentSlotMap
+
+	A SlotMap that any number of threads can insert into, erase from and look up in at the same time, without
+	taking any locks.
+
+	Values can't be kept dense without moving them under the feet of other threads, so they live in their slots
+	instead. Slots sit in pages of PageSize that are allocated as they're needed, up to the capacity passed to
+	the constructor, and never move. Free slots go on a lock free list whose head carries an ABA tag in the
+	bits the index doesn't use.
+
+	A slot's generation is odd while it holds a value and even while it's free. Erase flips it with a CAS, so of
+	any number of threads erasing the same handle exactly one wins.
+
+	\warning Get hands out a pointer to the value without holding onto it. Erasing a value while another thread
+	is still using it is up to the caller to prevent, the same as it would be with a pointer from new.
+	\note ForEach walks the slots in order and isn't a snapshot. Values inserted or erased while it runs may or
+	may not be visited.
+ **/
+template<class T, class Handle_t = SlotHandle32>
+class ConcurrentSlotMap final
+{
+	using Index_t = typename Handle_t::Index_t;
+	using Generation_t = typename Handle_t::Generation_t;
+public:
+	using Handle = Handle_t;
+
+	static const size_t PageSize = 4096;
+
+	explicit ConcurrentSlotMap(size_t capacity)
+	: _capacity(eastl::min<size_t>(capacity, static_cast<size_t>(NoSlot)))
+	, _numPages((_capacity + PageSize - 1) / PageSize)
+	, _pages(new atomic<Slot*>[_numPages])
+	{
+		for(size_t i = 0; i < _numPages; ++i)
+		{
+			_pages[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~ConcurrentSlotMap()
+	{
+		for(size_t i = 0; i < _numPages; ++i)
+		{
+			Slot* page = _pages[i].load(std::memory_order_acquire);
+			if(!page)
+			{
+				continue;
+			}
+			for(size_t j = 0; j < PageSize; ++j)
+			{
+				if(page[j].Generation.load(std::memory_order_relaxed) & 1)
+				{
+					page[j].GetValue()->~T();
+				}
+			}
+			delete[] page;
+		}
+		delete[] _pages;
+	}
+
+	size_t Size() const { return _size.load(std::memory_order_relaxed); }
+	size_t GetCapacity() const { return _capacity; }
+
+	/**
+		Construct a value in a free slot.
+
+		\return The handle to the value, or a null handle if every slot is taken.
+	 **/
+	template<class... Args_t>
+	Handle Emplace(Args_t&&... args)
+	{
+		Index_t index = PopFree();
+		if(index == NoSlot)
+		{
+			const size_t fresh = _numSlotsUsed.fetch_add(1, std::memory_order_relaxed);
+			if(fresh >= _capacity)
+			{
+				_numSlotsUsed.fetch_sub(1, std::memory_order_relaxed);
+				return Handle();
+			}
+			index = static_cast<Index_t>(fresh);
+		}
+
+		Slot& slot = GetSlot(index, true);
+		new(slot.GetValue()) T(std::forward<Args_t>(args)...);
+		const Generation_t generation = slot.Generation.load(std::memory_order_relaxed) + 1;
+		slot.Generation.store(generation, std::memory_order_release);
+		_size.fetch_add(1, std::memory_order_relaxed);
+		return Handle(index, generation);
+	}
+
+	Handle Insert(const T& value) { return Emplace(value); }
+	Handle Insert(T&& value) { return Emplace(std::move(value)); }
+
+	/**
+		Destroy the value \c handle refers to.
+
+		\return Whether or not this call erased it. False if the handle was stale or another thread got there first.
+	 **/
+	bool Erase(Handle handle)
+	{
+		Slot* slot = FindSlot(handle);
+		if(!slot)
+		{
+			return false;
+		}
+
+		Generation_t expected = handle.GetGeneration();
+		if(!slot->Generation.compare_exchange_strong(expected, expected + 1, std::memory_order_acq_rel))
+		{
+			return false;
+		}
+		slot->GetValue()->~T();
+		_size.fetch_sub(1, std::memory_order_relaxed);
+
+		if(expected + 2 >= LastGeneration)
+		{
+			// out of generations. leave the slot off of the free list so that stale handles stay stale.
+			_numRetired.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		PushFree(handle.GetIndex());
+		return true;
+	}
+
+	/**
+		Retrieve the value \c handle refers to, or nullptr if it has been erased.
+	 **/
+	T* Get(Handle handle) const
+	{
+		Slot* slot = FindSlot(handle);
+		if(!slot || slot->Generation.load(std::memory_order_acquire) != handle.GetGeneration())
+		{
+			return nullptr;
+		}
+		return slot->GetValue();
+	}
+
+	bool Contains(Handle handle) const
+	{
+		return Get(handle) != nullptr;
+	}
+
+	/**
+		Call \c func(handle, value) for every live value.
+	 **/
+	template<class Func_t>
+	void ForEach(Func_t&& func) const
+	{
+		const size_t numSlots = eastl::min(_numSlotsUsed.load(std::memory_order_acquire), _capacity);
+		for(size_t i = 0; i < numSlots; ++i)
+		{
+			Slot* page = _pages[i / PageSize].load(std::memory_order_acquire);
+			if(!page)
+			{
+				continue;
+			}
+			Slot& slot = page[i % PageSize];
+			const Generation_t generation = slot.Generation.load(std::memory_order_acquire);
+			if(generation & 1)
+			{
+				func(Handle(i, generation), *slot.GetValue());
+			}
+		}
+	}
+
+	size_t GetNumRetiredSlots() const { return _numRetired.load(std::memory_order_relaxed); }
+
+private:
+	ConcurrentSlotMap(const ConcurrentSlotMap&) = delete;
+	ConcurrentSlotMap& operator=(const ConcurrentSlotMap&) = delete;
+
+	static constexpr Index_t NoSlot = static_cast<Index_t>(Handle_t::IndexMask);
+	static constexpr Generation_t LastGeneration = static_cast<Generation_t>(Handle_t::GenerationMask);
+
+	struct Slot
+	{
+		atomic<Generation_t> Generation{ 0 };
+		atomic<Index_t>      NextFree{ NoSlot };
+		alignas(T) unsigned char Storage[sizeof(T)];
+
+		T* GetValue() { return reinterpret_cast<T*>(Storage); }
+	};
+
+	Slot& GetSlot(size_t index, bool allocate) const
+	{
+		atomic<Slot*>& pageRef = _pages[index / PageSize];
+		Slot* page = pageRef.load(std::memory_order_acquire);
+		if(!page && allocate)
+		{
+			// whoever gets their page in first wins, the rest throw theirs away.
+			Slot* fresh = new Slot[PageSize];
+			if(pageRef.compare_exchange_strong(page, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				page = fresh;
+			}
+			else
+			{
+				delete[] fresh;
+			}
+		}
+		return page[index % PageSize];
+	}
+
+	Slot* FindSlot(Handle handle) const
+	{
+		const size_t index = handle.GetIndex();
+		if(index >= _capacity)
+		{
+			return nullptr;
+		}
+		Slot* page = _pages[index / PageSize].load(std::memory_order_acquire);
+		return page ? &page[index % PageSize] : nullptr;
+	}
+
+	// the free list head packs an ABA tag into the bits above the index.
+	static Index_t UnpackIndex(uint64_t head) { return static_cast<Index_t>(head & Handle_t::IndexMask); }
+	static uint64_t Pack(Index_t index, uint64_t oldHead)
+	{
+		return (((oldHead >> Handle_t::NumIndexBits) + 1) << Handle_t::NumIndexBits) | index;
+	}
+
+	void PushFree(Index_t index)
+	{
+		Slot& slot = GetSlot(index, false);
+		uint64_t head = _freeHead.load(std::memory_order_relaxed);
+		do
+		{
+			slot.NextFree.store(UnpackIndex(head), std::memory_order_relaxed);
+		} while(!_freeHead.compare_exchange_weak(head, Pack(index, head), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	Index_t PopFree()
+	{
+		uint64_t head = _freeHead.load(std::memory_order_acquire);
+		for(;;)
+		{
+			const Index_t index = UnpackIndex(head);
+			if(index == NoSlot)
+			{
+				return NoSlot;
+			}
+			// the slot may be popped and pushed back by another thread between the load and the CAS, with a
+			// different next. the tag makes the CAS fail in that case, and slots never go away while the map lives.
+			const Index_t next = GetSlot(index, false).NextFree.load(std::memory_order_relaxed);
+			if(_freeHead.compare_exchange_weak(head, Pack(next, head), std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return index;
+			}
+		}
+	}
+
+	const size_t          _capacity;
+	const size_t          _numPages;
+	atomic<Slot*>*        _pages;
+	atomic<uint64_t>      _freeHead{ Handle_t::IndexMask };
+	atomic<size_t>        _numSlotsUsed{ 0 };
+	atomic<size_t>        _size{ 0 };
+	atomic<size_t>        _numRetired{ 0 };
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  StringId
+//
+//  A string boiled down to its 64 bit hash, for keys that get compared far more often than they get printed.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "StringId.h"
+#include "MemoryTracker.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+#ifdef FIRE_STRINGID_NAMES
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// a slot is claimed by swapping its Hash in, and becomes readable once Name is published. names are never removed,
+// so a probe can stop at the first empty slot.
+struct InternedName
+{
+	atomic<uint64_t>    Hash;
+	atomic<const char*> Name;
+};
+
+static InternedName   s_names[StringId::MaxInternedNames];
+static atomic<size_t> s_numNames{ 0 };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t GetHomeSlot(uint64_t hash)
+{
+	return static_cast<size_t>(HashDetail::Mix(hash)) & (StringId::MaxInternedNames - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StringId::Intern(uint64_t hash, const char* str, size_t length)
+{
+	if(hash == 0)
+	{
+		return;
+	}
+
+	size_t index = GetHomeSlot(hash);
+	for(size_t probe = 0; probe < MaxInternedNames; ++probe)
+	{
+		InternedName& slot = s_names[index];
+		uint64_t existing = slot.Hash.load(std::memory_order_acquire);
+		if(existing == 0 && slot.Hash.compare_exchange_strong(existing, hash, std::memory_order_acq_rel))
+		{
+			// the names live for as long as the process does.
+			char* name = static_cast<char*>(UntrackedAllocator::Allocate(length + 1));
+			memcpy(name, str, length);
+			name[length] = 0;
+			slot.Name.store(name, std::memory_order_release);
+			s_numNames.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		if(existing == hash)
+		{
+			// the name may not be published yet if another thread is interning the same string right now.
+			const char* name = slot.Name.load(std::memory_order_acquire);
+			FIRE_ASSERT_MSG(name == nullptr || (strncmp(name, str, length) == 0 && name[length] == 0),
+				"StringId collision, two different strings hashed to the same id");
+			return;
+		}
+		index = (index + 1) & (MaxInternedNames - 1);
+	}
+	FIRE_ASSERT_MSG(false, "the StringId name table is full");
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* StringId::GetName() const
+{
+	if(_hash == 0)
+	{
+		return "";
+	}
+
+	size_t index = GetHomeSlot(_hash);
+	for(size_t probe = 0; probe < MaxInternedNames; ++probe)
+	{
+		const InternedName& slot = s_names[index];
+		const uint64_t existing = slot.Hash.load(std::memory_order_acquire);
+		if(existing == 0)
+		{
+			break;
+		}
+		if(existing == _hash)
+		{
+			const char* name = slot.Name.load(std::memory_order_acquire);
+			return name ? name : "<unknown>";
+		}
+		index = (index + 1) & (MaxInternedNames - 1);
+	}
+	return "<unknown>";
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t StringId::GetNumInternedNames()
+{
+	return s_numNames.load(std::memory_order_relaxed);
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void StringId::Intern(uint64_t, const char*, size_t)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* StringId::GetName() const
+{
+	return "<stripped>";
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t StringId::GetNumInternedNames()
+{
+	return 0;
+}
+
+#endif
+
+CLOSE_NAMESPACE(Firestorm);
@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  StringId
+//
+//  A string boiled down to its 64 bit hash, for keys that get compared far more often than they get printed.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_STRINGID_H_
+#define LIBCORE_STRINGID_H_
+#pragma once
+
+#include "libCore.h"
+#include "Hash.h"
+
+#ifndef FIRE_FINAL
+#define FIRE_STRINGID_NAMES
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class StringId
+
+	Holds nothing but the 64 bit FNV-1a hash of a string, so copying one is copying an integer and comparing two is
+	comparing integers. Make them at compile time with the _sid literal ("Foo"_sid), or at runtime from a string.
+
+	Building a StringId at runtime also interns the string in a global lock free table, so that GetName can turn
+	the id back into something readable. Literals are hashed by the compiler and don't get interned, but they'll
+	still find the name if the same string was interned anywhere else.
+
+	\note Interning only happens when FIRE_STRINGID_NAMES is defined, which is every configuration but FIRE_FINAL.
+	In FIRE_FINAL GetName always returns "<stripped>".
+	\note Two different strings interned with the same hash trip an assert.
+ **/
+class StringId final
+{
+public:
+	static const size_t MaxInternedNames = 1 << 15;
+
+	constexpr StringId() = default;
+
+	explicit StringId(const char* str)
+	: _hash(HashString<64>::Hash(str))
+	{
+		Intern(_hash, str, strlen(str));
+	}
+
+	StringId(const char* str, size_t length)
+	: _hash(HashString<64>::Hash(str, length))
+	{
+		Intern(_hash, str, length);
+	}
+
+	explicit StringId(const string& str)
+	: StringId(str.c_str(), str.size())
+	{
+	}
+
+	/**
+		Build a StringId from a hash that was computed elsewhere. Nothing gets interned.
+	 **/
+	static constexpr StringId FromHash(uint64_t hash)
+	{
+		return StringId(hash, 0);
+	}
+
+	constexpr uint64_t GetHash() const { return _hash; }
+
+	/**
+		Retrieve the interned name of this id, or "<unknown>" if it was never interned.
+	 **/
+	const char* GetName() const;
+
+	constexpr bool IsValid() const { return _hash != 0; }
+
+	constexpr bool operator==(const StringId& other) const { return _hash == other._hash; }
+	constexpr bool operator!=(const StringId& other) const { return _hash != other._hash; }
+	constexpr bool operator<(const StringId& other) const { return _hash < other._hash; }
+
+	/**
+		Retrieve the number of names in the interning table.
+	 **/
+	static size_t GetNumInternedNames();
+
+private:
+	constexpr StringId(uint64_t hash, int)
+	: _hash(hash)
+	{
+	}
+
+	static void Intern(uint64_t hash, const char* str, size_t length);
+
+	uint64_t _hash{ 0 };
+};
+
+constexpr StringId operator""_sid(const char* str, size_t length)
+{
+	return StringId::FromHash(HashString<64>::Hash(str, length));
+}
+
+CLOSE_NAMESPACE(Firestorm);
+
+OPEN_NAMESPACE(eastl);
+
+template<>
+struct hash<::Firestorm::StringId>
+{
+	size_t operator()(const ::Firestorm::StringId& id) const
+	{
+		return static_cast<size_t>(id.GetHash());
+	}
+};
+
+CLOSE_NAMESPACE(eastl);
+
+#endif
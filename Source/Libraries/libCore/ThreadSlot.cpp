@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ThreadSlot
+//
+//  Hands every thread a small index that per-thread storage can be keyed off of.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "ThreadSlot.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+static_assert(ThreadSlot::MaxSlots == 64, "the claimed slots are tracked in a single 64 bit mask");
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static atomic<uint64_t> s_claimedSlots{ 0 };
+
+// hands the slot back when the thread exits.
+struct ThreadSlotHolder
+{
+	enum State : uint8_t
+	{
+		kUnclaimed,
+		kClaimed,
+		kReleased
+	};
+
+	~ThreadSlotHolder()
+	{
+		if(CurrentState == kClaimed)
+		{
+			s_claimedSlots.fetch_and(~(uint64_t(1) << Slot), std::memory_order_release);
+		}
+		// anything that runs after this during thread teardown has to take the shared path rather than
+		// claiming a slot that would never be released.
+		CurrentState = kReleased;
+		Slot = ThreadSlot::Invalid;
+	}
+
+	size_t Slot{ ThreadSlot::Invalid };
+	State CurrentState{ kUnclaimed };
+};
+
+static thread_local ThreadSlotHolder tl_slot;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t ThreadSlot::Get()
+{
+	if(tl_slot.CurrentState != ThreadSlotHolder::kUnclaimed)
+	{
+		return tl_slot.Slot;
+	}
+
+	uint64_t claimed = s_claimedSlots.load(std::memory_order_relaxed);
+	while(claimed != ~uint64_t(0))
+	{
+		size_t slot = 0;
+		while(claimed & (uint64_t(1) << slot))
+		{
+			++slot;
+		}
+		if(s_claimedSlots.compare_exchange_weak(claimed, claimed | (uint64_t(1) << slot), std::memory_order_acquire))
+		{
+			tl_slot.Slot = slot;
+			tl_slot.CurrentState = ThreadSlotHolder::kClaimed;
+			return slot;
+		}
+	}
+
+	// every slot is taken. stay unclaimed so that the next call tries again.
+	return Invalid;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t ThreadSlot::GetNumClaimed()
+{
+	uint64_t claimed = s_claimedSlots.load(std::memory_order_relaxed);
+	size_t count = 0;
+	while(claimed)
+	{
+		claimed &= claimed - 1;
+		++count;
+	}
+	return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ThreadSlot
+//
+//  Hands every thread a small index that per-thread storage can be keyed off of.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBCORE_THREADSLOT_H_
+#define LIBCORE_THREADSLOT_H_
+#pragma once
+
+#include "libCore.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class ThreadSlot
+
+	Every thread that asks gets a unique index in [0, ThreadSlot::MaxSlots). The index belongs to the thread until
+	it exits, at which point it goes back up for grabs. Containers that want per-thread state without paying for a
+	thread_local per instance can keep a fixed array of MaxSlots entries and index it with ThreadSlot::Get.
+
+	\note Whatever was left in a slot by a thread that exited is inherited by the next thread that picks it up.
+	\note When every slot is taken ThreadSlot::Get returns ThreadSlot::Invalid. Callers need a shared fallback path.
+ **/
+struct ThreadSlot final
+{
+	static const size_t MaxSlots = 64;
+	static const size_t Invalid = ~size_t(0);
+
+	/**
+		Retrieve the slot for the calling thread, claiming one if this is the first time it has asked.
+	 **/
+	static size_t Get();
+
+	/**
+		Retrieve the number of slots that are currently owned by a live thread.
+	 **/
+	static size_t GetNumClaimed();
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -9,31 +9,63 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #include "stdafx.h"
 #include "UUIDMgr.h"
+#include "Assert.h"
 
 #ifdef FIRE_PLATFORM_WINDOWS
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #endif
 
+#ifdef FIRE_PLATFORM_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 OPEN_NAMESPACE(Firestorm);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+	The IDs the calling thread took for itself. Batches are tagged with the instance of the UUIDMgr they came out
+	of rather than its address, so a batch left over from a UUIDMgr that has since been destroyed never gets
+	mistaken for one belonging to a new UUIDMgr that happens to live at the same address.
+ **/
+struct UUIDBatch
+{
+	uint64_t Owner;
+	char*    Next;
+	char*    End;
+};
+
+// the reserved space costs nothing until it's touched, so reserve plenty at a time.
+static const size_t s_reservationSize = 64 * 1024 * 1024;
+
+static atomic<uint64_t> s_nextInstance{ 1 };
+
+static thread_local UUIDBatch tl_batch{ 0, nullptr, nullptr };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 UUIDMgr::UUIDMgr()
 : _systemPageSize(GetSystemPageSize())
+, _reservationSize((s_reservationSize + _systemPageSize - 1) / _systemPageSize * _systemPageSize)
+, _instance(s_nextInstance.fetch_add(1, std::memory_order_relaxed))
 {
-	_trackedPages.reserve(20);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 UUIDMgr::~UUIDMgr()
 {
-	for(size_t i=0; i<_trackedPages.size(); ++i)
+	Reservation* reservation = _current.load(std::memory_order_acquire);
+	while(reservation)
 	{
-		Free(_trackedPages[i]);
+		Reservation* next = reservation->Next;
+		Free(reservation->Base);
+		delete reservation;
+		reservation = next;
 	}
 }
 
@@ -41,12 +73,79 @@ UUIDMgr::~UUIDMgr()
 
 UUID UUIDMgr::Get() const
 {
-	if(!_uuidBlock || _numIDsUsed == _systemPageSize)
+	UUIDBatch& batch = tl_batch;
+	if(batch.Owner != _instance || batch.Next == batch.End)
 	{
-		_uuidBlock = Alloc();
-		_numIDsUsed = 0;
+		size_t numTaken;
+		char* first = Take(BatchSize, numTaken);
+		batch = UUIDBatch{ _instance, first, first + numTaken };
+	}
+	return reinterpret_cast<UUID>(batch.Next++);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void UUIDMgr::Get(UUID* out, size_t count) const
+{
+	UUIDBatch& batch = tl_batch;
+	while(count > 0)
+	{
+		if(batch.Owner == _instance && batch.Next != batch.End)
+		{
+			const size_t numFromBatch = eastl::min(count, static_cast<size_t>(batch.End - batch.Next));
+			for(size_t i = 0; i < numFromBatch; ++i)
+			{
+				*out++ = reinterpret_cast<UUID>(batch.Next++);
+			}
+			count -= numFromBatch;
+		}
+		else if(count >= BatchSize)
+		{
+			size_t numTaken;
+			char* first = Take(count, numTaken);
+			for(size_t i = 0; i < numTaken; ++i)
+			{
+				*out++ = reinterpret_cast<UUID>(first + i);
+			}
+			count -= numTaken;
+		}
+		else
+		{
+			size_t numTaken;
+			char* first = Take(BatchSize, numTaken);
+			batch = UUIDBatch{ _instance, first, first + numTaken };
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+char* UUIDMgr::Take(size_t count, size_t& numTaken) const
+{
+	for(;;)
+	{
+		Reservation* reservation = _current.load(std::memory_order_acquire);
+		if(reservation)
+		{
+			const size_t start = reservation->NumUsed.fetch_add(count, std::memory_order_relaxed);
+			if(start < _reservationSize)
+			{
+				numTaken = eastl::min(count, _reservationSize - start);
+				return reservation->Base + start;
+			}
+		}
+
+		// the reservation has run out. whoever manages to swap theirs in first wins, everybody else gives theirs
+		// back and takes from the winner's.
+		char* base = static_cast<char*>(Alloc());
+		FIRE_ASSERT_MSG(base != nullptr, "UUIDMgr couldn't reserve any more address space");
+		Reservation* fresh = new Reservation(base, reservation);
+		if(!_current.compare_exchange_strong(reservation, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			Free(base);
+			delete fresh;
+		}
 	}
-	return (UUIDType*)((char*)_uuidBlock + _numIDsUsed++);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -60,24 +159,47 @@ size_t UUIDMgr::GetSystemPageSize() const
 }
 #endif
 
+#ifdef FIRE_PLATFORM_UNIX
+size_t UUIDMgr::GetSystemPageSize() const
+{
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifdef FIRE_PLATFORM_WINDOWS
 void* UUIDMgr::Alloc() const
 {
-	return VirtualAlloc(nullptr, _systemPageSize, MEM_RESERVE, PAGE_READONLY);
+	return VirtualAlloc(nullptr, _reservationSize, MEM_RESERVE, PAGE_NOACCESS);
+}
+#endif
+
+#ifdef FIRE_PLATFORM_UNIX
+void* UUIDMgr::Alloc() const
+{
+	// PROT_NONE and MAP_NORESERVE keep this to address space only, nothing is ever committed behind it.
+	void* mapping = mmap(nullptr, _reservationSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return mapping != MAP_FAILED ? mapping : nullptr;
 }
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifdef FIRE_PLATFORM_WINDOWS
-void UUIDMgr::Free(void* pageStart)
+void UUIDMgr::Free(void* pageStart) const
 {
 	VirtualFree(pageStart, 0, MEM_RELEASE);
 }
 #endif
 
+#ifdef FIRE_PLATFORM_UNIX
+void UUIDMgr::Free(void* pageStart) const
+{
+	munmap(pageStart, _reservationSize);
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-CLOSE_NAMESPACE(Firestorm);
\ No newline at end of file
+CLOSE_NAMESPACE(Firestorm);
@@ -16,23 +16,61 @@ OPEN_NAMESPACE(Firestorm);
 struct UUIDType {}; // void* doesn't play nice with the SOA.
 using UUID = UUIDType*;
 
+/**
+	\class UUIDMgr
+
+	Hands out IDs that are addresses inside of address space that's reserved but never committed, so they cost
+	no memory and can never collide with anything else in the process.
+
+	The reserved space is handed out with an atomic bump, and every thread takes its IDs out of a batch of
+	BatchSize that it grabs for itself, so threads only ever touch shared state once per batch and never block
+	each other.
+ **/
 class UUIDMgr final
 {
 public:
+	// how many IDs a thread takes for itself at a time.
+	static const size_t BatchSize = 256;
+
 	UUIDMgr();
 	~UUIDMgr();
 
+	/**
+		Retrieve a new ID. Safe to call from any thread.
+	 **/
 	UUID Get() const;
 
+	/**
+		Retrieve \c count new IDs into \c out. Safe to call from any thread. Requests of at least BatchSize are
+		taken from the reserved space in one go rather than a batch at a time.
+	 **/
+	void Get(UUID* out, size_t count) const;
+
 private:
+	struct Reservation
+	{
+		Reservation(char* base, Reservation* next)
+		: Base(base)
+		, Next(next)
+		{
+		}
+
+		char*          Base;
+		atomic<size_t> NumUsed{ 0 };
+		Reservation*   Next;
+	};
+
+	// bump up to \c count IDs off of the current reservation, starting a new one if it has run out.
+	char* Take(size_t count, size_t& numTaken) const;
+
 	size_t GetSystemPageSize() const;
 	void* Alloc() const;
-	void Free(void* pageStart);
+	void Free(void* pageStart) const;
 
 	size_t _systemPageSize;
-	mutable void* _uuidBlock{ nullptr };
-	mutable size_t _numIDsUsed{ 0 };
-	vector<void*> _trackedPages;
+	size_t _reservationSize;
+	uint64_t _instance;
+	mutable atomic<Reservation*> _current{ nullptr };
 };
 
 
@@ -1,7 +1,10 @@
 #include "stdafx.h"
 #include "libCore.h"
+#include "Allocator.h"
+#include "MemoryTracker.h"
 #include "Logger.h"
 #include <sstream>
+#include <new>
 #include <EASTL/string.h>
 #include "Assert.h"
 
@@ -37,6 +40,10 @@ typedef struct tagTHREADNAME_INFO
 } THREADNAME_INFO;
 #pragma pack(pop)
 #endif
+
+#ifdef FIRE_PLATFORM_UNIX
+#include <pthread.h>
+#endif
 OPEN_NAMESPACE(Firestorm);
 
 #ifdef FIRE_PLATFORM_WINDOWS
@@ -57,23 +64,74 @@ void libCore::SetThreadName(thread& thread, const string& name)
 }
 #endif
 
+#ifdef FIRE_PLATFORM_UNIX
+void libCore::SetThreadName(thread& thread, const string& name)
+{
+	// linux caps thread names at 16 characters including the terminator.
+	string truncated(name.substr(0, 15));
+	pthread_setname_np(thread.native_handle(), truncated.c_str());
+}
+#endif
+
+static thread_local size_t tl_numAllocations = 0;
+
+// callsite is whoever called into libCore (or operator new), so that the tracker can tell allocations apart.
+static inline void* AllocateTracked(size_t sizeInBytes, size_t alignment, const void* callsite)
+{
+	++tl_numAllocations;
+	void* block = Allocator::Allocate(sizeInBytes, alignment);
+#ifdef FIRE_MEMORY_TRACKING
+	if(block)
+	{
+		MemoryTracker::OnAllocate(block, sizeInBytes, callsite);
+	}
+#endif
+	return block;
+}
+
+static inline void FreeTracked(void* block)
+{
+#ifdef FIRE_MEMORY_TRACKING
+	if(block)
+	{
+		MemoryTracker::OnFree(block);
+	}
+#endif
+	Allocator::Free(block);
+}
+
 void* libCore::Alloc(size_t sizeInBytes)
 {
-	return malloc(sizeInBytes);
+	return AllocateTracked(sizeInBytes, Allocator::MinAlignment, FIRE_RETURN_ADDRESS());
 }
 
 void* libCore::AlignedAlloc(size_t sizeInBytes, size_t alignment)
 {
-	return malloc(sizeInBytes);
+	return AllocateTracked(sizeInBytes, alignment, FIRE_RETURN_ADDRESS());
 }
 
 void libCore::Free(void* block)
 {
-	free(block);
+	FreeTracked(block);
+}
+
+size_t libCore::GetNumThreadAllocations()
+{
+	return tl_numAllocations;
+}
+
+void libCore::MarkMemoryBaseline()
+{
+#ifdef FIRE_MEMORY_TRACKING
+	MemoryTracker::MarkBaseline();
+#endif
 }
 
 void libCore::ReportMemoryLeaks()
 {
+#ifdef FIRE_MEMORY_TRACKING
+	MemoryTracker::ReportLeaks();
+#endif
 }
 
 vector<string> SplitString(const string & str, char delim)
@@ -103,12 +161,102 @@ CLOSE_NAMESPACE(Firestorm);
 // support for EASTL
 void* operator new[](size_t size, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
 {
-	return ::Firestorm::libCore::AlignedAlloc(size, 16);
+	return ::Firestorm::AllocateTracked(size, 16, FIRE_RETURN_ADDRESS());
 }
 
 void* operator new[](size_t size, size_t alignment, size_t alignmentOffset, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
 {
-	return ::Firestorm::libCore::AlignedAlloc(size, alignment);
+	return ::Firestorm::AllocateTracked(size, alignment, FIRE_RETURN_ADDRESS());
+}
+
+// EASTL hands its memory back through operator delete[], so the array forms have to go through libCore no matter
+// what, and so does everything that's allocated with them.
+void* operator new[](size_t size)
+{
+	void* p = ::Firestorm::AllocateTracked(size, ::Firestorm::Allocator::MinAlignment, FIRE_RETURN_ADDRESS());
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return ::Firestorm::AllocateTracked(size, ::Firestorm::Allocator::MinAlignment, FIRE_RETURN_ADDRESS());
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	void* p = ::Firestorm::AllocateTracked(size, static_cast<size_t>(alignment), FIRE_RETURN_ADDRESS());
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return ::Firestorm::AllocateTracked(size, static_cast<size_t>(alignment), FIRE_RETURN_ADDRESS());
+}
+
+void operator delete[](void* p) EA_THROW_SPEC_DELETE_NONE()
+{
+	::Firestorm::libCore::Free(p);
+}
+
+void operator delete[](void* p, size_t) EA_THROW_SPEC_DELETE_NONE()
+{
+	::Firestorm::libCore::Free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) EA_THROW_SPEC_DELETE_NONE()
+{
+	::Firestorm::libCore::Free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	::Firestorm::libCore::Free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+	::Firestorm::libCore::Free(p);
+}
+
+// replacing the plain forms puts every allocation in the app under the tracker, third party code included. That's
+// opt in, since it's not up to a library to take over operator new for whoever links it.
+#ifdef FIRE_REPLACE_GLOBAL_NEW
+void* operator new(size_t size)
+{
+	void* p = ::Firestorm::AllocateTracked(size, ::Firestorm::Allocator::MinAlignment, FIRE_RETURN_ADDRESS());
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return ::Firestorm::AllocateTracked(size, ::Firestorm::Allocator::MinAlignment, FIRE_RETURN_ADDRESS());
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* p = ::Firestorm::AllocateTracked(size, static_cast<size_t>(alignment), FIRE_RETURN_ADDRESS());
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return ::Firestorm::AllocateTracked(size, static_cast<size_t>(alignment), FIRE_RETURN_ADDRESS());
 }
 
 void operator delete(void* p) EA_THROW_SPEC_DELETE_NONE()
@@ -116,7 +264,23 @@ void operator delete(void* p) EA_THROW_SPEC_DELETE_NONE()
 	::Firestorm::libCore::Free(p);
 }
 
-void operator delete[](void* p) EA_THROW_SPEC_DELETE_NONE()
+void operator delete(void* p, size_t) EA_THROW_SPEC_DELETE_NONE()
+{
+	::Firestorm::libCore::Free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) EA_THROW_SPEC_DELETE_NONE()
+{
+	::Firestorm::libCore::Free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
 {
 	::Firestorm::libCore::Free(p);
-}
\ No newline at end of file
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+	::Firestorm::libCore::Free(p);
+}
+#endif
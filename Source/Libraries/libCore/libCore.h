@@ -59,6 +59,11 @@ struct libCore : public Library<libCore>
 
 	static void Free(void* block);
 
+	/**
+		Retrieve the number of allocations the calling thread has made through libCore so far.
+	 **/
+	static size_t GetNumThreadAllocations();
+
 	template<class T>
 	static void Delete(T* ptr)
 	{
@@ -66,6 +71,15 @@ struct libCore : public Library<libCore>
 		Free(ptr);
 	}
 
+	/**
+		Allocations that are live when this is called aren't reported as leaks by ReportMemoryLeaks.
+	 **/
+	static void MarkMemoryBaseline();
+
+	/**
+		Log every allocation made since MarkMemoryBaseline that hasn't been freed, grouped by callsite and
+		MemoryTag. Does nothing in FIRE_FINAL, where memory isn't tracked.
+	 **/
 	static void ReportMemoryLeaks();
 
 private:
@@ -11,10 +11,13 @@
 #define LIBEXISTENCE_COMPONENTDEFINITION_H_
 #pragma once
 
-#include <libCore/SOA.h>
+#include <libCore/Hash.h>
+#include <libCore/StringId.h>
+#include <libCore/Metrics.h>
 #include <EASTL/bonus/tuple_vector.h>
 
 #include "Entity.h"
+#include "ComponentStorage.h"
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -24,26 +27,12 @@ OPEN_NAMESPACE(Firestorm);
 	FIRE_ASSERT_MSG(i != FIRE_INVALID_COMPONENT, "the component is invalid "\
 		"(side note... what the *actual* *hell* are you doing where you made *that* *many* components?!)")
 
-struct ComponentIDType
-{
-public:
-	ComponentIDType(const char* name)
-		: _hash(eastl::hash<string>()(name))
-		, _name(name)
-	{}
-
-	operator size_t() const { return _hash; }
-private:
-	size_t _hash{ 0 };
-	const char* _name;
-};
-
-using ComponentID = const ComponentIDType&;
+using ComponentID = StringId;
 
 #define FIRE_COMPONENT(TYPE)                   \
 	virtual ComponentID ID() const             \
 	{                                          \
-		static ComponentIDType _id {#TYPE};    \
+		static const ComponentID _id {#TYPE};  \
 		return _id;                            \
 	}                                          \
 
@@ -54,13 +43,6 @@ public:
 
 	using Instance = size_t;
 
-protected:
-	/**
-		Make a new instance of the component.
-	**/
-	virtual Instance MakeNew() = 0;
-
-public:
 	/**
 		Enumeration that defines different ways the destruction of entities can be handled by a component.
 		A component should only lock itself into one type of destruction handler.
@@ -70,7 +52,8 @@ public:
 		//< Used to signify that the component requires immediate attention when Entities are destroyed.
 		kImmediate,
 
-		//< A simple garbage collector is fine for this component.
+		//< A simple garbage collector is fine for this component. The rows of dead entities get cleaned up a
+		//< few at a time by EntityMgr::CollectGarbage, with no callbacks.
 		kGC
 	};
 
@@ -105,10 +88,37 @@ public:
 	 **/
 	virtual void Clear() = 0;
 
+	/**
+		How much work the garbage collector has done on a kGC component. Times are in nanoseconds.
+	 **/
+	struct GCStats
+	{
+		uint64_t NumChecked{ 0 };
+		uint64_t NumCollected{ 0 };
+		uint64_t NumSweeps{ 0 };   // times the collector has made it all the way through the rows.
+		uint64_t LastTime{ 0 };    // how long the last call to Collect took.
+		uint64_t TotalTime{ 0 };
+	};
+
+	/**
+		Check up to \c maxRows rows for entities that have died and erase the ones that have, picking up where
+		the last call left off. Stops early once Metrics::GetTime passes \c deadline. Called once a frame by
+		EntityMgr::CollectGarbage for kGC components.
+
+		\return The number of rows that were checked.
+	 **/
+	virtual size_t Collect(size_t maxRows, uint64_t deadline) { return 0; }
+
 	/**
 		Retrieve thhe way this component should handle it when entities are destroyed.
 	 **/
 	DestructionHandler GetDestructionHandler() const { return _dest; }
+
+	const GCStats& GetGCStats() const { return _gcStats; }
+
+protected:
+	GCStats _gcStats;
+
 private:
 	DestructionHandler _dest;
 };
@@ -117,9 +127,12 @@ private:
 	\brief A component definition with the first SOA index being an Entity.
 
 	This is pretty much the default component definition that you'll be getting the most
-	use out of. The first template parameter specifies the mapping key (likely an Entity ;) )
-	and the rest are the members. Uses the SOA container internally and exposes it
-	with the member \c _this to your superclasses.
+	use out of. The template parameters are the members. Uses a ComponentStorage indexed by
+	the Entity internally and exposes it with the member \c _this to your superclasses, so the
+	instances stay tightly packed as entities come and go.
+
+	\warning An Instance is a row index, and removing an entity moves the last row into the
+	removed one. Look the Instance up again after entities have been removed.
  **/
 template<class... Members>
 class Component : public IComponent
@@ -133,76 +146,115 @@ public:
 	{
 		if(GetDestructionHandler() == DestructionHandler::kImmediate)
 		{
-			_eMgr.RegisterDestructionCallback(this, [this](Entity entity) {
-				// lookup the index of the provided entity
-				Instance i = Lookup(entity);
-				Entity lastEntity = _this[0_soa][_this.size()-1];
-
-				_this.erase(_this.begin()+i);
-				_map.erase(entity);
+			_eMgr.RegisterDestructionCallback(this, [this](span<const Entity> entities) {
+				_this.EraseBulk(entities);
 			});
 		}
+		else
+		{
+			_eMgr.RegisterCollectable(this);
+		}
 	}
 
 	virtual ~Component()
 	{
 		if(GetDestructionHandler() == DestructionHandler::kImmediate)
 			_eMgr.UnregisterDestructionCallback(this);
+		else
+			_eMgr.UnregisterCollectable(this);
 	}
 
 	virtual Instance Lookup(Entity entity) final
 	{
-		auto found = _map.find(entity);
-		if(found == _map.end())
-		{
-			return FIRE_INVALID_COMPONENT;
-		}
-		return found->second;
+		Instance i = _this.Find(entity);
+		return i != Storage::InvalidIndex ? i : FIRE_INVALID_COMPONENT;
 	}
 
 	virtual bool Contains(Entity entity) final
 	{
-		return _map.find(entity) != _map.end();
+		return _this.Contains(entity);
 	}
 
 	virtual Instance Assign(Entity entity) final
 	{
-		if(Contains(entity))
+		Instance i = _this.Find(entity);
+		if(i != Storage::InvalidIndex)
 		{
-			return _map[entity];
+			return i;
 		}
-		Instance i = MakeNew();
+		i = _this.Insert(entity);
 
 		FIRE_VALIDATE_COMPONENT(i);
-
-		_this[0_soa][i] = entity;
-		_map[entity] = i;
 		return i;
 	}
 
 	virtual void Clear()
 	{
-		_this.clear();
-		_map.clear();
+		_this.Clear();
+		_gcCursor = 0;
 	}
 
-private:
-	virtual Instance MakeNew() final
+	virtual size_t Collect(size_t maxRows, uint64_t deadline) final
+	{
+		const uint64_t start = Metrics::GetTime();
+		size_t numChecked = 0;
+		while(numChecked < maxRows && !_this.Empty())
+		{
+			// the clock isn't free, so it's only looked at every so often.
+			if((numChecked & 63) == 63 && Metrics::GetTime() >= deadline)
+			{
+				break;
+			}
+			if(_gcCursor >= _this.Size())
+			{
+				_gcCursor = 0;
+				++_gcStats.NumSweeps;
+			}
+
+			++numChecked;
+			if(_eMgr.IsAlive(_this.GetEntity(_gcCursor)))
+			{
+				++_gcCursor;
+			}
+			else
+			{
+				// the last row moves into this one, so the cursor stays put to check it next.
+				_this.EraseAt(_gcCursor);
+				++_gcStats.NumCollected;
+			}
+		}
+
+		_gcStats.NumChecked += numChecked;
+		_gcStats.LastTime = Metrics::GetTime() - start;
+		_gcStats.TotalTime += _gcStats.LastTime;
+		return numChecked;
+	}
+
+	/**
+		Append a snapshot of every instance to \c out, entities included. See SOA::SaveColumns.
+	 **/
+	void SaveColumns(vector<char>& out) const
 	{
-		_this.push_back_uninitialized();
-		return MakeNew(_this.size()-1);
+		_this.SaveColumns(out);
 	}
 
-	Instance MakeNew(size_t i)
+	/**
+		Replace every instance with the ones in the snapshot in \c data.
+
+		\note The entities are restored as they were saved. Restore the EntityMgr they came from along with them.
+	 **/
+	Result<void, Error> LoadColumns(span<const char> data)
 	{
-		return i;
+		return _this.LoadColumns(data);
 	}
 
+private:
 	EntityMgr& _eMgr;
+	size_t     _gcCursor{ 0 };
 
-	unordered_map<Entity, Instance> _map;
 protected:
-	SOA<Entity, Members...> _this;
+	using Storage = ComponentStorage<Members...>;
+	Storage _this;
 };
 
 CLOSE_NAMESPACE(Firestorm);
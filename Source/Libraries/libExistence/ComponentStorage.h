@@ -0,0 +1,379 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ComponentStorage
+//
+//  A sparse set that maps entities to tightly packed rows of component data.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBEXISTENCE_COMPONENTSTORAGE_H_
+#define LIBEXISTENCE_COMPONENTSTORAGE_H_
+#pragma once
+
+#include <libCore/SOA.h>
+#include <libCore/RefPtr.h>
+
+#include <EASTL/span.h>
+
+#include "Entity.h"
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	\class ComponentStorage
+
+	The rows of a component, stored as a sparse set. The rows live in a structure of arrays with the Entity as
+	column 0 and the members after it, and are always tightly packed: inserting appends a row and erasing moves
+	the last row into the hole (swap and pop).
+
+	Entities are mapped to rows with a sparse array indexed by Entity::Index(). The sparse array is split into
+	pages of PageSize entries that are only allocated while an entity in their range has a row, so the memory
+	used follows the number of rows rather than the highest entity index. Looking an entity up reads its sparse
+	entry, then the Entity in that row to make sure the generation matches, so a despawned entity never finds
+	the row of whatever entity reused its index.
+
+	\note An entity index only ever has one row. Inserting an entity whose index still has a row from an older
+	generation erases that row first, since the entity it belonged to is gone.
+	\warning Never write to the Entity column directly, the entity to row mapping would go out of sync.
+	\warning Inserting and erasing invalidate the column pointers, and erasing invalidates row indices. Don't do
+	either from inside of ForEach.
+ **/
+template<class... Ts>
+class ComponentStorage final
+{
+	using SOAType = SOA<Entity, Ts...>;
+public:
+	static constexpr size_t InvalidIndex = eastl::numeric_limits<size_t>::max();
+	static const size_t PageBits = 12;
+	static const size_t PageSize = 1 << PageBits;
+
+	ComponentStorage() {}
+	~ComponentStorage() = default;
+
+	size_t Size() const { return _soa.size(); }
+	bool Empty() const { return _soa.size() == 0; }
+
+	/**
+		Retrieve the number of sparse pages that are allocated right now.
+	 **/
+	size_t GetNumPages() const { return _numPages; }
+
+	/**
+		Make room for \c numRows rows without reallocating.
+	 **/
+	void Reserve(size_t numRows)
+	{
+		_soa.reserve(numRows);
+	}
+
+	/**
+		Remove every row and free every sparse page.
+	 **/
+	void Clear()
+	{
+		_soa.clear();
+		_pages.clear();
+		_numPages = 0;
+	}
+
+	bool Contains(Entity entity) const
+	{
+		return Find(entity) != InvalidIndex;
+	}
+
+	/**
+		Retrieve the row index of \c entity, or InvalidIndex if it doesn't have one.
+	 **/
+	size_t Find(Entity entity) const
+	{
+		const uint32_t row = GetRow(entity.Index());
+		if(row == kNoRow || _soa.template get<0>()[row].id != entity.id)
+		{
+			return InvalidIndex;
+		}
+		return row;
+	}
+
+	Entity GetEntity(size_t index) const
+	{
+		FIRE_ASSERT_MSG(index < Size(), Format("index '%zu' out of bounds", index));
+		return _soa.template get<0>()[index];
+	}
+
+	/**
+		Append a row for \c entity with its members default constructed.
+
+		\return The index of the new row.
+	 **/
+	size_t Insert(Entity entity)
+	{
+		const size_t index = MakeRoomFor(entity);
+		_soa.push_back();
+		_soa.template get<0>()[index] = entity;
+		SetRow(entity.Index(), static_cast<uint32_t>(index));
+		return index;
+	}
+
+	/**
+		Append a row for \c entity with its members copied from \c members.
+
+		\return The index of the new row.
+	 **/
+	size_t Insert(Entity entity, const Ts&... members)
+	{
+		const size_t index = MakeRoomFor(entity);
+		_soa.push_back(entity, members...);
+		SetRow(entity.Index(), static_cast<uint32_t>(index));
+		return index;
+	}
+
+	/**
+		Insert a default constructed row for every entity in \c entities that doesn't have one yet.
+
+		\return The number of rows that were inserted.
+	 **/
+	size_t InsertBulk(eastl::span<const Entity> entities)
+	{
+		Reserve(Size() + entities.size());
+		size_t numInserted = 0;
+		for(Entity entity : entities)
+		{
+			if(!Contains(entity))
+			{
+				Insert(entity);
+				++numInserted;
+			}
+		}
+		return numInserted;
+	}
+
+	/**
+		Erase the row of \c entity by moving the last row into its place.
+
+		\return Whether or not \c entity had a row.
+	 **/
+	bool Erase(Entity entity)
+	{
+		const size_t index = Find(entity);
+		if(index == InvalidIndex)
+		{
+			return false;
+		}
+		EraseAt(index);
+		return true;
+	}
+
+	/**
+		Erase the row at \c index by moving the last row into its place.
+	 **/
+	void EraseAt(size_t index)
+	{
+		FIRE_ASSERT_MSG(index < Size(), Format("index '%zu' out of bounds", index));
+		const Entity* entities = _soa.template get<0>();
+		const size_t last = _soa.size() - 1;
+
+		ClearRow(entities[index].Index());
+		if(index != last)
+		{
+			SetRow(entities[last].Index(), static_cast<uint32_t>(index));
+		}
+		_soa.erase_unsorted(_soa.begin() + index);
+	}
+
+	/**
+		Erase the rows of every entity in \c entities. Entities without a row are skipped.
+
+		\return The number of rows that were erased.
+	 **/
+	size_t EraseBulk(eastl::span<const Entity> entities)
+	{
+		size_t numErased = 0;
+		for(Entity entity : entities)
+		{
+			numErased += Erase(entity) ? 1 : 0;
+		}
+		return numErased;
+	}
+
+	/**
+		Call \c func(entity, members...) for every row, in the order that the rows are stored in. The members are
+		passed by reference and can be modified.
+	 **/
+	template<class Func_t>
+	void ForEach(Func_t&& func)
+	{
+		ForEachImpl(func, eastl::make_index_sequence<sizeof...(Ts)>());
+	}
+
+	template<class Func_t>
+	void ForEach(Func_t&& func) const
+	{
+		ForEachImpl(func, eastl::make_index_sequence<sizeof...(Ts)>());
+	}
+
+	/**
+		Walk the selected columns a chunk at a time, see SOA::ForEachChunk. Column 0 holds the entities.
+	 **/
+	template<size_t... I, class Func_t>
+	void ForEachChunk(soa_columns<I...> columns, Func_t&& func, size_t chunkSize = 0)
+	{
+		_soa.ForEachChunk(columns, func, chunkSize);
+	}
+
+	/**
+		Walk the selected columns a chunk at a time on every thread of \c jobSystem, see SOA::ParallelForEach.
+	 **/
+	template<size_t... I, class Func_t>
+	void ParallelForEach(JobSystem& jobSystem, soa_columns<I...> columns, Func_t&& func, size_t chunkSize = 0)
+	{
+		_soa.ParallelForEach(jobSystem, columns, func, chunkSize);
+	}
+
+	/**
+		Append a snapshot of every column, entities included, to \c out. See SOA::SaveColumns.
+	 **/
+	void SaveColumns(vector<char>& out) const
+	{
+		_soa.SaveColumns(out);
+	}
+
+	/**
+		Replace the contents of the container with the snapshot in \c data. The sparse array is rebuilt from the
+		entity column. On failure the container is left empty.
+	 **/
+	Result<void, Error> LoadColumns(span<const char> data)
+	{
+		Clear();
+		Result<void, Error> result = _soa.LoadColumns(data);
+		if(!result)
+		{
+			return result;
+		}
+
+		const Entity* entities = _soa.template get<0>();
+		const size_t size = _soa.size();
+		for(size_t i = 0; i < size; ++i)
+		{
+			if(GetRow(entities[i].Index()) != kNoRow)
+			{
+				Clear();
+				return FIRE_ERROR(SOASnapshotErrors::DUPLICATE_KEY, Format("row %zu repeats an earlier entity", i));
+			}
+			SetRow(entities[i].Index(), static_cast<uint32_t>(i));
+		}
+		return result;
+	}
+
+	/**
+		Retrieve the column at \c I. Column 0 holds the entities.
+	 **/
+	template<size_t I>
+	const eastl::TupleVecInternal::tuplevec_element_t<I, Entity, Ts...>* operator[](soa_index<I> index) const
+	{
+		return _soa[index];
+	}
+
+	template<size_t I>
+	eastl::TupleVecInternal::tuplevec_element_t<I, Entity, Ts...>* operator[](soa_index<I> index)
+	{
+		return _soa[index];
+	}
+
+private:
+	static const uint32_t kNoRow = 0xFFFFFFFF;
+
+	struct Page
+	{
+		uint32_t Rows[PageSize];
+		size_t   NumUsed;
+	};
+
+	uint32_t GetRow(EntityID index) const
+	{
+		const EntityID page = index >> PageBits;
+		if(page >= _pages.size() || !_pages[static_cast<size_t>(page)])
+		{
+			return kNoRow;
+		}
+		return _pages[static_cast<size_t>(page)]->Rows[index & (PageSize - 1)];
+	}
+
+	// point the sparse entry for \c index at \c row, allocating its page if it hasn't been yet.
+	void SetRow(EntityID index, uint32_t row)
+	{
+		const size_t page = static_cast<size_t>(index >> PageBits);
+		if(page >= _pages.size())
+		{
+			_pages.resize(page + 1);
+		}
+		if(!_pages[page])
+		{
+			_pages[page].reset(new Page);
+			memset(_pages[page]->Rows, 0xFF, sizeof(_pages[page]->Rows));
+			_pages[page]->NumUsed = 0;
+			++_numPages;
+		}
+
+		uint32_t& entry = _pages[page]->Rows[index & (PageSize - 1)];
+		_pages[page]->NumUsed += entry == kNoRow ? 1 : 0;
+		entry = row;
+	}
+
+	// empty the sparse entry for \c index, and free its page once nothing in it is used.
+	void ClearRow(EntityID index)
+	{
+		const size_t page = static_cast<size_t>(index >> PageBits);
+		_pages[page]->Rows[index & (PageSize - 1)] = kNoRow;
+		if(--_pages[page]->NumUsed == 0)
+		{
+			_pages[page].reset();
+			--_numPages;
+		}
+	}
+
+	// the row that an insert of \c entity is going to land in, once a row left behind by an older generation is gone.
+	size_t MakeRoomFor(Entity entity)
+	{
+		FIRE_ASSERT_MSG(Contains(entity) == false, "can not double insert an entity...");
+		FIRE_ASSERT_MSG(_soa.size() < kNoRow, "ComponentStorage only covers 2^32 - 1 rows");
+		const uint32_t stale = GetRow(entity.Index());
+		if(stale != kNoRow)
+		{
+			EraseAt(stale);
+		}
+		return _soa.size();
+	}
+
+	template<class Func_t, size_t... Is>
+	void ForEachImpl(Func_t& func, eastl::index_sequence<Is...>)
+	{
+		const Entity* entities = _soa.template get<0>();
+		auto columns = eastl::make_tuple(_soa.template get<Is + 1>()...);
+		const size_t size = _soa.size();
+		for(size_t i = 0; i < size; ++i)
+		{
+			func(entities[i], eastl::get<Is>(columns)[i]...);
+		}
+	}
+
+	template<class Func_t, size_t... Is>
+	void ForEachImpl(Func_t& func, eastl::index_sequence<Is...>) const
+	{
+		const Entity* entities = _soa.template get<0>();
+		auto columns = eastl::make_tuple(_soa.template get<Is + 1>()...);
+		const size_t size = _soa.size();
+		for(size_t i = 0; i < size; ++i)
+		{
+			func(entities[i], eastl::get<Is>(columns)[i]...);
+		}
+	}
+
+	SOAType                  _soa;
+	vector<UniquePtr<Page>>  _pages;
+	size_t                   _numPages{ 0 };
+};
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -13,32 +13,41 @@
 #include "ComponentDefinition.h"
 
 #include <libCore/Logger.h>
+#include <libCore/MemoryTracker.h>
+#include <libCore/Metrics.h>
+#include <libCore/Profiler.h>
 
 OPEN_NAMESPACE(Firestorm);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-EntityMgr::EntityMgr(UUIDMgr& uuidMgr)
+EntityMgr::EntityMgr(UUIDMgr& uuidMgr, SpawnMode mode)
+: _mode(mode)
+, _generations(new atomic<GenerationPage*>[MaxGenerationPages]())
 {
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-Entity EntityMgr::SpawnEntity(EntityData* data)
+EntityMgr::~EntityMgr()
 {
-	EntityID idx;
-	if(_freeIndices.size() > 1024)
+	for(size_t i = 0; i < MaxGenerationPages; ++i)
 	{
-		idx = _freeIndices.front();
-		_freeIndices.pop_front();
+		delete _generations[i].load(std::memory_order_relaxed);
 	}
-	else
-	{
-		idx = _generation.size();
-		_generation.push_back(0);
-		FIRE_ASSERT(idx < (1 << ENT_INDEX_BITS));
-	}
-	Entity out{ idx, _generation[idx] };
+	delete[] _generations;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Entity EntityMgr::SpawnEntity(EntityData* data)
+{
+	FIRE_MEMORY_TAG(ECS);
+	static MetricCounter& numSpawned = Metrics::GetCounter("ecs.entities.spawned");
+	numSpawned.Add();
+
+	const EntityID idx = SpawnIndex();
+	Entity out{ idx, GetGeneration(idx).load(std::memory_order_relaxed) };
 	//Entity out{ 0,0 };
 	/*if(!_deadEntities.empty())
 	{
@@ -61,11 +70,264 @@ Entity EntityMgr::SpawnEntity(EntityData* data)
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void EntityMgr::SpawnEntities(size_t count, vector<Entity>& out)
+{
+	FIRE_MEMORY_TAG(ECS);
+	static MetricCounter& numSpawned = Metrics::GetCounter("ecs.entities.spawned");
+	numSpawned.Add(count);
+
+	out.reserve(out.size() + count);
+	size_t numLeft = count;
+	const size_t slotIndex = _mode == SpawnMode::Concurrent ? ThreadSlot::Get() : ThreadSlot::Invalid;
+	if(slotIndex != ThreadSlot::Invalid)
+	{
+		// whatever the slot has on hand goes first, then the batches that are ready, and then fresh indices.
+		SpawnSlot& slot = _spawnSlots[slotIndex];
+		slot.NumSpawned.store(slot.NumSpawned.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+		while(numLeft > 0)
+		{
+			if(slot.NextFree < slot.Free.size())
+			{
+				const EntityID idx = slot.Free[slot.NextFree++];
+				out.push_back(Entity(idx, GetGeneration(idx).load(std::memory_order_relaxed)));
+			}
+			else if(slot.Next < slot.End)
+			{
+				const EntityID idx = slot.Next++;
+				GetGeneration(idx).store(0, std::memory_order_relaxed);
+				out.push_back(Entity(idx, 0));
+			}
+			else if(!TakeFreeIndices(slot))
+			{
+				break;
+			}
+			else
+			{
+				continue;
+			}
+			--numLeft;
+		}
+	}
+	else if(_mode == SpawnMode::Concurrent)
+	{
+		// a thread without a slot has nowhere to keep a batch, so it only gets fresh indices.
+		_numSpawned.fetch_add(count, std::memory_order_relaxed);
+	}
+	else
+	{
+		for(; numLeft > 0 && _freeIndices.size() > _minFreeIndices.load(std::memory_order_relaxed); --numLeft)
+		{
+			const EntityID idx = _freeIndices.front();
+			_freeIndices.pop_front();
+			out.push_back(Entity(idx, GetGeneration(idx).load(std::memory_order_relaxed)));
+		}
+	}
+
+	if(numLeft > 0)
+	{
+		const EntityID first = ReserveIndices(numLeft);
+		for(EntityID i = first; i < first + numLeft; ++i)
+		{
+			GetGeneration(i).store(0, std::memory_order_relaxed);
+			out.push_back(Entity(i, 0));
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+EntityID EntityMgr::ReserveIndices(size_t count)
+{
+	// with everything on the main thread there's nothing to race with, so there's no need for the atomic add.
+	EntityID first;
+	if(_mode == SpawnMode::Concurrent)
+	{
+		first = _numIndices.fetch_add(count, std::memory_order_relaxed);
+	}
+	else
+	{
+		first = _numIndices.load(std::memory_order_relaxed);
+		_numIndices.store(first + count, std::memory_order_relaxed);
+	}
+	FIRE_ASSERT_MSG(first + count <= MaxIndices, "ran out of entity indices");
+
+	// on the main thread every page up to the last index has been allocated already, so there's only something
+	// to do when the range runs onto a new one.
+	if(_mode != SpawnMode::Concurrent && first != 0 &&
+		((first - 1) >> GenerationPageBits) == ((first + count - 1) >> GenerationPageBits))
+	{
+		return first;
+	}
+
+	for(EntityID page = first >> GenerationPageBits; count > 0 && page <= (first + count - 1) >> GenerationPageBits; ++page)
+	{
+		atomic<GenerationPage*>& slot = _generations[static_cast<size_t>(page)];
+		if(slot.load(std::memory_order_acquire) == nullptr)
+		{
+			// every generation starts out as the one that's never handed out, so an index that's been reserved
+			// but not spawned yet isn't alive.
+			GenerationPage* fresh = new GenerationPage;
+			for(size_t i = 0; i < GenerationPageSize; ++i)
+			{
+				fresh->Generations[i].store(static_cast<EntityGeneration>(ENT_GENERATION_MASK), std::memory_order_relaxed);
+			}
+
+			GenerationPage* expected = nullptr;
+			if(!slot.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel))
+			{
+				delete fresh;
+			}
+		}
+	}
+	return first;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+EntityID EntityMgr::SpawnIndex()
+{
+	EntityID idx;
+	const size_t slotIndex = _mode == SpawnMode::Concurrent ? ThreadSlot::Get() : ThreadSlot::Invalid;
+	if(slotIndex != ThreadSlot::Invalid)
+	{
+		SpawnSlot& slot = _spawnSlots[slotIndex];
+		slot.NumSpawned.store(slot.NumSpawned.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		// the block of fresh indices is used up before looking for a batch, so the lock is only taken once a block.
+		if(slot.NextFree < slot.Free.size() || (slot.Next == slot.End && TakeFreeIndices(slot)))
+		{
+			return slot.Free[slot.NextFree++];
+		}
+		if(slot.Next == slot.End)
+		{
+			slot.Next = ReserveIndices(SpawnRangeSize);
+			slot.End = slot.Next + SpawnRangeSize;
+		}
+		idx = slot.Next++;
+	}
+	else if(_mode == SpawnMode::Concurrent)
+	{
+		// a thread without a slot has nowhere to keep a batch, so it only gets fresh indices.
+		_numSpawned.fetch_add(1, std::memory_order_relaxed);
+		idx = ReserveIndices(1);
+	}
+	else if(_freeIndices.size() > _minFreeIndices.load(std::memory_order_relaxed))
+	{
+		idx = _freeIndices.front();
+		_freeIndices.pop_front();
+		return idx;
+	}
+	else
+	{
+		idx = ReserveIndices(1);
+	}
+	GetGeneration(idx).store(0, std::memory_order_relaxed);
+	return idx;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool EntityMgr::TakeFreeIndices(SpawnSlot& slot)
+{
+	std::scoped_lock lock(_freeLock);
+
+	// the oldest batch is only taken if that still leaves enough despawned indices waiting behind it.
+	if(_freeBatches.empty() || _numQueuedFree - _freeBatches.front().size() < _minFreeIndices.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+	slot.Free.swap(_freeBatches.front());
+	slot.NextFree = 0;
+	_numQueuedFree -= slot.Free.size();
+
+	vector<FreeIndex>& drained = _freeBatches.front();
+	if(drained.capacity() > 0)
+	{
+		drained.clear();
+		_spareBatches.push_back(eastl::move(drained));
+	}
+	_freeBatches.pop_front();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void EntityMgr::QueueFreeIndices()
+{
+	if(_freeing.empty())
+	{
+		return;
+	}
+
+	std::scoped_lock lock(_freeLock);
+	_numQueuedFree += _freeing.size();
+	_freeBatches.push_back(eastl::move(_freeing));
+	_freeing.clear();
+	if(!_spareBatches.empty())
+	{
+		_freeing.swap(_spareBatches.back());
+		_spareBatches.pop_back();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void EntityMgr::DespawnEntity(Entity entity)
 {
-	EntityID idx = entity.Index();
-	++_generation[idx];
-	_freeIndices.push_back(idx);
+	if(Kill(entity))
+	{
+		DispatchDestruction(span<const Entity>(&entity, 1));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void EntityMgr::DespawnEntities(span<const Entity> entities)
+{
+	std::scoped_lock lock(_despawnLock);
+	_pendingDespawns.insert(_pendingDespawns.end(), entities.begin(), entities.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t EntityMgr::GetNumPendingDespawns() const
+{
+	std::scoped_lock lock(_despawnLock);
+	return _pendingDespawns.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t EntityMgr::FlushDespawns()
+{
+	{
+		// swapped out so that anything the callbacks despawn waits for the next flush.
+		std::scoped_lock lock(_despawnLock);
+		if(_pendingDespawns.empty())
+		{
+			return 0;
+		}
+		_despawning.swap(_pendingDespawns);
+	}
+	FIRE_PROFILE_SCOPE("EntityMgr::FlushDespawns");
+	size_t numKilled = 0;
+	for(Entity entity : _despawning)
+	{
+		if(Kill(entity))
+		{
+			_despawning[numKilled++] = entity;
+		}
+	}
+	_despawning.resize(numKilled);
+	if(_mode == SpawnMode::Concurrent)
+	{
+		QueueFreeIndices();
+	}
+
+	DispatchDestruction(_despawning);
+	_despawning.clear();
+	return numKilled;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -94,18 +356,150 @@ void EntityMgr::UnregisterDestructionCallback(void* registrant)
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool EntityMgr::IsAlive(Entity entity)
+void EntityMgr::RegisterCollectable(IComponent* component)
 {
-	return _generation[entity.Index()] == entity.Generation();
+	_collectables.push_back(component);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void EntityMgr::UnregisterCollectable(IComponent* component)
+{
+	auto found = eastl::find(_collectables.begin(), _collectables.end(), component);
+	if(found != _collectables.end())
+	{
+		_collectables.erase(found);
+		_nextCollectable = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t EntityMgr::CollectGarbage()
+{
+	if(_collectables.empty() || _gcRowsPerFrame == 0)
+	{
+		return 0;
+	}
+	FIRE_PROFILE_SCOPE("EntityMgr::CollectGarbage");
+	static MetricCounter& numCollected = Metrics::GetCounter("ecs.gc.collected");
+
+	const uint64_t deadline = _gcTimeBudget > 0 ? Metrics::GetTime() + _gcTimeBudget : eastl::numeric_limits<uint64_t>::max();
+	size_t rowsLeft = _gcRowsPerFrame;
+	size_t collected = 0;
+	const size_t numCollectables = _collectables.size();
+	for(size_t i = 0; i < numCollectables && rowsLeft > 0; ++i)
+	{
+		IComponent* component = _collectables[(_nextCollectable + i) % numCollectables];
+		const uint64_t before = component->GetGCStats().NumCollected;
+		rowsLeft -= component->Collect(rowsLeft, deadline);
+		collected += static_cast<size_t>(component->GetGCStats().NumCollected - before);
+
+		if(Metrics::GetTime() >= deadline)
+		{
+			break;
+		}
+	}
+	_nextCollectable = (_nextCollectable + 1) % numCollectables;
+
+	numCollected.Add(collected);
+	return collected;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t EntityMgr::GetNumAlive() const
+{
+	if(_mode == SpawnMode::Concurrent)
+	{
+		size_t numSpawned = _numSpawned.load(std::memory_order_relaxed);
+		for(const SpawnSlot& slot : _spawnSlots)
+		{
+			numSpawned += slot.NumSpawned.load(std::memory_order_relaxed);
+		}
+		return numSpawned - _numDespawned.load(std::memory_order_relaxed);
+	}
+	return static_cast<size_t>(_numIndices.load(std::memory_order_relaxed) - _freeIndices.size() - _numRetired);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool EntityMgr::IsAlive(Entity entity) const
+{
+	const EntityID idx = entity.Index();
+	if(idx >= MaxIndices)
+	{
+		return false;
+	}
+	GenerationPage* page = _generations[static_cast<size_t>(idx >> GenerationPageBits)].load(std::memory_order_acquire);
+	return page && page->Generations[idx & (GenerationPageSize - 1)].load(std::memory_order_relaxed) == entity.Generation();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Entity EntityMgr::SetGeneration(Entity entity, EntityGeneration generation)
+{
+	FIRE_ASSERT_MSG(generation < ENT_GENERATION_MASK, "the last generation is never handed out");
+	if(!IsAlive(entity))
+	{
+		return Entity();
+	}
+
+	EntityGeneration current = static_cast<EntityGeneration>(entity.Generation());
+	if(!GetGeneration(entity.Index()).compare_exchange_strong(current, generation, std::memory_order_acq_rel))
+	{
+		return Entity();
+	}
+	return Entity(entity.Index(), generation);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool EntityMgr::Kill(Entity entity)
+{
+	static MetricCounter& numDespawned = Metrics::GetCounter("ecs.entities.despawned");
+	if(!IsAlive(entity))
+	{
+		return false;
+	}
+
+	// only the main thread kills, so nothing can bump the generation in between. One past the last generation is
+	// ENT_GENERATION_MASK, which is never handed out, so the index is done.
+	const EntityID idx = entity.Index();
+	const EntityGeneration next = static_cast<EntityGeneration>(entity.Generation()) + 1;
+	GetGeneration(idx).store(next, std::memory_order_release);
+	numDespawned.Add();
+
+	if(_mode == SpawnMode::Concurrent)
+	{
+		_numDespawned.store(_numDespawned.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	if(next == ENT_GENERATION_MASK)
+	{
+		++_numRetired;
+	}
+	else if(_mode == SpawnMode::Concurrent)
+	{
+		_freeing.push_back(static_cast<FreeIndex>(idx));
+		if(_freeing.size() == SpawnRangeSize)
+		{
+			QueueFreeIndices();
+		}
+	}
+	else
+	{
+		_freeIndices.push_back(static_cast<FreeIndex>(idx));
+	}
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void EntityMgr::DispatchDestruction(Entity entity)
+void EntityMgr::DispatchDestruction(span<const Entity> entities)
 {
 	for(size_t i=0; i<_destructionCallbacks.size(); ++i)
 	{
-		_destructionCallbacks[i].Callback(entity);
+		_destructionCallbacks[i].Callback(entities);
 	}
 }
 
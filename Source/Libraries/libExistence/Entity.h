@@ -13,18 +13,34 @@
 
 #include <libCore/libCore.h>
 #include <libCore/UUIDMgr.h>
+#include <libCore/ThreadSlot.h>
+#include <libCore/InstrumentedMutex.h>
+
+#include <EASTL/span.h>
+
+/**
+	How many of an Entity's 64 bits go to the index, with the rest going to the generation. Define it for the whole
+	build to change it, anywhere from 32 to 56, so that the generation always fits in an EntityGeneration.
+
+	An EntityMgr never hands out more than 2^30 indices however wide the index is, so the bits past 30 only buy
+	room that nothing uses. What the setting really picks is the generation: the default of 40 leaves 24 bits, so
+	a slot can be reused about 16 million times before it's retired, and 32 leaves 32 bits, about 4 billion times.
+ **/
+#ifndef FIRE_ENTITY_INDEX_BITS
+# define FIRE_ENTITY_INDEX_BITS 40
+#endif
 
 OPEN_NAMESPACE(Firestorm);
 
 using EntityID = uint64_t;
-using EntityGeneration = uint16_t;
-// since there's no uint48_t type, we'll leave that alone.
+using EntityGeneration = uint32_t;
+
+static const unsigned ENT_INDEX_BITS = FIRE_ENTITY_INDEX_BITS;
+static const EntityID ENT_INDEX_MASK = (EntityID(1) << ENT_INDEX_BITS) - 1;
+static const unsigned ENT_GENERATION_BITS = sizeof(EntityID) * 8 - ENT_INDEX_BITS;
+static const EntityID ENT_GENERATION_MASK = (EntityID(1) << ENT_GENERATION_BITS) - 1;
 
-// 16 bits for the generation and 48 bits for the index.
-static const unsigned ENT_INDEX_BITS = sizeof(EntityID) - sizeof(uint8_t);
-static const unsigned ENT_INDEX_MASK = (1<<ENT_INDEX_BITS) - 1;
-static const unsigned ENT_GENERATION_BITS = sizeof(EntityID) - ENT_INDEX_BITS;
-static const unsigned ENT_GENERATION_MASK = (1<<ENT_GENERATION_BITS) - 1;
+static_assert(ENT_INDEX_BITS >= 32 && ENT_INDEX_BITS <= 56, "FIRE_ENTITY_INDEX_BITS has to be between 32 and 56");
 
 static const EntityID ENT_INVALID = eastl::numeric_limits<EntityID>::max();
 
@@ -32,15 +48,15 @@ struct Entity
 {
 	EntityID id;
 	Entity():id(ENT_INVALID) {}
-	Entity(EntityID index, uint8_t generation)
-	: id((generation << ENT_INDEX_BITS) | index)
+	Entity(EntityID index, EntityGeneration generation)
+	: id((EntityID(generation) << ENT_INDEX_BITS) | index)
 	{
 	}
 
 	EntityID Index() const { return id & ENT_INDEX_MASK; }
 	EntityID Generation() const { return (id >> ENT_INDEX_BITS) & ENT_GENERATION_MASK; }
 
-	inline bool operator==(const Entity& other)
+	inline bool operator==(const Entity& other) const
 	{
 		return other.id == id;
 	}
@@ -53,12 +69,52 @@ struct EntityData
 {
 };
 
+class IComponent;
+
+struct EntityMgrTestAccess;
+
+/**
+	\class EntityMgr
+
+	Hands out entities and keeps track of which ones are alive.
+
+	By default everything happens on the main thread, and spawning doesn't pay for any atomics. A manager made
+	with SpawnMode::Concurrent lets SpawnEntity, SpawnEntities, IsAlive and DespawnEntities be called from any
+	thread, so jobs can make their own entities without going through the main thread:
+
+	- Despawned indices are queued up in batches of SpawnRangeSize, and a thread takes a whole batch at a time,
+	  oldest first.
+	- Fresh indices are handed to each thread in blocks of SpawnRangeSize.
+	- Each thread keeps its own count of what it has spawned, so a thread only touches shared state once per
+	  batch or block.
+	- Generations live in pages that never move once they're allocated, so reading one never races with
+	  another thread growing the storage.
+
+	An index that's despawned with DespawnEntity waits for a full batch, or the next FlushDespawns, before a thread
+	can pick it up again.
+
+	Everything else (DespawnEntity, FlushDespawns, CollectGarbage and the registration functions) calls into
+	the components, so it belongs on the main thread either way.
+ **/
 class EntityMgr final
 {
 public:
-	using DestructionCallback = function<void(Entity)>;
+	using DestructionCallback = function<void(span<const Entity>)>;
 
-	EntityMgr(UUIDMgr& uuidMgr);
+	// how many fresh indices a thread takes at a time.
+	static const size_t SpawnRangeSize = 256;
+
+	/**
+		Which threads are allowed to spawn entities.
+	 **/
+	enum class SpawnMode
+	{
+		MainThread,
+		Concurrent
+	};
+
+	EntityMgr(UUIDMgr& uuidMgr, SpawnMode mode = SpawnMode::MainThread);
+	~EntityMgr();
 
 	/**
 		Spawn yourself a shiny new entity.
@@ -66,12 +122,39 @@ public:
 	Entity SpawnEntity(EntityData* data = nullptr);
 
 	/**
-		Despawn an entity and mark it as dead.
+		Append \c count new entities to \c out. Any fresh indices that are needed are taken in one go.
+	 **/
+	void SpawnEntities(size_t count, vector<Entity>& out);
+
+	/**
+		Despawn an entity and mark it as dead. The destruction callbacks are called right away.
+
+		\note Main thread only. Use DespawnEntities from anywhere else.
 	 **/
 	void DespawnEntity(Entity entity);
 
 	/**
-		Register a function to be called when an Entity is destroyed.
+		Queue a batch of entities up to be despawned by the next FlushDespawns. They stay alive until then, and
+		every destruction callback gets handed the whole lot at once rather than an entity at a time, which is
+		what you want when tearing down a level.
+	 **/
+	void DespawnEntities(span<const Entity> entities);
+
+	/**
+		Despawn every entity queued up by DespawnEntities. Called once a frame, after the frame is done. Entities
+		that were queued more than once or are already dead are skipped.
+
+		\return The number of entities that were despawned.
+	 **/
+	size_t FlushDespawns();
+
+	/**
+		Retrieve the number of entities waiting on the next FlushDespawns.
+	 **/
+	size_t GetNumPendingDespawns() const;
+
+	/**
+		Register a function to be called with every batch of entities that's destroyed.
 	 **/
 	void RegisterDestructionCallback(void* definition, DestructionCallback callback);
 
@@ -80,10 +163,55 @@ public:
 	 **/
 	void UnregisterDestructionCallback(void* registrant);
 
+	/**
+		Register a kGC component to be garbage collected by CollectGarbage.
+	 **/
+	void RegisterCollectable(IComponent* component);
+	void UnregisterCollectable(IComponent* component);
+
+	/**
+		Give the kGC components a frame's worth of garbage collection. Called once a frame, after FlushDespawns.
+		The components share the rows per frame and the time budget, taking turns at going first so that none of
+		them gets starved.
+
+		\return The number of rows that were erased.
+	 **/
+	size_t CollectGarbage();
+
+	/**
+		Set the most rows that CollectGarbage checks in a frame, across every component. 0 turns it off.
+	 **/
+	void SetGCRowsPerFrame(size_t numRows) { _gcRowsPerFrame = numRows; }
+	size_t GetGCRowsPerFrame() const { return _gcRowsPerFrame; }
+
+	/**
+		Set how long CollectGarbage can take in a frame, in nanoseconds. 0 means it's only bound by the rows.
+	 **/
+	void SetGCTimeBudget(uint64_t nanoseconds) { _gcTimeBudget = nanoseconds; }
+	uint64_t GetGCTimeBudget() const { return _gcTimeBudget; }
+
 	/**
 		Check whether or not the Entity is alive.
 	 **/
-	bool IsAlive(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	/**
+		Retrieve the number of entities that are alive right now.
+	 **/
+	size_t GetNumAlive() const;
+
+	/**
+		Retrieve the number of indices that have been used up. An index is retired rather than reused once its
+		generation would wrap around, so that a stale Entity can never come back to life.
+	 **/
+	size_t GetNumRetired() const { return _numRetired; }
+
+	/**
+		Set how many despawned indices have to pile up before they start being reused. Indices are reused oldest
+		first, so an index isn't handed out again until at least this many others have been despawned after it.
+		The longer an index sits, the less often its generation goes up. Defaults to 1024.
+	 **/
+	void SetMinFreeIndices(size_t numIndices) { _minFreeIndices.store(numIndices, std::memory_order_relaxed); }
 
 	/**
 		Retrieve the number of registered destructor callbacks.
@@ -92,8 +220,64 @@ public:
 	 **/
 	size_t GetNumRegisteredDestructors() const { return _destructionCallbacks.size(); }
 
+	size_t GetNumCollectables() const { return _collectables.size(); }
+
 private:
-	void DispatchDestruction(Entity entity);
+	EntityMgr(const EntityMgr&) = delete;
+	EntityMgr& operator=(const EntityMgr&) = delete;
+
+	// the unit tests reach in through this to get at the hooks below.
+	friend struct EntityMgrTestAccess;
+
+	/**
+		Move a live entity's index straight to \c generation, as if it had been despawned and spawned again that
+		many times. Anything that held on to the old Entity sees it as dead. This is only here so that the unit
+		tests can retire an index without spinning through every generation first.
+
+		\return The entity with its new generation, or an invalid one if \c entity wasn't alive.
+	 **/
+	Entity SetGeneration(Entity entity, EntityGeneration generation);
+
+	// generations are kept in pages that are never moved or freed, so that any thread can read them. The page
+	// table is allocated up front, which caps a manager at 2^30 indices. Despawned indices are kept as 32 bits
+	// while they wait to be reused, so the cap can't go past 2^32 without widening them.
+	static const size_t GenerationPageBits = 16;
+	static const size_t GenerationPageSize = 1 << GenerationPageBits;
+	static const size_t MaxGenerationPages = 1 << 14;
+	static const EntityID MaxIndices = (EntityID(MaxGenerationPages) << GenerationPageBits) < ENT_INDEX_MASK ?
+		(EntityID(MaxGenerationPages) << GenerationPageBits) : ENT_INDEX_MASK;
+	static_assert(MaxIndices <= (EntityID(1) << 32), "despawned indices are stored as 32 bits");
+
+	using FreeIndex = uint32_t;
+
+	struct GenerationPage
+	{
+		atomic<EntityGeneration> Generations[GenerationPageSize];
+	};
+
+	// what a thread spawns from when spawning concurrently. Only the thread that owns the slot touches it.
+	struct alignas(64) SpawnSlot
+	{
+		vector<FreeIndex> Free;             // a batch of despawned indices, handed out front to back.
+		size_t            NextFree{ 0 };
+		EntityID          Next{ 0 };        // the block of fresh indices.
+		EntityID          End{ 0 };
+		atomic<size_t>    NumSpawned{ 0 };  // atomic so that GetNumAlive can read it from the main thread.
+	};
+
+	atomic<EntityGeneration>& GetGeneration(EntityID index) const
+	{
+		return _generations[static_cast<size_t>(index >> GenerationPageBits)].load(std::memory_order_acquire)
+			->Generations[index & (GenerationPageSize - 1)];
+	}
+
+	EntityID ReserveIndices(size_t count);
+	EntityID SpawnIndex();
+	bool TakeFreeIndices(SpawnSlot& slot);
+	void QueueFreeIndices();
+
+	bool Kill(Entity entity);
+	void DispatchDestruction(span<const Entity> entities);
 	void BuildEntity(Entity entity, EntityData* data) const;
 
 	struct CallbackInfo
@@ -102,8 +286,38 @@ private:
 		void* Registrant;
 	};
 	vector<CallbackInfo> _destructionCallbacks;
-	vector<uint8_t> _generation;
-	deque<EntityID> _freeIndices;
+
+	const SpawnMode          _mode;
+	atomic<GenerationPage*>* _generations;
+	atomic<EntityID>         _numIndices{ 0 };
+	size_t                   _numRetired{ 0 };
+	atomic<size_t>           _minFreeIndices{ 1024 };
+
+	// where despawned indices wait when everything's on the main thread, oldest first.
+	deque<FreeIndex> _freeIndices;
+
+	// when spawning concurrently, the alive count is what the slots (and threads without one) have spawned, less
+	// what the main thread has despawned.
+	SpawnSlot      _spawnSlots[ThreadSlot::MaxSlots];
+	atomic<size_t> _numSpawned{ 0 };
+	atomic<size_t> _numDespawned{ 0 };
+
+	// despawned indices on their way to the spawning threads. The main thread fills up a batch, and the threads
+	// take the oldest batch when they run out. Drained batches come back as spares so they can be filled again.
+	vector<FreeIndex>         _freeing;
+	FIRE_MUTEX(_freeLock, "EntityMgr::_freeLock");
+	deque<vector<FreeIndex>>  _freeBatches;
+	vector<vector<FreeIndex>> _spareBatches;
+	size_t                    _numQueuedFree{ 0 };
+
+	mutable FIRE_MUTEX(_despawnLock, "EntityMgr::_despawnLock");
+	vector<Entity> _pendingDespawns;
+	vector<Entity> _despawning;
+
+	vector<IComponent*> _collectables;
+	size_t _nextCollectable{ 0 };
+	size_t _gcRowsPerFrame{ 4096 };
+	uint64_t _gcTimeBudget{ 250000 };
 };
 
 /*class Entity final
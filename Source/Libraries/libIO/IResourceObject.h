@@ -11,11 +11,18 @@
 #define LIBIO_RESOURCEOBJECT_H_
 #pragma once
 
-#include <libCore/RefPtr.h>
+#include <libCore/IntrusivePtr.h>
 
 OPEN_NAMESPACE(Firestorm);
 
-class IResourceObject
+struct ResourceTypeID;
+
+/**
+	Resource objects are reference counted in place, so copying a ResourcePtr around never allocates or chases
+	a control block. FIRE_RESOURCE_TYPE fills in GetResourceType, which lets Resource::Get check the type of the
+	object without a dynamic_cast.
+ **/
+class IResourceObject : public RefCounted
 {
 public:
 	virtual ~IResourceObject() {}
@@ -24,9 +31,11 @@ public:
 		This should return whether or not the resource is ready for use.
 	 **/
 	virtual bool IsReady() const = 0;
+
+	virtual const ResourceTypeID* GetResourceType() const = 0;
 };
 
-using ResourcePtr = RefPtr<IResourceObject>;
+using ResourcePtr = IntrusivePtr<IResourceObject>;
 
 CLOSE_NAMESPACE(Firestorm);
 #endif
\ No newline at end of file
@@ -0,0 +1,252 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MappedFile
+//
+//  A read only view of a file's contents that doesn't need to be copied out before it can be used.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "MappedFile.h"
+#include "ResourceIOErrors.h"
+
+#include <libCore/MemoryTracker.h>
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#ifdef FIRE_PLATFORM_WINDOWS
+#include <Windows.h>
+#endif
+
+#if defined(FIRE_PLATFORM_UNIX) || defined(FIRE_PLATFORM_OSX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if !defined(FIRE_PLATFORM_WINDOWS) && !defined(FIRE_PLATFORM_UNIX) && !defined(FIRE_PLATFORM_OSX)
+#error "MappedFile doesn't know how to map files on this platform"
+#endif
+
+OPEN_NAMESPACE(Firestorm);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct BufferPool
+{
+	std::mutex                       Lock;
+	UntrackedVector<vector<uint8_t>> Buffers;
+	size_t                           NumBytes{ 0 };
+};
+
+// never destroyed, so files that are let go of while statics are being torn down still have a pool to go back to.
+static BufferPool& GetPool()
+{
+	static BufferPool* pool = new(UntrackedAllocator::Allocate(sizeof(BufferPool), alignof(BufferPool))) BufferPool;
+	return *pool;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MappedFile::~MappedFile()
+{
+	if(_mapping)
+	{
+#ifdef FIRE_PLATFORM_WINDOWS
+		UnmapViewOfFile(_mapping);
+#endif
+#if defined(FIRE_PLATFORM_UNIX) || defined(FIRE_PLATFORM_OSX)
+		munmap(_mapping, _size);
+#endif
+		return;
+	}
+
+	if(_buffer.empty() || _buffer.size() > MaxPooledBufferSize)
+	{
+		return;
+	}
+
+	BufferPool& pool = GetPool();
+	std::scoped_lock lock(pool.Lock);
+	if(pool.Buffers.size() < MaxPooledBuffers && pool.NumBytes + _buffer.size() <= MaxPooledBytes)
+	{
+		pool.NumBytes += _buffer.size();
+		pool.Buffers.push_back(std::move(_buffer));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Result<IntrusivePtr<MappedFile>, Error> MappedFile::MapNative(const char* path, FileAccess access)
+{
+	IntrusivePtr<MappedFile> file(new MappedFile);
+
+#ifdef FIRE_PLATFORM_WINDOWS
+	const DWORD flags = access == FileAccess::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if(handle == INVALID_HANDLE_VALUE)
+	{
+		return FIRE_ERROR(ResourceIOErrors::FILE_READ_ERROR, Format("couldn't open %s (error %lu)", path, GetLastError()));
+	}
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(handle, &size))
+	{
+		const DWORD err = GetLastError();
+		CloseHandle(handle);
+		return FIRE_ERROR(ResourceIOErrors::FILE_READ_ERROR, Format("couldn't get the size of %s (error %lu)", path, err));
+	}
+
+	// an empty file can't be mapped, but there's nothing to map anyway.
+	if(size.QuadPart == 0)
+	{
+		CloseHandle(handle);
+		return file;
+	}
+
+	// the view keeps the mapping alive, so neither handle needs to be held on to.
+	HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(handle);
+	if(mapping == nullptr)
+	{
+		return FIRE_ERROR(ResourceIOErrors::FILE_READ_ERROR, Format("couldn't map %s (error %lu)", path, GetLastError()));
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	const DWORD err = GetLastError();
+	CloseHandle(mapping);
+	if(view == nullptr)
+	{
+		return FIRE_ERROR(ResourceIOErrors::FILE_READ_ERROR, Format("couldn't map %s (error %lu)", path, err));
+	}
+
+	file->_mapping = view;
+	file->_data = static_cast<const uint8_t*>(view);
+	file->_size = static_cast<size_t>(size.QuadPart);
+#endif
+
+#if defined(FIRE_PLATFORM_UNIX) || defined(FIRE_PLATFORM_OSX)
+	const int fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		return FIRE_ERROR(ResourceIOErrors::FILE_READ_ERROR, Format("couldn't open %s: %s", path, strerror(errno)));
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) == -1)
+	{
+		const int err = errno;
+		close(fd);
+		return FIRE_ERROR(ResourceIOErrors::FILE_READ_ERROR, Format("couldn't stat %s: %s", path, strerror(err)));
+	}
+
+	// mmap won't take a length of 0, but there's nothing to map anyway.
+	const size_t size = static_cast<size_t>(info.st_size);
+	if(size == 0)
+	{
+		close(fd);
+		return file;
+	}
+
+	// the mapping holds its own reference to the file, so the descriptor can go.
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	const int err = errno;
+	close(fd);
+	if(view == MAP_FAILED)
+	{
+		return FIRE_ERROR(ResourceIOErrors::FILE_READ_ERROR, Format("couldn't map %s: %s", path, strerror(err)));
+	}
+
+	// only hints, so it doesn't matter if they're ignored.
+	madvise(view, size, access == FileAccess::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+	if(access == FileAccess::Sequential)
+	{
+		madvise(view, size, MADV_WILLNEED);
+	}
+
+	file->_mapping = view;
+	file->_data = static_cast<const uint8_t*>(view);
+	file->_size = size;
+#endif
+
+	return file;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+IntrusivePtr<MappedFile> MappedFile::MakeBuffered(size_t size)
+{
+	IntrusivePtr<MappedFile> file(new MappedFile);
+	if(size == 0)
+	{
+		return file;
+	}
+
+	{
+		// the smallest buffer that's big enough, so that big buffers are still around for big files.
+		BufferPool& pool = GetPool();
+		std::scoped_lock lock(pool.Lock);
+		auto best = pool.Buffers.end();
+		for(auto it = pool.Buffers.begin(); it != pool.Buffers.end(); ++it)
+		{
+			if(it->size() >= size && (best == pool.Buffers.end() || it->size() < best->size()))
+			{
+				best = it;
+			}
+		}
+		if(best != pool.Buffers.end())
+		{
+			pool.NumBytes -= best->size();
+			file->_buffer = std::move(*best);
+			pool.Buffers.erase_unsorted(best);
+		}
+	}
+
+	// a pooled buffer keeps its size, so that it's only ever zeroed the first time around.
+	if(file->_buffer.size() < size)
+	{
+		file->_buffer.resize(size);
+	}
+	file->_data = file->_buffer.data();
+	file->_size = size;
+	return file;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t MappedFile::GetNumPooledBuffers()
+{
+	BufferPool& pool = GetPool();
+	std::scoped_lock lock(pool.Lock);
+	return pool.Buffers.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t MappedFile::GetPooledBytes()
+{
+	BufferPool& pool = GetPool();
+	std::scoped_lock lock(pool.Lock);
+	return pool.NumBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MappedFile::ClearPool()
+{
+	UntrackedVector<vector<uint8_t>> buffers;
+	{
+		BufferPool& pool = GetPool();
+		std::scoped_lock lock(pool.Lock);
+		buffers.swap(pool.Buffers);
+		pool.NumBytes = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLOSE_NAMESPACE(Firestorm);
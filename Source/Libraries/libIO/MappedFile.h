@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MappedFile
+//
+//  A read only view of a file's contents that doesn't need to be copied out before it can be used.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Project Elflord 2018
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LIBIO_MAPPEDFILE_H_
+#define LIBIO_MAPPEDFILE_H_
+#pragma once
+
+#include <libCore/libCore.h>
+#include <libCore/Result.h>
+#include <libCore/IntrusivePtr.h>
+
+#include <EASTL/span.h>
+
+OPEN_NAMESPACE(Firestorm);
+
+/**
+	How a mapped file is going to be read, which is passed on to the OS so that it can read ahead (or not).
+ **/
+enum class FileAccess
+{
+	Sequential,
+	Random
+};
+
+/**
+	\class MappedFile
+
+	The contents of a file, as returned by libIO::MapFile. Files that live in a mounted directory are mapped
+	straight into memory, so nothing gets copied and pages are only read from disk as they're touched. Files that
+	live in an archive can't be mapped, so they're read into a buffer that's handed back to a pool once the last
+	reference goes away, so that loading a lot of files doesn't mean a lot of allocations.
+
+	Either way the data stays valid for as long as there's a reference to the MappedFile.
+
+	\note The data isn't null terminated.
+	\warning The data is read only. Mapped pages are, and writing to them will crash.
+ **/
+class MappedFile final : public RefCounted
+{
+public:
+	// buffers bigger than this aren't kept around, and the pool never holds more than this in total.
+	static const size_t MaxPooledBufferSize = 16 * 1024 * 1024;
+	static const size_t MaxPooledBytes = 64 * 1024 * 1024;
+	static const size_t MaxPooledBuffers = 16;
+
+	span<const uint8_t> GetData() const { return span<const uint8_t>(_data, static_cast<eastl_size_t>(_size)); }
+
+	const uint8_t* data() const { return _data; }
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	const char* GetChars() const { return reinterpret_cast<const char*>(_data); }
+
+	/**
+		Check if the data is mapped from the file rather than having been read into a buffer.
+	 **/
+	bool IsMapped() const { return _mapping != nullptr; }
+
+	static size_t GetNumPooledBuffers();
+	static size_t GetPooledBytes();
+
+	/**
+		Free every buffer that's waiting in the pool.
+	 **/
+	static void ClearPool();
+
+private:
+	friend struct libIO;
+
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+		Map a file that lives on disk at \c path.
+	 **/
+	static Result<IntrusivePtr<MappedFile>, Error> MapNative(const char* path, FileAccess access);
+
+	/**
+		Make a MappedFile with a pooled buffer of \c size bytes to read the file into.
+	 **/
+	static IntrusivePtr<MappedFile> MakeBuffered(size_t size);
+
+	uint8_t* GetBuffer() { return _buffer.data(); }
+
+	const uint8_t*  _data{ nullptr };
+	size_t          _size{ 0 };
+	void*           _mapping{ nullptr };
+	vector<uint8_t> _buffer;
+};
+
+using MappedFilePtr = IntrusivePtr<MappedFile>;
+
+CLOSE_NAMESPACE(Firestorm);
+
+#endif
@@ -30,32 +30,32 @@ ResourceCache::~ResourceCache()
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool ResourceCache::AddResource(const string& name, const RefPtr<IResourceObject>& resourceObject)
+bool ResourceCache::AddResource(StringId id, const ResourcePtr& resourceObject)
 {
 	std::scoped_lock lock(_cacheLock);
-	auto found = _cache.find(name);
+	auto found = _cache.find(id);
 	if(found != _cache.end())
 	{
 		return false;
 	}
-	_cache[name] = resourceObject;
+	_cache[id] = resourceObject;
 	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool ResourceCache::HasResource(const string& name)
+bool ResourceCache::HasResource(StringId id)
 {
 	std::scoped_lock lock(_cacheLock);
-	return _cache.find(name) != _cache.end();
+	return _cache.find(id) != _cache.end();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-ResourcePtr ResourceCache::FindResource(const string& name) const
+ResourcePtr ResourceCache::FindResource(StringId id) const
 {
 	std::scoped_lock lock(_cacheLock);
-	auto found = _cache.find(name);
+	auto found = _cache.find(id);
 	if(found != _cache.end())
 	{
 		return found->second;
@@ -69,20 +69,10 @@ void ResourceCache::ClearOrphanedResources()
 {
 	std::scoped_lock lock(_cacheLock);
 
-	auto iter = _cache.begin();
-	while(iter != _cache.end())
-	{
-		auto ptr = iter->second;
-		// orphaned, only used by the cache.
-		if(ptr.use_count() == 1)
-		{
-			iter = _cache.erase(iter);
-		}
-		else
-		{
-			++iter;
-		}
-	}
+	// orphaned, only used by the cache.
+	_cache.EraseIf([](const auto& entry) {
+		return entry.second.use_count() == 1;
+	});
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
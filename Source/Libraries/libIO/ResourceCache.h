@@ -14,6 +14,9 @@
 #include <libCore/libCore.h>
 #include <libCore/Result.h>
 #include <libCore/RefPtr.h>
+#include <libCore/Hash.h>
+#include <libCore/StringId.h>
+#include <libCore/InstrumentedMutex.h>
 
 #include "ResourceHandle.h"
 #include "IResourceObject.h"
@@ -27,15 +30,16 @@ public:
 	~ResourceCache();
 
 	/**
-		Retrieve whether or not the resource cache has the particular resource loaded.
+		Retrieve whether or not the resource cache has the particular resource loaded. Resources are keyed on the
+		StringId of their path, see ResourceReference::GetResourceId.
 	 **/
-	bool HasResource(const string& name);
+	bool HasResource(StringId id);
 
 	/**
 		Retrieve a pointer to a loaded resource, or nullptr if the resource does
 		not exist in the cache.
 	 **/
-	ResourcePtr FindResource(const string& name) const;
+	ResourcePtr FindResource(StringId id) const;
 
 	/**
 		Clear the cache of any resources that are no longer being referenced
@@ -45,10 +49,10 @@ public:
 
 private:
 	friend class ResourceMgr;
-	bool AddResource(const string& name, const RefPtr<IResourceObject>& object);
+	bool AddResource(StringId id, const ResourcePtr& object);
 
-	mutable mutex _cacheLock;
-	unordered_map<string, RefPtr<IResourceObject>> _cache;
+	mutable FIRE_MUTEX(_cacheLock, "ResourceCache::_cacheLock");
+	Hash<StringId, ResourcePtr> _cache;
 };
 
 CLOSE_NAMESPACE(Firestorm);
@@ -168,7 +168,7 @@ void Resource::Release()
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-ResourcePtr Resource::PullData() const
+IResourceObject* Resource::PullData() const
 {
 	if(_hasFuture)
 	{
@@ -188,7 +188,7 @@ ResourcePtr Resource::PullData() const
 			}
 		}
 
-		return _obj;
+		return _obj.get();
 	}
 	return nullptr;
 }
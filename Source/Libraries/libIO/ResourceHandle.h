@@ -45,16 +45,18 @@ public:
 	Resource& operator=(Resource&& handle);
 	Resource& operator=(const Resource& handle);
 
+	/**
+		Retrieve the resource object as a T, or null if it hasn't loaded yet or isn't a T.
+	 **/
 	template<class T>
-	const RefPtr<T> Get() const
-	{
-		return eastl::dynamic_pointer_cast<T>(PullData());
-	}
-
-	template<class T>
-	RefPtr<T> Get()
+	IntrusivePtr<T> Get() const
 	{
-		return eastl::dynamic_pointer_cast<T>(PullData());
+		IResourceObject* data = PullData();
+		if(data && data->GetResourceType() == T::MyResourceType())
+		{
+			return IntrusivePtr<T>(static_cast<T*>(data));
+		}
+		return nullptr;
 	}
 
 	/**
@@ -85,7 +87,8 @@ public:
 	void Release();
 
 private:
-	ResourcePtr PullData() const;
+	// the object stays referenced by _obj, so this hands out a plain pointer rather than another reference.
+	IResourceObject* PullData() const;
 
 	mutable Error                              _error;
 	mutable future<ResourceLoader::LoadResult> _future;
@@ -12,6 +12,8 @@
 #include "ResourceIOErrors.h"
 #include "IResourceObject.h"
 
+#include <libCore/Profiler.h>
+
 OPEN_NAMESPACE(Firestorm);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -113,6 +115,7 @@ ResourceLoader::~ResourceLoader()
 
 ResourceLoader::LoadResult ResourceLoader::Load(ResourceMgr*,const ResourceReference&)
 {
+	FIRE_PROFILE_SCOPE("ResourceLoader::Load");
 	return FIRE_LOAD_FAIL(ResourceIOErrors::DEFAULT_LOADER, "can not use default loader");
 }
 
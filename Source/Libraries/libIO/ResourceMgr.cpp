@@ -13,24 +13,19 @@
 #include "ResourceReference.h"
 #include "ResourceIOErrors.h"
 
+#include <libCore/MemoryTracker.h>
+#include <libCore/Profiler.h>
+#include <libCore/Metrics.h>
+
 #include <sstream>
 
 OPEN_NAMESPACE(Firestorm);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-ResourceMgr::ResourceMgr()
+ResourceMgr::ResourceMgr(JobSystem& jobSystem)
+: _jobSystem(jobSystem)
 {
-	for(size_t i = 0; i < _numThreads; ++i)
-	{
-		string ostring;
-		ostring.append_sprintf("ResourceMgr Thread[%d]", i);
-		_threads[i] = thread(std::bind(&ResourceMgr::ThreadRun, this));
-
-		while(!_threads[i].joinable()); // wait until the thread is joinable.
-
-		libCore::SetThreadName(_threads[i], ostring);
-	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -44,16 +39,8 @@ ResourceMgr::~ResourceMgr()
 
 void ResourceMgr::Shutdown()
 {
-	_quit = true;
-	_cv.notify_all();
-
-	for(size_t i = 0; i < _numThreads; i++)
-	{
-		if(_threads[i].joinable())
-		{
-			_threads[i].join();
-		}
-	}
+	// the loaders have to stick around until every load that might be using them has finished.
+	_jobSystem.Wait(_pendingLoads);
 	_loaders.clear();
 }
 
@@ -83,55 +70,48 @@ ResourceLoader* ResourceMgr::GetLoader(const ResourceTypeID* type)
 Resource ResourceMgr::Load(ResourceLoader* loader, const ResourceReference& ref)
 {
 	PromiseT* promise = new PromiseT;
-
-	auto loadOperation = [this, loader, ref, promise](){
-		auto path = ref.GetResourcePath();
-		FIRE_LOG_DEBUG("Loading Resource: %s", path.c_str());
-		if(_cache.HasResource(path))
+	const uint64_t queuedAt = Metrics::GetTime();
+
+	auto loadOperation = [this, loader, ref, promise, queuedAt](){
+		FIRE_MEMORY_TAG(IO);
+		FIRE_PROFILE_SCOPE("ResourceMgr::Load job");
+		static MetricHistogram& queueWait = Metrics::GetHistogram("io.load.queue_wait_ns");
+		static MetricHistogram& loadTime = Metrics::GetHistogram("io.load.time_ns");
+		static MetricCounter& numLoads = Metrics::GetCounter("io.load.count");
+		static MetricCounter& numCacheHits = Metrics::GetCounter("io.load.cache_hits");
+		static MetricCounter& numFailures = Metrics::GetCounter("io.load.failures");
+
+		const uint64_t startedAt = Metrics::GetTime();
+		queueWait.Record(startedAt - queuedAt);
+
+		const StringId id = ref.GetResourceId();
+		FIRE_LOG_DEBUG("Loading Resource: %s", ref.GetResourcePath().c_str());
+		if(_cache.HasResource(id))
 		{
-			promise->set_value(_cache.FindResource(path));
+			numCacheHits.Add();
+			promise->set_value(_cache.FindResource(id));
 			delete promise;
 			return;
 		}
 		ResourceLoader::LoadResult result = loader->Load(this, ref);
+		loadTime.Record(Metrics::GetTime() - startedAt);
+		numLoads.Add();
 		if(!result.HasError())
 		{
-			_cache.AddResource(path, result.GetResource());
+			_cache.AddResource(id, result.GetResource());
+		}
+		else
+		{
+			numFailures.Add();
 		}
 		promise->set_value(std::move(result));
 		delete promise;
 	};
 
-	std::unique_lock<mutex> lock(_queueLock);
-	_queue.push(loadOperation);
-
-	lock.unlock();
-	_cv.notify_all();
-
-	return Resource(promise->get_future());
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-void ResourceMgr::ThreadRun()
-{
-	std::unique_lock lock(_queueLock);
-	do
-	{
-		_cv.wait(lock, [this] {
-			return _queue.size() || _quit;
-		});
-		if(!_queue.empty() && !_quit)
-		{
-			auto func = std::move(_queue.front());
-			_queue.pop();
-			lock.unlock();
-
-			func();
-
-			lock.lock();
-		}
-	} while(!_quit);
+	// grab the future before submitting. the job deletes the promise once it's done with it.
+	Resource resource(promise->get_future());
+	_jobSystem.Submit(loadOperation, &_pendingLoads);
+	return resource;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
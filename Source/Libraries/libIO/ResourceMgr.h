@@ -20,6 +20,7 @@
 #include <libCore/Result.h>
 #include <libCore/Expected.h>
 #include <libCore/ObjectPool.h>
+#include <libCore/JobSystem.h>
 
 #include <libMirror/EventDispatcher.h>
 
@@ -51,6 +52,9 @@ public:											    \
 													\
 		return id;									\
 	}                                               \
+	virtual const ResourceTypeID* GetResourceType() const override { \
+		return MyResourceType();                    \
+	}                                               \
 private:
 #else
 #define FIRE_RESOURCE_TYPE( CLASS, LOADER )         \
@@ -64,12 +68,16 @@ public:											    \
 			id = new ResourceTypeID{};				\
 		return id;									\
 	}                                               \
+	virtual const ResourceTypeID* GetResourceType() const override { \
+		return MyResourceType();                    \
+	}                                               \
 private:
 #endif
 
 
 /**
-	Manages the asynchronous loading of resources.
+	Manages the asynchronous loading of resources. Loads are run as jobs on the JobSystem that was
+	handed to the ResourceMgr on construction.
  **/
 class ResourceMgr final
 {
@@ -77,7 +85,7 @@ private:
 	using PromiseT = std::promise<ResourceLoader::LoadResult>;
 
 public:
-	ResourceMgr();
+	explicit ResourceMgr(JobSystem& jobSystem);
 	~ResourceMgr();
 
 	/**
@@ -105,7 +113,7 @@ public:
 
 	/**
 		Signal to the ResourceMgr that it's time to shut down. This will hang the calling thread until all
-		worker threads have been joined.
+		in-flight loads have finished.
 	 **/
 	void Shutdown();
 
@@ -114,22 +122,14 @@ private:
 	ResourceLoader* GetLoader(const ResourceTypeID* type);
 	Resource Load(ResourceLoader* loader, const ResourceReference& ref);
 
-	static const char _numThreads{ 4 };
-
 	string _name;
-	mutex _queueLock;
 
-	thread _threads[_numThreads];
-
-	queue<function<void(void)>> _queue;
-	std::condition_variable _cv;
-	bool _quit{ false };
+	JobSystem& _jobSystem;
+	JobCounter _pendingLoads;
 
 	unordered_map<const ResourceTypeID*, UniquePtr<ResourceLoader>> _loaders;
 
 	ResourceCache _cache;
-
-	void ThreadRun();
 };
 
 CLOSE_NAMESPACE(Firestorm);
@@ -24,6 +24,7 @@ OPEN_NAMESPACE(Firestorm);
 
 ResourceReference::ResourceReference(const string& path)
 : _resourcePath(path)
+, _resourceId(path)
 {
 }
 
@@ -42,6 +43,13 @@ const string& ResourceReference::GetResourcePath() const
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+StringId ResourceReference::GetResourceId() const
+{
+	return _resourceId;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 string ResourceReference::GetPathTo() const
 {
 	auto split = SplitString(_resourcePath, '/');
@@ -57,6 +65,7 @@ string ResourceReference::GetPathTo() const
 void ResourceReference::SetResourcePath(const string& path)
 {
 	_resourcePath = path;
+	_resourceId = StringId(path);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
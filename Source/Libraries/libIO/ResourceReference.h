@@ -36,6 +36,11 @@ public:
 	 **/
 	const string& GetResourcePath() const;
 
+	/**
+		Retrieve the id of the resource, which is the StringId of its path.
+	 **/
+	StringId GetResourceId() const;
+
 	/**
 		Retrieve the path to this resource without the filename.
 	 **/
@@ -46,6 +51,7 @@ private:
 	void SetResourcePath(const string& path);
 
 	string _resourcePath;
+	StringId _resourceId;
 };
 
 CLOSE_NAMESPACE(Firestorm);
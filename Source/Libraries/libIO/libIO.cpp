@@ -5,12 +5,15 @@
 
 #include <libCore/Logger.h>
 #include <libCore/ArgParser.h>
+#include <libCore/Metrics.h>
 
 #include "IResourceObject.h"
 #include "ResourceReference.h"
 
 #include "ResourceMgr.h"
 
+#include <sys/stat.h>
+
 OPEN_NAMESPACE(Firestorm);
 
 const ErrorCode* libIO::INTERNAL_ERROR(new ErrorCode("there was an error that occurred with the internal libraries"));
@@ -94,6 +97,10 @@ bool libIO::FileExists(const char* filename)
 
 Result<vector<char>, Error> libIO::LoadFile(const string& filename)
 {
+	static MetricHistogram& readTime = Metrics::GetHistogram("io.read_ns");
+	static MetricCounter& bytesRead = Metrics::GetCounter("io.read_bytes");
+	MetricTimer timer(readTime);
+
 	vector<char> data;
 	PHYSFS_File* file = PHYSFS_openRead(filename.c_str());
 	if(file)
@@ -113,6 +120,7 @@ Result<vector<char>, Error> libIO::LoadFile(const string& filename)
 			PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
 			return FIRE_ERROR(INTERNAL_ERROR, PHYSFS_getErrorByCode(err));
 		}
+		bytesRead.Add(static_cast<uint64_t>(read));
 	}
 	else
 	{
@@ -123,15 +131,112 @@ Result<vector<char>, Error> libIO::LoadFile(const string& filename)
 	return data;
 }
 
+// the path a file has on disk, if it lives in a mounted directory rather than in an archive.
+static bool GetNativePath(const string& filename, string& outPath)
+{
+	const char* realDir = PHYSFS_getRealDir(filename.c_str());
+	if(realDir == nullptr)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if(stat(realDir, &info) != 0 || (info.st_mode & S_IFMT) != S_IFDIR)
+	{
+		return false;
+	}
+
+	// take the mount point off the front, and what's left is where the file is relative to the directory.
+	const char* mountPoint = PHYSFS_getMountPoint(realDir);
+	const char* relative = filename.c_str();
+	while(*relative == '/')
+	{
+		++relative;
+	}
+	if(mountPoint)
+	{
+		while(*mountPoint == '/')
+		{
+			++mountPoint;
+		}
+		const size_t mountLength = strlen(mountPoint);
+		if(strncmp(relative, mountPoint, mountLength) != 0)
+		{
+			return false;
+		}
+		relative += mountLength;
+		while(*relative == '/')
+		{
+			++relative;
+		}
+	}
+
+	outPath = realDir;
+	if(!outPath.empty() && outPath.back() != '/' && outPath.back() != PHYSFS_getDirSeparator()[0])
+	{
+		outPath.append(PHYSFS_getDirSeparator());
+	}
+	outPath.append(relative);
+	return true;
+}
+
+Result<MappedFilePtr, Error> libIO::MapFile(const string& filename, FileAccess access)
+{
+	static MetricHistogram& readTime = Metrics::GetHistogram("io.read_ns");
+	static MetricCounter& bytesRead = Metrics::GetCounter("io.read_bytes");
+	static MetricCounter& bytesMapped = Metrics::GetCounter("io.mapped_bytes");
+
+	string nativePath;
+	if(GetNativePath(filename, nativePath))
+	{
+		Result<MappedFilePtr, Error> mapped = MappedFile::MapNative(nativePath.c_str(), access);
+		if(mapped.has_value())
+		{
+			bytesMapped.Add(mapped.value()->size());
+			return mapped;
+		}
+		// it might still be readable through physfs, so fall back on that.
+		FIRE_LOG_WARNING("Couldn't map %s, reading it instead -> %s", filename.c_str(), mapped.error().Format());
+	}
+
+	MetricTimer timer(readTime);
+	PHYSFS_File* file = PHYSFS_openRead(filename.c_str());
+	if(file == nullptr)
+	{
+		PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
+		return FIRE_ERROR(INTERNAL_ERROR, PHYSFS_getErrorByCode(err));
+	}
+
+	PHYSFS_sint64 len = PHYSFS_fileLength(file);
+	if(len == -1)
+	{
+		PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
+		PHYSFS_close(file);
+		return FIRE_ERROR(INTERNAL_ERROR, PHYSFS_getErrorByCode(err));
+	}
+
+	MappedFilePtr buffered = MappedFile::MakeBuffered(static_cast<size_t>(len));
+	if(len > 0 && PHYSFS_readBytes(file, buffered->GetBuffer(), len) != len)
+	{
+		PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
+		PHYSFS_close(file);
+		return FIRE_ERROR(INTERNAL_ERROR, PHYSFS_getErrorByCode(err));
+	}
+	PHYSFS_close(file);
+
+	bytesRead.Add(static_cast<uint64_t>(len));
+	return buffered;
+}
+
 Result<string, Error> libIO::LoadFileString(const string& filename)
 {
-	Result<vector<char>, Error> data = LoadFile(filename);
-	if(data.has_value())
+	Result<MappedFilePtr, Error> file = MapFile(filename);
+	if(file.has_value())
 	{
-		auto d = data.value();
-		return FIRE_RESULT(string(d.begin(), d.end()));
+		const MappedFilePtr& f = file.value();
+		return FIRE_RESULT(string(f->GetChars(), f->GetChars() + f->size()));
 	}
-	return FIRE_FORWARD_ERROR(data.error());
+	return FIRE_FORWARD_ERROR(file.error());
 }
 
 static PHYSFS_EnumerateCallbackResult enumerateGetFiles(void* data, const char* origData, const char* fname)
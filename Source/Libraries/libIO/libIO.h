@@ -7,6 +7,8 @@
 #include <libCore/Result.h>
 #include <libCore/RefPtr.h>
 
+#include "MappedFile.h"
+
 OPEN_NAMESPACE(Firestorm);
 
 struct libIO : public Library<libIO>
@@ -30,6 +32,13 @@ struct libIO : public Library<libIO>
 	 **/
 	static Result<vector<char>, Error> LoadFile(const string& filename);
 
+	/**
+		Map a file into memory rather than reading it. Files in a mounted directory are mapped straight from
+		disk, and files in an archive are read into a pooled buffer. \c access tells the OS how the data is going to
+		be read so that it can read ahead.
+	 **/
+	static Result<MappedFilePtr, Error> MapFile(const string& filename, FileAccess access = FileAccess::Sequential);
+
 	/**
 		Load a file and return the result as a string.
 	 **/
@@ -12,6 +12,10 @@
 #pragma once
 
 #include <libCore/RefPtr.h>
+#include <libCore/Hash.h>
+#include <libCore/Profiler.h>
+#include <libCore/InstrumentedMutex.h>
+#include <libCore/Metrics.h>
 #include "Object.h"
 #include <typeinfo>
 
@@ -79,7 +83,7 @@ private:
 
 public:
 	using EventList = list<IEvent*>;
-	using EventMap = unordered_map<FireClassID, EventList>;
+	using EventMap = Hash<FireClassID, EventList>;
 	using Receipt = RefPtr<EDReceipt>;
 	using ReceiptPtrList = list<WeakPtr<EDReceipt>>;
 
@@ -109,6 +113,9 @@ public:
 	template <class Arg_t>
 	void Dispatch(const Arg_t& arg)
 	{
+		FIRE_PROFILE_SCOPE("EventDispatcher::Dispatch");
+		static MetricCounter& numDispatched = Metrics::GetCounter("events.dispatched");
+		numDispatched.Add();
 		FIRE_ASSERT(_numRegisteredEvents == _receipts.size());
 		std::scoped_lock lock(_mutex);
 		EventMap::iterator found = _events.find(Arg_t::MyType());
@@ -141,7 +148,7 @@ public:
 private:
 	void Unregister(IEvent* event);
 
-	mutex          _mutex;
+	FIRE_MUTEX(_mutex, "EventDispatcher::_mutex");
 	EventMap       _events;
 	int            _numRegisteredEvents;
 	ReceiptPtrList _receipts;
@@ -12,10 +12,10 @@ CLOSE_NAMESPACE(Firestorm);
 public:                                       \
 	static FireClassID MyType()               \
 	{                                         \
-		static FireClassIDType _id {          \
+		static const FireClassID _id {        \
 			#OBJECT_TYPE                      \
 		};                                    \
-		return &_id;                          \
+		return _id;                           \
 	}                                         \
 private:
 
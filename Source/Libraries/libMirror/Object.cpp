@@ -14,13 +14,6 @@ OPEN_NAMESPACE(Firestorm);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-FireClassIDType::FireClassIDType(const char* name)
-	: Name(name)
-{
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 OPEN_NAMESPACE(Mirror);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -23,18 +23,13 @@
 #include <rttr/detail/parameter_info/parameter_names.h>
 #include <rttr/variant.h>
 
+#include <libCore/StringId.h>
+
 #include "MirrorMacros.h"
 
 OPEN_NAMESPACE(Firestorm);
 
-
-struct FireClassIDType
-{
-	FireClassIDType(const char* name);
-	const char* Name{ nullptr };
-};
-
-using FireClassID = FireClassIDType*;
+using FireClassID = StringId;
 
 OPEN_NAMESPACE(Mirror);
 
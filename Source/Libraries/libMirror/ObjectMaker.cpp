@@ -50,7 +50,7 @@ bool ObjectMaker::IsMakerRegistered(FireClassID type) const
 
 IMaker* ObjectMaker::GetMaker(FireClassID type) const
 {
-	std::scoped_lock<std::mutex> lock(_s_allLock);
+	std::scoped_lock lock(_s_allLock);
 	auto found = _makers.find(type);
 	if(found != _makers.end())
 		return (*found).second;
@@ -11,6 +11,9 @@
 #define LIBMIRROR_OBJECTMAKER_H_
 #pragma once
 
+#include <libCore/Hash.h>
+#include <libCore/InstrumentedMutex.h>
+
 #include "MirrorMacros.h"
 #include "Object.h"
 
@@ -64,8 +67,8 @@ public:
 
 private:
 	IMaker* GetMaker(FireClassID type) const;
-	unordered_map<FireClassID, IMaker*> _makers;
-	mutable mutex _s_allLock;
+	Hash<FireClassID, IMaker*> _makers;
+	mutable FIRE_MUTEX(_s_allLock, "ObjectMaker::_s_allLock");
 };
 
 CLOSE_NAMESPACE(Firestorm);
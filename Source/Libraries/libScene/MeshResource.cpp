@@ -12,6 +12,7 @@
 
 #include <libIO/ResourceReference.h>
 #include <libIO/ResourceIOErrors.h>
+#include <libCore/Profiler.h>
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -52,13 +53,14 @@ MeshLoader::~MeshLoader()
 
 MeshLoader::LoadResult MeshLoader::Load(ResourceMgr* resourceMgr, const ResourceReference& ref)
 {
+	FIRE_PROFILE_SCOPE("MeshLoader::Load");
 	auto path = ref.GetResourcePath();
 	if(libIO::FileExists(path.c_str()))
 	{
-		auto result = libIO::LoadFile(path);
+		auto result = libIO::MapFile(path, FileAccess::Sequential);
 		if(result.has_value())
 		{
-			RefPtr<MeshResource> resource(make_shared<MeshResource>(_renderMgr));
+			IntrusivePtr<MeshResource> resource(MakeIntrusive<MeshResource>(_renderMgr));
 			resource->_data = result.value();
 			return FIRE_LOAD_SUCCESS(resource);
 		}
@@ -17,6 +17,7 @@
 #include <libIO/ResourceLoader.h>
 #include <libIO/IResourceObject.h>
 #include <libIO/ResourceReference.h>
+#include <libIO/MappedFile.h>
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -47,8 +48,8 @@ public:
 	virtual bool IsReady() const;
 
 private:
-	RenderMgr& _renderMgr;
-	vector<char> _data;
+	RenderMgr&    _renderMgr;
+	MappedFilePtr _data;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
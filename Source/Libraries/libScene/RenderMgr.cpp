@@ -10,6 +10,7 @@
 #include "RenderMgr.h"
 
 #include <libCore/Logger.h>
+#include <libCore/MemoryTracker.h>
 #include <libMirror/ObjectMaker.h>
 #include <libIO/ResourceMgr.h>
 
@@ -35,6 +36,7 @@ RenderMgr::~RenderMgr()
 
 void RenderMgr::Initialize(const char* system, const LLGL::RenderContextDescriptor& renderContextDesc)
 {
+	FIRE_MEMORY_TAG(Scene);
 	System = LLGL::RenderSystem::Load(system);
 	Context = System->CreateRenderContext(renderContextDesc);
 
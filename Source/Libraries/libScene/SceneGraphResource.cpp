@@ -12,6 +12,8 @@
 #include "MeshResource.h"
 
 #include <libIO/ResourceIOErrors.h>
+#include <libCore/Profiler.h>
+#include <libCore/Metrics.h>
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -63,18 +65,25 @@ SceneGraphLoader::~SceneGraphLoader()
 
 ResourceLoader::LoadResult SceneGraphLoader::Load(ResourceMgr* resourceMgr, const ResourceReference& ref)
 {
+	FIRE_PROFILE_SCOPE("SceneGraphLoader::Load");
 	auto path = ref.GetResourcePath();
 	if(libIO::FileExists(path.c_str()))
 	{
-		auto result = libIO::LoadFile(path);
+		auto result = libIO::MapFile(path, FileAccess::Sequential);
 		if(result.has_value())
 		{
-			auto data = result.value();
-			FIRE_ASSERT(!data.empty());
+			const MappedFilePtr& data = result.value();
+			FIRE_ASSERT(!data->empty());
 
 			JSONCPP_STRING errors;
 			Json::Value root;
-			if(!_reader->parse(&data[0], &data[data.size() - 1], &root, &errors))
+			static MetricHistogram& parseTime = Metrics::GetHistogram("io.parse_ns");
+			bool parsed;
+			{
+				MetricTimer timer(parseTime);
+				parsed = _reader->parse(data->GetChars(), data->GetChars() + data->size() - 1, &root, &errors);
+			}
+			if(!parsed)
 			{
 				return FIRE_LOAD_FAIL(ResourceIOErrors::PARSING_ERROR, errors.c_str());
 			}
@@ -84,7 +93,7 @@ ResourceLoader::LoadResult SceneGraphLoader::Load(ResourceMgr* resourceMgr, cons
 			// Read the asset block.
 			auto asset = root["asset"];
 
-			RefPtr<SceneGraphResource> resource(make_shared<SceneGraphResource>(_renderMgr));
+			IntrusivePtr<SceneGraphResource> resource(MakeIntrusive<SceneGraphResource>(_renderMgr));
 
 			resource->_assetData.Version = asset.get("version", "0.0.0").asCString();
 			resource->_assetData.Copyright = asset.get("copyright", "").asCString();
@@ -12,6 +12,8 @@
 
 #include <libIO/libIO.h>
 #include <libIO/ResourceIOErrors.h>
+#include <libCore/Profiler.h>
+#include <libCore/Metrics.h>
 
 OPEN_NAMESPACE(Firestorm);
 
@@ -19,6 +21,7 @@ OPEN_NAMESPACE(Firestorm);
 
 ShaderProgramLoader::ShaderProgramLoader(RenderMgr& renderMgr)
 	: _renderMgr(renderMgr)
+	, _shaderPool(new ObjectPool<ShaderProgramResource>())
 {
 	_builder["collectComments"] = false;
 	_reader = _builder.newCharReader();
@@ -33,16 +36,23 @@ ShaderProgramLoader::~ShaderProgramLoader()
 
 ShaderProgramLoader::LoadResult ShaderProgramLoader::Load(ResourceMgr* resourceMgr, const ResourceReference& ref)
 {
+	FIRE_PROFILE_SCOPE("ShaderProgramLoader::Load");
 	const string& filename = ref.GetResourcePath();
 	if(libIO::FileExists(filename.c_str()))
 	{
-		Result<vector<char>, Error> result = libIO::LoadFile(filename);
+		Result<MappedFilePtr, Error> result = libIO::MapFile(filename, FileAccess::Sequential);
 		if(result.has_value())
 		{
-			const vector<char>& data = result.value();
+			const MappedFilePtr& data = result.value();
 			Json::Value root;
 			JSONCPP_STRING e;
-			if(!_reader->parse(&data[0], &data[data.size() - 1], &root, &e))
+			static MetricHistogram& parseTime = Metrics::GetHistogram("io.parse_ns");
+			bool parsed;
+			{
+				MetricTimer timer(parseTime);
+				parsed = _reader->parse(data->GetChars(), data->GetChars() + data->size() - 1, &root, &e);
+			}
+			if(!parsed)
 			{
 				string errors(e.c_str());
 				return FIRE_LOAD_FAIL(
@@ -50,7 +60,8 @@ ShaderProgramLoader::LoadResult ShaderProgramLoader::Load(ResourceMgr* resourceM
 					errors);
 			}
 
-			RefPtr<ShaderProgramResource> shaderResource(make_shared<ShaderProgramResource>(_renderMgr));
+			IntrusivePtr<ShaderProgramResource> shaderResource(_shaderPool->Get(_renderMgr));
+			shaderResource->_pool = _shaderPool;
 
 			if(_renderMgr.IsUsingRenderer(Renderers::OpenGL))
 			{
@@ -136,6 +147,15 @@ ShaderProgramResource::~ShaderProgramResource()
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void ShaderProgramResource::Destroy() const
+{
+	// returning the object destroys it, and _pool with it. keep the pool alive until it has the object back.
+	RefPtr<ObjectPool<ShaderProgramResource>> pool(_pool);
+	pool->Return(const_cast<ShaderProgramResource*>(this));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 bool ShaderProgramResource::IsReady() const
 {
 	return true;
@@ -49,10 +49,10 @@ public:
 
 	virtual LoadResult Load(ResourceMgr* resourceMgr, const ResourceReference& ref) override;
 private:
-	RenderMgr&                              _renderMgr;
-	Json::CharReaderBuilder                 _builder;
-	Json::CharReader*                       _reader;
-	ObjectPool<class ShaderProgramResource> _shaderPool;
+	RenderMgr&                                      _renderMgr;
+	Json::CharReaderBuilder                         _builder;
+	Json::CharReader*                               _reader;
+	RefPtr<ObjectPool<class ShaderProgramResource>> _shaderPool;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,6 +69,10 @@ public:
 	LLGL::ShaderProgram* GetProgram() const;
 
 	LLGL::ShaderProgram* Compile(std::initializer_list<LLGL::VertexFormat> vertexFormats);
+protected:
+	// hand the object back to the pool it came out of rather than deleting it.
+	virtual void Destroy() const override;
+
 private:
 	void PurgeCompiledShaders();
 	LLGL::Shader* MakeShader(LLGL::ShaderType shaderType);
@@ -80,6 +84,9 @@ private:
 	unordered_map<LLGL::ShaderType, string>        _shaderData;
 	LLGL::ShaderProgram*                          _shaderProgram{ nullptr };
 	bool                                          _isCompiled{ false };
+
+	// held by every object so that resources which outlive the loader can still be returned to the pool.
+	RefPtr<ObjectPool<ShaderProgramResource>>     _pool;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -7,6 +7,8 @@
 #include <libExistence/System.h>
 #include <libExistence/Entity.h>
 #include <libExistence/ComponentDefinition.h>
+#include <libExistence/ComponentStorage.h>
+#include <libCore/MapSOA.h>
 
 #include <libMath/Vector.h>
 #include <libMath/Quaternion.h>
@@ -14,10 +16,26 @@
 
 #include <libCore/Logger.h>
 
+#include <EASTL/sort.h>
+
 #include <iomanip>
 
 using namespace Firestorm;
 
+OPEN_NAMESPACE(Firestorm);
+struct EntityMgrTestAccess
+{
+	static Entity SetGeneration(EntityMgr& eMgr, Entity entity, EntityGeneration generation)
+	{
+		return eMgr.SetGeneration(entity, generation);
+	}
+};
+CLOSE_NAMESPACE(Firestorm);
+
+#define NUM_CHURN_ENTITIES 1000000
+#define NUM_DESPAWNED_ENTITIES 100000
+#define NUM_SCALE_ENTITIES 10000000
+
 class PosRotComponent : public Component<Vector3, Quaternion>
 {
 public:
@@ -40,6 +58,17 @@ public:
 	}
 };
 
+class HealthComponent : public Component<float>
+{
+public:
+	FIRE_TVI(HEALTH, 1);
+
+	HealthComponent(EntityMgr& eMgr)
+	: Base(eMgr, DestructionHandler::kGC)
+	{
+	}
+};
+
 RefPtr<TestHarness> libExistencePrepareHarness(int ac, char** av)
 {
 	RefPtr<TestHarness> h(new TestHarness("libExistence"));
@@ -182,5 +211,606 @@ RefPtr<TestHarness> libExistencePrepareHarness(int ac, char** av)
 		t.Assert(i_test != i_last, "the last component didn't destroy itself properly");
 	});
 
+	h->It("component storage should only find an entity with the generation it was inserted with", [&](TestCase& t) {
+		ComponentStorage<float> storage;
+		Entity first(5, 0);
+		Entity second(5, 1);
+
+		size_t i = storage.Insert(first, 1.0f);
+		t.Assert(storage.Find(first) == i, "the entity wasn't found");
+		t.Assert(!storage.Contains(second), "an entity with a newer generation found the old row");
+		t.Assert(!storage.Contains(Entity()), "the invalid entity found a row");
+
+		// the index got reused, so the old row goes.
+		i = storage.Insert(second, 2.0f);
+		t.Assert(storage.Size() == 1, "the row left behind by the old generation wasn't erased");
+		t.Assert(!storage.Contains(first), "the old generation still found a row");
+		t.Assert(storage.Find(second) == i && storage[1_soa][i] == 2.0f, "the new generation didn't find its row");
+	});
+
+	h->It("component storage should keep every entity mapped to its row as rows are swapped and popped", [&](TestCase& t) {
+		ComponentStorage<uint64_t> storage;
+		const size_t count = 10000;
+		for(size_t i = 0; i < count; ++i)
+		{
+			storage.Insert(Entity(i * 7, 0), i * 7);
+		}
+
+		for(size_t i = 0; i < count; i += 3)
+		{
+			t.Assert(storage.Erase(Entity(i * 7, 0)), "an entity that was inserted couldn't be erased");
+		}
+		t.Assert(!storage.Erase(Entity(0, 0)), "an entity was erased twice");
+
+		bool mapped = true;
+		for(size_t i = 0; i < count; ++i)
+		{
+			const size_t row = storage.Find(Entity(i * 7, 0));
+			if(i % 3 == 0)
+			{
+				mapped &= row == ComponentStorage<uint64_t>::InvalidIndex;
+			}
+			else
+			{
+				mapped &= row != ComponentStorage<uint64_t>::InvalidIndex && storage[1_soa][row] == i * 7 &&
+					storage.GetEntity(row) == Entity(i * 7, 0);
+			}
+		}
+		t.Assert(mapped, "an entity was mapped to the wrong row");
+		t.Assert(storage.Size() == count - (count + 2) / 3, "the storage has the wrong number of rows");
+	});
+
+	h->It("component storage should only keep the sparse pages that are in use", [&](TestCase& t) {
+		ComponentStorage<float> storage;
+		Entity low(1, 0);
+		Entity high(ComponentStorage<float>::PageSize * 1000, 0);
+
+		storage.Insert(low);
+		storage.Insert(high);
+		t.Assert(storage.GetNumPages() == 2, "a page should have been allocated for each entity");
+
+		storage.Erase(low);
+		t.Assert(storage.GetNumPages() == 1, "the page for the low entity wasn't freed");
+		storage.Erase(high);
+		t.Assert(storage.GetNumPages() == 0 && storage.Empty(), "the page for the high entity wasn't freed");
+	});
+
+	h->Profile(Format("Component churn: sparse set vs hashed map [%d Entities]", NUM_CHURN_ENTITIES), 10, [](Benchmark& bm) {
+		vector<Entity> entities;
+		entities.reserve(NUM_CHURN_ENTITIES);
+		for(size_t i = 0; i < NUM_CHURN_ENTITIES; ++i)
+		{
+			// scattered so that neither one gets to walk memory in order.
+			entities.push_back(Entity((i * 2654435761u) % NUM_CHURN_ENTITIES, 0));
+		}
+
+		ComponentStorage<Vector3> sparse;
+		float sum = 0.0f;
+		Benchmark::SnapshotHandle* ssh = bm.StartSegment("Sparse set: Assign");
+		for(Entity entity : entities)
+		{
+			sparse.Insert(entity);
+		}
+		bm.StopSegment(ssh);
+
+		ssh = bm.StartSegment("Sparse set: Lookup");
+		for(Entity entity : entities)
+		{
+			sum += sparse[1_soa][sparse.Find(entity)].x;
+		}
+		bm.StopSegment(ssh);
+
+		ssh = bm.StartSegment("Sparse set: Remove");
+		for(Entity entity : entities)
+		{
+			sparse.Erase(entity);
+		}
+		bm.StopSegment(ssh);
+
+		MapSOA<Entity, Vector3> hashed;
+		ssh = bm.StartSegment("Hashed map: Assign");
+		for(Entity entity : entities)
+		{
+			hashed.Insert(entity);
+		}
+		bm.StopSegment(ssh);
+
+		ssh = bm.StartSegment("Hashed map: Lookup");
+		for(Entity entity : entities)
+		{
+			sum += hashed[1_soa][hashed.Find(entity)].x;
+		}
+		bm.StopSegment(ssh);
+
+		ssh = bm.StartSegment("Hashed map: Remove");
+		for(Entity entity : entities)
+		{
+			hashed.Erase(entity);
+		}
+		bm.StopSegment(ssh);
+		FIRE_ASSERT(sum == 0.0f && sparse.Empty() && hashed.Empty());
+	});
+
+	h->It("despawning an entity should erase its components right away", [&](TestCase& t) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		PosRotComponent componentMgr(eMgr);
+
+		Entity first = eMgr.SpawnEntity();
+		Entity middle = eMgr.SpawnEntity();
+		Entity last = eMgr.SpawnEntity();
+		componentMgr.Assign(first);
+		componentMgr.Assign(middle);
+		componentMgr.SetPosition(componentMgr.Assign(last), { 1.0f, 2.0f, 3.0f });
+
+		eMgr.DespawnEntity(middle);
+		t.Assert(!eMgr.IsAlive(middle), "the entity is still alive");
+		t.Assert(!componentMgr.Contains(middle), "the component wasn't erased along with the entity");
+		t.Assert(componentMgr.Lookup(last) == 1, "the last component wasn't moved into the hole");
+		t.Assert(componentMgr.GetPosition(componentMgr.Lookup(last)).z == 3.0f, "the last component lost its values");
+		t.Assert(componentMgr.Contains(first), "the first component went missing");
+	});
+
+	h->It("batched despawns should wait for the flush and hand the whole batch over at once", [&](TestCase& t) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		PosRotComponent componentMgr(eMgr);
+
+		size_t numBatches = 0;
+		size_t numDestroyed = 0;
+		eMgr.RegisterDestructionCallback(&numBatches, [&](span<const Entity> entities) {
+			++numBatches;
+			numDestroyed += entities.size();
+		});
+
+		vector<Entity> entities;
+		for(size_t i = 0; i < 100; ++i)
+		{
+			entities.push_back(eMgr.SpawnEntity());
+			componentMgr.Assign(entities.back());
+		}
+		Entity survivor = eMgr.SpawnEntity();
+		componentMgr.Assign(survivor);
+
+		// the same entity twice should only be despawned once.
+		entities.push_back(entities.front());
+		eMgr.DespawnEntities(entities);
+		t.Assert(eMgr.GetNumPendingDespawns() == 101, "the despawns weren't queued up");
+		t.Assert(eMgr.IsAlive(entities[50]) && componentMgr.Contains(entities[50]), "an entity died before the flush");
+
+		t.Assert(eMgr.FlushDespawns() == 100, "the wrong number of entities were despawned");
+		t.Assert(numBatches == 1 && numDestroyed == 100, "the callback should have been handed a single batch");
+		t.Assert(eMgr.GetNumPendingDespawns() == 0 && eMgr.FlushDespawns() == 0, "the queue wasn't emptied");
+
+		bool erased = true;
+		for(Entity entity : entities)
+		{
+			erased &= !eMgr.IsAlive(entity) && !componentMgr.Contains(entity);
+		}
+		t.Assert(erased, "a despawned entity kept its component");
+		t.Assert(componentMgr.Lookup(survivor) == 0, "the entity that wasn't despawned lost its component");
+		eMgr.UnregisterDestructionCallback(&numBatches);
+	});
+
+	h->Profile(Format("Mass despawn: one at a time vs batched [%d Entities]", NUM_DESPAWNED_ENTITIES), 10, [](Benchmark& bm) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		PosRotComponent componentMgr(eMgr);
+
+		vector<Entity> entities;
+		entities.reserve(NUM_DESPAWNED_ENTITIES);
+		for(size_t i = 0; i < NUM_DESPAWNED_ENTITIES; ++i)
+		{
+			entities.push_back(eMgr.SpawnEntity());
+			componentMgr.Assign(entities.back());
+		}
+
+		Benchmark::SnapshotHandle* ssh = bm.StartSegment("DespawnEntity");
+		for(Entity entity : entities)
+		{
+			eMgr.DespawnEntity(entity);
+		}
+		bm.StopSegment(ssh);
+
+		entities.clear();
+		for(size_t i = 0; i < NUM_DESPAWNED_ENTITIES; ++i)
+		{
+			entities.push_back(eMgr.SpawnEntity());
+			componentMgr.Assign(entities.back());
+		}
+
+		ssh = bm.StartSegment("DespawnEntities + FlushDespawns");
+		eMgr.DespawnEntities(entities);
+		eMgr.FlushDespawns();
+		bm.StopSegment(ssh);
+	});
+
+	h->It("the garbage collector should clean up after dead entities a few rows at a time", [&](TestCase& t) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		{
+			HealthComponent healthMgr(eMgr);
+			t.Assert(eMgr.GetNumCollectables() == 1 && eMgr.GetNumRegisteredDestructors() == 0,
+				"a kGC component should be collected rather than get callbacks");
+
+			vector<Entity> entities;
+			for(size_t i = 0; i < 1000; ++i)
+			{
+				entities.push_back(eMgr.SpawnEntity());
+				healthMgr.Assign(entities.back());
+			}
+			for(size_t i = 0; i < entities.size(); i += 2)
+			{
+				eMgr.DespawnEntity(entities[i]);
+			}
+			t.Assert(healthMgr.Contains(entities[0]), "a kGC component shouldn't be touched by the despawn");
+
+			eMgr.SetGCRowsPerFrame(100);
+			eMgr.SetGCTimeBudget(0);
+			bool bounded = true;
+			size_t numCollected = 0;
+			for(size_t frame = 0; frame < 10; ++frame)
+			{
+				const uint64_t checked = healthMgr.GetGCStats().NumChecked;
+				numCollected += eMgr.CollectGarbage();
+				bounded &= healthMgr.GetGCStats().NumChecked - checked == 100;
+			}
+			t.Assert(bounded, "a frame checked the wrong number of rows");
+			t.Assert(numCollected == 500 && healthMgr.GetGCStats().NumCollected == 500, "not every dead row was collected");
+
+			bool collected = true;
+			for(size_t i = 0; i < entities.size(); ++i)
+			{
+				collected &= healthMgr.Contains(entities[i]) == (i % 2 == 1);
+			}
+			t.Assert(collected, "the wrong rows were collected");
+		}
+		t.Assert(eMgr.GetNumCollectables() == 0, "the component wasn't unregistered");
+	});
+
+	h->It("the garbage collector should stop once it runs out of time", [&](TestCase& t) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		HealthComponent healthMgr(eMgr);
+		for(size_t i = 0; i < 10000; ++i)
+		{
+			healthMgr.Assign(eMgr.SpawnEntity());
+		}
+
+		eMgr.SetGCRowsPerFrame(10000);
+		eMgr.SetGCTimeBudget(1);
+		eMgr.CollectGarbage();
+		t.Assert(healthMgr.GetGCStats().NumChecked < 10000, "the time budget was ignored");
+		t.Assert(healthMgr.GetGCStats().NumChecked > 0, "nothing got checked");
+	});
+
+	h->Profile(Format("Garbage collection after a mass despawn [%d Entities]", NUM_DESPAWNED_ENTITIES), 10, [](Benchmark& bm) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		HealthComponent healthMgr(eMgr);
+
+		vector<Entity> entities;
+		entities.reserve(NUM_DESPAWNED_ENTITIES);
+		for(size_t i = 0; i < NUM_DESPAWNED_ENTITIES; ++i)
+		{
+			entities.push_back(eMgr.SpawnEntity());
+			healthMgr.Assign(entities.back());
+		}
+
+		eMgr.DespawnEntities(entities);
+		Benchmark::SnapshotHandle* ssh = bm.StartSegment("FlushDespawns");
+		eMgr.FlushDespawns();
+		bm.StopSegment(ssh);
+
+		// spread over as many frames as it takes, none of which pays more than the rows per frame.
+		ssh = bm.StartSegment("CollectGarbage (every frame)");
+		while(healthMgr.GetGCStats().NumCollected < NUM_DESPAWNED_ENTITIES)
+		{
+			eMgr.CollectGarbage();
+		}
+		bm.StopSegment(ssh);
+	});
+
+	h->It("entities should keep every bit of their index and generation", [&](TestCase& t) {
+		Entity biggest(ENT_INDEX_MASK - 1, static_cast<EntityGeneration>(ENT_GENERATION_MASK - 1));
+		t.Assert(biggest.Index() == ENT_INDEX_MASK - 1, "the index was cut short");
+		t.Assert(biggest.Generation() == ENT_GENERATION_MASK - 1, "the generation was cut short");
+		t.Assert(!(biggest == Entity()), "a real entity shouldn't look like the invalid one");
+
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		const size_t count = 200000;
+		bool alive = true;
+		for(size_t i = 0; i < count; ++i)
+		{
+			Entity e = eMgr.SpawnEntity();
+			alive &= e.Index() == i && eMgr.IsAlive(e);
+		}
+		t.Assert(alive && eMgr.GetNumAlive() == count, "the entities didn't all get their own index");
+		t.Assert(!eMgr.IsAlive(Entity(count, 0)) && !eMgr.IsAlive(Entity()), "an index that was never spawned is alive");
+	});
+
+	h->It("an entity index should be retired once its generation runs out", [&](TestCase& t) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		eMgr.SetMinFreeIndices(0);
+
+		// with nothing else around, every spawn reuses index 0 until it's used up.
+		Entity first = eMgr.SpawnEntity();
+		Entity e = first;
+		bool reused = true;
+		for(EntityID generation = 0; generation < 3; ++generation)
+		{
+			reused &= e.Index() == 0 && e.Generation() == generation;
+			eMgr.DespawnEntity(e);
+			e = eMgr.SpawnEntity();
+		}
+		t.Assert(reused, "the index wasn't reused with the next generation");
+
+		// skip most of the generations rather than spinning through billions of them with 32 bit indices.
+		const EntityGeneration nearlyDone = static_cast<EntityGeneration>(ENT_GENERATION_MASK - 3);
+		Entity aged = EntityMgrTestAccess::SetGeneration(eMgr, e, nearlyDone);
+		t.Assert(aged.Index() == 0 && aged.Generation() == nearlyDone && eMgr.IsAlive(aged), "the generation wasn't set");
+		t.Assert(!eMgr.IsAlive(e), "the entity from before the generation was set is still alive");
+		e = aged;
+		for(EntityID generation = nearlyDone; generation < ENT_GENERATION_MASK - 1; ++generation)
+		{
+			reused &= e.Index() == 0 && e.Generation() == generation;
+			eMgr.DespawnEntity(e);
+			e = eMgr.SpawnEntity();
+		}
+		t.Assert(reused, "the index wasn't reused with the next generation");
+		t.Assert(e.Index() == 0 && e.Generation() == ENT_GENERATION_MASK - 1, "the last generation wasn't handed out");
+
+		eMgr.DespawnEntity(e);
+		t.Assert(eMgr.GetNumRetired() == 1, "the index wasn't retired");
+		Entity next = eMgr.SpawnEntity();
+		t.Assert(next.Index() == 1, "a retired index was handed out again");
+		t.Assert(!eMgr.IsAlive(first) && !eMgr.IsAlive(e), "a stale entity came back to life");
+	});
+
+	h->Profile(Format("Entities at scale [%d Entities]", NUM_SCALE_ENTITIES), 3, [](Benchmark& bm) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		vector<Entity> entities;
+		entities.reserve(NUM_SCALE_ENTITIES);
+
+		Benchmark::SnapshotHandle* ssh = bm.StartSegment("SpawnEntity");
+		for(size_t i = 0; i < NUM_SCALE_ENTITIES; ++i)
+		{
+			entities.push_back(eMgr.SpawnEntity());
+		}
+		bm.StopSegment(ssh);
+
+		size_t numAlive = 0;
+		ssh = bm.StartSegment("IsAlive");
+		for(Entity entity : entities)
+		{
+			numAlive += eMgr.IsAlive(entity) ? 1 : 0;
+		}
+		bm.StopSegment(ssh);
+
+		ssh = bm.StartSegment("DespawnEntity");
+		for(Entity entity : entities)
+		{
+			eMgr.DespawnEntity(entity);
+		}
+		bm.StopSegment(ssh);
+
+		ssh = bm.StartSegment("SpawnEntity (reusing indices)");
+		for(size_t i = 0; i < NUM_SCALE_ENTITIES; ++i)
+		{
+			entities[i] = eMgr.SpawnEntity();
+		}
+		bm.StopSegment(ssh);
+		FIRE_ASSERT(numAlive == NUM_SCALE_ENTITIES && eMgr.GetNumAlive() == NUM_SCALE_ENTITIES);
+	});
+
+	h->It("SpawnEntities should hand out live entities and reuse freed indices", [&](TestCase& t) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr);
+		eMgr.SetMinFreeIndices(0);
+
+		vector<Entity> entities;
+		eMgr.SpawnEntities(1000, entities);
+		t.Assert(entities.size() == 1000 && eMgr.GetNumAlive() == 1000, "the wrong number of entities were spawned");
+
+		vector<bool> seen(1000, false);
+		bool unique = true;
+		for(Entity entity : entities)
+		{
+			unique &= entity.Index() < 1000 && !seen[entity.Index()] && eMgr.IsAlive(entity);
+			seen[entity.Index()] = true;
+		}
+		t.Assert(unique, "the entities didn't all get their own live index");
+
+		eMgr.DespawnEntities(span<const Entity>(entities.data(), 500));
+		eMgr.FlushDespawns();
+		vector<Entity> respawned;
+		eMgr.SpawnEntities(600, respawned);
+		size_t numReused = 0;
+		for(Entity entity : respawned)
+		{
+			numReused += entity.Index() < 500 && entity.Generation() == 1 ? 1 : 0;
+		}
+		t.Assert(numReused == 500, "the freed indices weren't handed out again");
+		t.Assert(!eMgr.IsAlive(entities[0]) && eMgr.GetNumAlive() == 1100, "a stale entity came back to life");
+	});
+
+	h->It("despawned indices should be reused oldest first", [&](TestCase& t) {
+		for(EntityMgr::SpawnMode mode : { EntityMgr::SpawnMode::MainThread, EntityMgr::SpawnMode::Concurrent })
+		{
+			const char* name = mode == EntityMgr::SpawnMode::Concurrent ? "concurrent" : "main thread";
+			UUIDMgr uuidMgr;
+			EntityMgr eMgr(uuidMgr, mode);
+			eMgr.SetMinFreeIndices(1000);
+
+			vector<Entity> entities;
+			eMgr.SpawnEntities(4000, entities);
+			eMgr.DespawnEntities(span<const Entity>(entities.data(), entities.size()));
+			eMgr.FlushDespawns();
+
+			// the indices should come back in the order they went away, with the last 1000 held back.
+			vector<Entity> respawned;
+			eMgr.SpawnEntities(3000, respawned);
+			EntityID lastReused = 0;
+			size_t numReused = 0;
+			bool inOrder = true;
+			for(Entity entity : respawned)
+			{
+				if(entity.Generation() == 1)
+				{
+					inOrder &= numReused == 0 || entity.Index() > lastReused;
+					lastReused = entity.Index();
+					++numReused;
+				}
+			}
+			t.Assert(numReused > 0 && inOrder, Format("%s: the indices weren't reused in the order they were freed", name));
+			t.Assert(lastReused < 3000, Format("%s: an index was reused before 1000 others were freed after it", name));
+
+			// spawning and despawning one entity over and over shouldn't keep landing on the same index.
+			EntityID highest = 0;
+			for(size_t i = 0; i < 20000; ++i)
+			{
+				Entity e = eMgr.SpawnEntity();
+				highest = eastl::max(highest, e.Generation());
+				eMgr.DespawnEntity(e);
+			}
+			t.Assert(highest < 32, Format("%s: an index was reused too often (generation %d)", name, static_cast<int>(highest)));
+		}
+	});
+
+	h->It("entities should be spawned and despawned from many threads at once", [&](TestCase& t) {
+		UUIDMgr uuidMgr;
+		EntityMgr eMgr(uuidMgr, EntityMgr::SpawnMode::Concurrent);
+		eMgr.SetMinFreeIndices(0);
+
+		const size_t numThreads = 8;
+		const size_t numPerThread = 20000;
+
+		// start off with freed indices, so that the free list is fought over as well as the fresh ones.
+		vector<Entity> freed;
+		eMgr.SpawnEntities(numThreads * numPerThread / 2, freed);
+		eMgr.DespawnEntities(span<const Entity>(freed.data(), freed.size()));
+		eMgr.FlushDespawns();
+
+		vector<vector<Entity>> spawned(numThreads);
+		vector<vector<Entity>> despawned(numThreads);
+		vector<thread> threads;
+		for(size_t i = 0; i < numThreads; ++i)
+		{
+			threads.push_back(thread([&eMgr, &spawned, &despawned, i]() {
+				vector<Entity> out;
+				for(size_t j = 0; j < numPerThread; ++j)
+				{
+					out.push_back(eMgr.SpawnEntity());
+				}
+				eMgr.SpawnEntities(numPerThread, out);
+
+				// every other entity is queued up to go away, and the rest are kept.
+				for(size_t j = 0; j < out.size(); ++j)
+				{
+					(j % 2 == 0 ? spawned[i] : despawned[i]).push_back(out[j]);
+				}
+				eMgr.DespawnEntities(span<const Entity>(despawned[i].data(), despawned[i].size()));
+			}));
+		}
+		for(thread& th : threads)
+		{
+			th.join();
+		}
+		t.Assert(eMgr.GetNumPendingDespawns() == numThreads * numPerThread, "despawns were lost on the way in");
+		eMgr.FlushDespawns();
+
+		bool despawnedDead = true;
+		for(const vector<Entity>& out : despawned)
+		{
+			for(Entity entity : out)
+			{
+				despawnedDead &= !eMgr.IsAlive(entity);
+			}
+		}
+		t.Assert(despawnedDead, "a queued entity survived the flush");
+
+		vector<Entity> all;
+		for(const vector<Entity>& out : spawned)
+		{
+			all.insert(all.end(), out.begin(), out.end());
+		}
+		eastl::sort(all.begin(), all.end(), [](Entity a, Entity b) { return a.Index() < b.Index(); });
+		bool unique = true;
+		bool alive = true;
+		for(size_t i = 0; i < all.size(); ++i)
+		{
+			unique &= i == 0 || all[i - 1].Index() != all[i].Index();
+			alive &= eMgr.IsAlive(all[i]);
+		}
+		t.Assert(all.size() == numThreads * numPerThread, "entities went missing");
+		t.Assert(unique, "two threads were handed the same index");
+		t.Assert(alive && eMgr.GetNumAlive() == all.size(), "the entities aren't all alive");
+
+		eMgr.DespawnEntities(span<const Entity>(all.data(), all.size()));
+		eMgr.FlushDespawns();
+		bool dead = true;
+		for(Entity entity : all)
+		{
+			dead &= !eMgr.IsAlive(entity);
+		}
+		t.Assert(dead && eMgr.GetNumAlive() == 0, "the entities weren't all despawned");
+	});
+
+	h->Profile(Format("Spawning in bulk and from many threads [%d Entities]", NUM_CHURN_ENTITIES), 10, [](Benchmark& bm) {
+		const size_t numThreads = 4;
+		vector<Entity> entities;
+		entities.reserve(NUM_CHURN_ENTITIES);
+		{
+			UUIDMgr uuidMgr;
+			EntityMgr eMgr(uuidMgr);
+			Benchmark::SnapshotHandle* ssh = bm.StartSegment("SpawnEntity");
+			for(size_t i = 0; i < NUM_CHURN_ENTITIES; ++i)
+			{
+				entities.push_back(eMgr.SpawnEntity());
+			}
+			bm.StopSegment(ssh);
+		}
+
+		entities.clear();
+		{
+			UUIDMgr uuidMgr;
+			EntityMgr eMgr(uuidMgr);
+			Benchmark::SnapshotHandle* ssh = bm.StartSegment("SpawnEntities");
+			eMgr.SpawnEntities(NUM_CHURN_ENTITIES, entities);
+			bm.StopSegment(ssh);
+		}
+
+		{
+			UUIDMgr uuidMgr;
+			EntityMgr eMgr(uuidMgr, EntityMgr::SpawnMode::Concurrent);
+			vector<vector<Entity>> spawned(numThreads);
+			for(vector<Entity>& out : spawned)
+			{
+				out.reserve(NUM_CHURN_ENTITIES / numThreads);
+			}
+
+			Benchmark::SnapshotHandle* ssh = bm.StartSegment("SpawnEntity on 4 threads");
+			vector<thread> threads;
+			for(size_t i = 0; i < numThreads; ++i)
+			{
+				threads.push_back(thread([&eMgr, &spawned, i, numThreads]() {
+					for(size_t j = 0; j < NUM_CHURN_ENTITIES / numThreads; ++j)
+					{
+						spawned[i].push_back(eMgr.SpawnEntity());
+					}
+				}));
+			}
+			for(thread& th : threads)
+			{
+				th.join();
+			}
+			bm.StopSegment(ssh);
+			FIRE_ASSERT(eMgr.GetNumAlive() == NUM_CHURN_ENTITIES);
+		}
+	});
+
 	return h;
 }
\ No newline at end of file
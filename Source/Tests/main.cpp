@@ -49,6 +49,9 @@ int main(int ac, char** av)
         libScriptPrepareHarness(ac, av)
     };
 
+    // the harnesses are still alive when leaks get reported, so don't count them.
+    libCore::MarkMemoryBaseline();
+
 
     try
     {